@@ -0,0 +1,352 @@
+#include "congestion.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//RFC 6928, ten segments but no more than 14600 bytes(and never below two segments)
+static uint32_t initialWindow(uint32_t mss){
+  return min(10 * mss, max(2 * mss, INITIAL_WINDOW_BYTES));
+}
+
+void CongestionControl::init(uint32_t m, uint32_t c, uint32_t s){
+  mss = m;
+  cwnd = (c == 0) ? initialWindow(m) : c;
+  ssthresh = s;
+  bytesAckedInAvoidance = 0;
+}
+
+//the mss is only final once the peer's syn is read. An untouched initial window is resized to match
+void CongestionControl::setMss(uint32_t m){
+  bool untouched = (cwnd == initialWindow(mss));
+  mss = m;
+  if(untouched) cwnd = initialWindow(mss);
+}
+
+uint32_t CongestionControl::getCwnd(){
+  return cwnd;
+}
+
+uint32_t CongestionControl::getSsthresh(){
+  return ssthresh;
+}
+
+//RFC 5681 3.1, slow start grows by at most an mss per ack, congestion avoidance by an mss per window acked(byte counting)
+void CongestionControl::slowStartOrAvoid(uint32_t ackedBytes){
+  if(cwnd < ssthresh){
+    cwnd += min(ackedBytes, mss);
+    return;
+  }
+  bytesAckedInAvoidance += ackedBytes;
+  if(bytesAckedInAvoidance >= cwnd){
+    bytesAckedInAvoidance -= cwnd;
+    cwnd += mss;
+  }
+}
+
+//RFC 5681 equation 4
+uint32_t CongestionControl::lossSsthresh(uint32_t inFlight){
+  return max(inFlight / 2, 2 * mss);
+}
+
+void NewRenoCongestion::onAck(const AckEvent& ev){
+  if(ev.inRecovery) return;
+  slowStartOrAvoid(ev.ackedBytes);
+}
+
+void NewRenoCongestion::onLoss(uint32_t inFlight, std::chrono::steady_clock::time_point now){
+  ssthresh = lossSsthresh(inFlight);
+  cwnd = ssthresh;
+  bytesAckedInAvoidance = 0;
+}
+
+//RFC 5681 3.1, ssthresh is only cut for the first timeout of a segment, the window always drops to one segment
+void NewRenoCongestion::onRto(uint32_t inFlight, bool firstTimeout){
+  if(firstTimeout) ssthresh = lossSsthresh(inFlight);
+  cwnd = mss;
+  bytesAckedInAvoidance = 0;
+}
+
+CongestionAlgo NewRenoCongestion::getAlgo(){
+  return CongestionAlgo::NEWRENO;
+}
+
+/*
+reduce-
+RFC 9438 4.6 and 4.7. Remembers where the window was when loss hit(lowered further if the last loss came at a smaller window, so a new flow
+can take bandwidth), cuts by beta and restarts the curve so it plateaus back at wMax after k seconds.
+*/
+void CubicCongestion::reduce(std::chrono::steady_clock::time_point now){
+  double cwndSeg = static_cast<double>(cwnd) / mss;
+  if(cwndSeg < wLastMax){
+    wLastMax = cwndSeg;
+    wMax = cwndSeg * (1.0 + CUBIC_BETA) / 2.0;
+  }
+  else{
+    wLastMax = cwndSeg;
+    wMax = cwndSeg;
+  }
+  ssthresh = max(static_cast<uint32_t>(cwnd * CUBIC_BETA), 2 * mss);
+  cwnd = ssthresh;
+  bytesAckedInAvoidance = 0;
+  epochStarted = false;
+}
+
+void CubicCongestion::onAck(const AckEvent& ev){
+
+  if(ev.inRecovery) return;
+  if(cwnd < ssthresh){
+    slowStartOrAvoid(ev.ackedBytes);
+    return;
+  }
+
+  double cwndSeg = static_cast<double>(cwnd) / mss;
+  if(!epochStarted){
+    epochStarted = true;
+    epochStart = ev.now;
+    if(wMax < cwndSeg){
+      //no loss yet, or the window already passed the old maximum, so the curve starts at its plateau
+      wMax = cwndSeg;
+      k = 0;
+    }
+    else{
+      k = cbrt((wMax - cwndSeg) / CUBIC_C);
+    }
+    wEst = cwndSeg;
+  }
+
+  double t = std::chrono::duration<double>(ev.now - epochStart).count();
+  double rtt = minRtt.count();
+
+  //RFC 9438 4.3, the reno friendly estimate grows alpha segments per window
+  double alpha = 3.0 * (1.0 - CUBIC_BETA) / (1.0 + CUBIC_BETA);
+  wEst += alpha * (static_cast<double>(ev.ackedBytes) / mss) / cwndSeg;
+
+  double wCubic = CUBIC_C * pow(t - k, 3) + wMax;
+  if(wCubic < wEst){
+    if(wEst > cwndSeg) cwnd = static_cast<uint32_t>(wEst * mss);
+    return;
+  }
+
+  //RFC 9438 4.4/4.5, aim for where the curve will be one rtt from now, but never more than 1.5 times the current window
+  double target = CUBIC_C * pow(t + rtt - k, 3) + wMax;
+  target = min(max(target, cwndSeg), 1.5 * cwndSeg);
+  double growth = (target - cwndSeg) / cwndSeg * ev.ackedBytes;
+  cwnd += static_cast<uint32_t>(growth);
+}
+
+void CubicCongestion::onLoss(uint32_t inFlight, std::chrono::steady_clock::time_point now){
+  reduce(now);
+}
+
+void CubicCongestion::onRto(uint32_t inFlight, bool firstTimeout){
+  if(firstTimeout) reduce(std::chrono::steady_clock::now());
+  cwnd = mss;
+  epochStarted = false;
+}
+
+void CubicCongestion::onRttSample(std::chrono::duration<double> rtt){
+  if(minRtt.count() <= 0 || rtt < minRtt) minRtt = rtt;
+}
+
+//after the flow sat idle the curve is shifted by the idle time, otherwise the first ack would jump the window ahead(RFC 9438 5.8)
+void CubicCongestion::onSend(uint32_t bytes, uint32_t inFlight, std::chrono::steady_clock::time_point now){
+  if(inFlight == 0 && epochStarted){
+    epochStart += (now - lastSend);
+  }
+  lastSend = now;
+}
+
+CongestionAlgo CubicCongestion::getAlgo(){
+  return CongestionAlgo::CUBIC;
+}
+
+void BbrCongestion::onAck(const AckEvent& ev){
+
+  roundStart = false;
+  if(ev.rate.priorDelivered >= nextRoundDelivered){
+    nextRoundDelivered = ev.delivered;
+    roundCount++;
+    roundStart = true;
+  }
+
+  updateMaxBw(ev);
+  updateMinRtt(ev);
+  checkFullPipe(ev);
+  if(mode == BbrMode::STARTUP && filledPipe){
+    mode = BbrMode::DRAIN;
+    pacingGain = 1.0 / BBR_HIGH_GAIN;
+  }
+  if(mode == BbrMode::DRAIN && ev.inFlight <= bdp(1.0)) enterProbeBw(ev.now);
+  if(mode == BbrMode::PROBE_BW) advanceCycle(ev);
+  checkProbeRtt(ev);
+
+  setPacingRate();
+  setCwnd(ev);
+}
+
+//windowed max over the last BBR_BW_WINDOW_ROUNDS rounds. Samples are kept in decreasing order so the front is always the max
+void BbrCongestion::updateMaxBw(const AckEvent& ev){
+
+  double bw = ev.rate.deliveryRate;
+  if(bw <= 0) return;
+  //an app limited sample only says the path can do at least this much, so it only counts if it raises the estimate
+  if(ev.rate.appLimited && bw < getMaxBw()) return;
+
+  while(!bwFilter.empty() && bwFilter.back().second <= bw) bwFilter.pop_back();
+  bwFilter.push_back(std::make_pair(roundCount, bw));
+  while(bwFilter.front().first + BBR_BW_WINDOW_ROUNDS <= roundCount) bwFilter.pop_front();
+}
+
+void BbrCongestion::updateMinRtt(const AckEvent& ev){
+
+  minRttExpired = (minRtt.count() > 0) && (ev.now > minRttStamp + BBR_MIN_RTT_WINDOW);
+  if(pendingRtt.count() <= 0) return;
+  if(minRtt.count() <= 0 || pendingRtt <= minRtt || minRttExpired){
+    minRtt = pendingRtt;
+    minRttStamp = ev.now;
+  }
+  pendingRtt = std::chrono::duration<double>(0);
+}
+
+//startup has filled the pipe once three rounds in a row fail to raise the bandwidth estimate by a quarter
+void BbrCongestion::checkFullPipe(const AckEvent& ev){
+
+  if(filledPipe || !roundStart || ev.rate.appLimited) return;
+  if(getMaxBw() >= fullBw * BBR_FULL_BW_THRESH){
+    fullBw = getMaxBw();
+    fullBwCount = 0;
+    return;
+  }
+  fullBwCount++;
+  if(fullBwCount >= BBR_FULL_BW_ROUNDS) filledPipe = true;
+}
+
+void BbrCongestion::enterProbeBw(std::chrono::steady_clock::time_point now){
+  mode = BbrMode::PROBE_BW;
+  cycleIndex = 0;
+  cycleStamp = now;
+  pacingGain = BBR_PACING_GAIN_CYCLE[cycleIndex];
+  inflightHi = UINT32_MAX;
+}
+
+/*
+advanceCycle-
+Steps through the probe bandwidth gains one min rtt at a time. The drain phase can end early once the queue the probe built is gone. Starting
+the probe phase lifts the loss cap so the flow can look for more room.
+*/
+void BbrCongestion::advanceCycle(const AckEvent& ev){
+
+  bool elapsed = (ev.now - cycleStamp) > minRtt;
+  if(pacingGain < 1.0 && ev.inFlight <= bdp(1.0)) elapsed = true;
+  if(!elapsed) return;
+
+  cycleIndex = (cycleIndex + 1) % BBR_CYCLE_LENGTH;
+  cycleStamp = ev.now;
+  pacingGain = BBR_PACING_GAIN_CYCLE[cycleIndex];
+  if(pacingGain > 1.0) inflightHi = UINT32_MAX;
+}
+
+//once the min rtt has gone BBR_MIN_RTT_WINDOW without being refreshed, drain to a few segments for a while to measure it again
+void BbrCongestion::checkProbeRtt(const AckEvent& ev){
+
+  if(mode != BbrMode::PROBE_RTT && minRttExpired){
+    mode = BbrMode::PROBE_RTT;
+    pacingGain = 1.0;
+    priorCwnd = cwnd;
+    probeRttDoneSet = false;
+  }
+  if(mode != BbrMode::PROBE_RTT) return;
+
+  if(!probeRttDoneSet && ev.inFlight <= BBR_MIN_CWND_SEGMENTS * mss){
+    probeRttDone = ev.now + BBR_PROBE_RTT_DURATION;
+    probeRttDoneSet = true;
+  }
+  else if(probeRttDoneSet && ev.now >= probeRttDone){
+    minRttStamp = ev.now;
+    minRttExpired = false;
+    cwnd = std::max(cwnd, priorCwnd);
+    if(filledPipe) enterProbeBw(ev.now);
+    else{
+      mode = BbrMode::STARTUP;
+      pacingGain = BBR_HIGH_GAIN;
+    }
+  }
+}
+
+uint32_t BbrCongestion::bdp(double gain){
+  if(getMaxBw() <= 0 || minRtt.count() <= 0) return initialWindow(mss);
+  return static_cast<uint32_t>(gain * getMaxBw() * minRtt.count());
+}
+
+//until the first bandwidth sample the rate comes from the initial window over the rtt(1ms if there is none yet). In startup it never drops
+void BbrCongestion::setPacingRate(){
+
+  double rate;
+  if(getMaxBw() > 0) rate = pacingGain * getMaxBw();
+  else{
+    double rtt = (minRtt.count() > 0) ? minRtt.count() : 0.001;
+    rate = pacingGain * cwnd / rtt;
+  }
+  if(filledPipe || rate > pacingRate) pacingRate = rate;
+}
+
+void BbrCongestion::setCwnd(const AckEvent& ev){
+
+  uint32_t target = bdp(BBR_CWND_GAIN);
+  if(filledPipe) cwnd = std::min(cwnd + ev.ackedBytes, target);
+  else if(cwnd < target || ev.delivered < initialWindow(mss)) cwnd += ev.ackedBytes;
+
+  cwnd = std::min(cwnd, inflightHi);
+  if(mode == BbrMode::PROBE_RTT) cwnd = std::min(cwnd, BBR_MIN_CWND_SEGMENTS * mss);
+  cwnd = std::max(cwnd, BBR_MIN_CWND_SEGMENTS * mss);
+}
+
+//loss does not drive the model, it only caps the data in flight. A loss during startup means the pipe and its buffer are already full
+void BbrCongestion::onLoss(uint32_t inFlight, std::chrono::steady_clock::time_point now){
+  inflightHi = std::max(static_cast<uint32_t>(inFlight * BBR_LOSS_BETA), BBR_MIN_CWND_SEGMENTS * mss);
+  cwnd = std::min(cwnd, inflightHi);
+  if(mode == BbrMode::STARTUP) filledPipe = true;
+}
+
+//after a timeout everything in flight is presumed gone, the window restarts at one segment and regrows by what gets acked
+void BbrCongestion::onRto(uint32_t inFlight, bool firstTimeout){
+  cwnd = mss;
+}
+
+void BbrCongestion::onRttSample(std::chrono::duration<double> rtt){
+  pendingRtt = rtt;
+}
+
+CongestionAlgo BbrCongestion::getAlgo(){
+  return CongestionAlgo::BBR;
+}
+
+//before the first ack the rate comes from the initial window
+double BbrCongestion::getPacingRate(){
+  if(pacingRate <= 0) setPacingRate();
+  return pacingRate;
+}
+
+BbrMode BbrCongestion::getMode(){
+  return mode;
+}
+
+double BbrCongestion::getMaxBw(){
+  return bwFilter.empty() ? 0 : bwFilter.front().second;
+}
+
+std::chrono::duration<double> BbrCongestion::getMinRtt(){
+  return minRtt;
+}
+
+std::unique_ptr<CongestionControl> makeCongestionControl(CongestionAlgo algo, uint32_t mss){
+  std::unique_ptr<CongestionControl> cc;
+  switch(algo){
+    case CongestionAlgo::NEWRENO: cc.reset(new NewRenoCongestion()); break;
+    case CongestionAlgo::CUBIC: cc.reset(new CubicCongestion()); break;
+    case CongestionAlgo::BBR: cc.reset(new BbrCongestion()); break;
+  }
+  cc->init(mss, 0, UINT32_MAX);
+  return cc;
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <deque>
+#include <utility>
+
+enum class CongestionAlgo{
+  NEWRENO = 0,
+  CUBIC = 1,
+  BBR = 2
+};
+
+const CongestionAlgo DEFAULT_CONGESTION_ALGO = CongestionAlgo::CUBIC;
+const uint32_t INITIAL_WINDOW_BYTES = 14600; //RFC 6928 upper bound for the initial window
+const double CUBIC_C = 0.4; //RFC 9438 4.1
+const double CUBIC_BETA = 0.7; //RFC 9438 4.6
+const double BBR_HIGH_GAIN = 2.885; //2/ln(2), doubles the sending rate every round in startup
+const double BBR_CWND_GAIN = 2.0;
+const double BBR_PACING_GAIN_CYCLE[] = {1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0};
+const int BBR_CYCLE_LENGTH = 8;
+const uint64_t BBR_BW_WINDOW_ROUNDS = 10; //max bandwidth filter length
+const std::chrono::seconds BBR_MIN_RTT_WINDOW{10}; //min rtt filter length, probe rtt runs once it expires
+const std::chrono::milliseconds BBR_PROBE_RTT_DURATION{200};
+const double BBR_FULL_BW_THRESH = 1.25; //startup ends once bandwidth stops growing by this much
+const int BBR_FULL_BW_ROUNDS = 3;
+const uint32_t BBR_MIN_CWND_SEGMENTS = 4;
+const double BBR_LOSS_BETA = 0.7; //inflight cap after a loss, as a fraction of what was in flight
+
+//one delivery rate sample(draft-cheng-iccrg-delivery-rate-estimation), built from the most recently sent segment an ack delivered
+struct RateSample{
+  double deliveryRate = 0; //bytes per second, 0 if the ack gave no sample
+  uint64_t priorDelivered = 0; //bytes delivered when that segment was sent
+  std::chrono::duration<double> interval{0};
+  bool appLimited = false; //the sender ran out of data while that segment was in flight, so the rate may be low
+};
+
+//what a cumulative ack told the sender, handed to the controller once per ack that advances sUna
+struct AckEvent{
+  uint32_t ackedBytes = 0;
+  uint32_t inFlight = 0; //flight size before the ack
+  bool inRecovery = false; //loss recovery(fast or sack) is running, the window should not grow
+  std::chrono::steady_clock::time_point now;
+  uint64_t delivered = 0; //total bytes the peer is known to hold, after this ack
+  RateSample rate;
+};
+
+/*
+CongestionControl-
+Base for the per connection congestion controllers. The Tcb reports acks, losses, timeouts, rtt samples and sends through the hooks and
+trySend never lets more than getCwnd() bytes be in flight. Controllers own cwnd and ssthresh, the Tcb owns loss detection.
+*/
+class CongestionControl{
+  public:
+    virtual ~CongestionControl() = default;
+
+    virtual void onAck(const AckEvent& ev) = 0;
+    //loss found by dup acks or the sack scoreboard, called once when recovery starts
+    virtual void onLoss(uint32_t inFlight, std::chrono::steady_clock::time_point now) = 0;
+    //firstTimeout is false for the backed off timeouts that follow the first one for the same data
+    virtual void onRto(uint32_t inFlight, bool firstTimeout) = 0;
+    virtual void onRttSample(std::chrono::duration<double> rtt){}
+    virtual void onSend(uint32_t bytes, uint32_t inFlight, std::chrono::steady_clock::time_point now){}
+    virtual CongestionAlgo getAlgo() = 0;
+    //bytes per second the sender should pace at, 0 leaves sends unpaced
+    virtual double getPacingRate(){ return 0; }
+
+    void init(uint32_t mss, uint32_t cwnd, uint32_t ssthresh);
+    void setMss(uint32_t mss);
+    uint32_t getCwnd();
+    uint32_t getSsthresh();
+
+  protected:
+    void slowStartOrAvoid(uint32_t ackedBytes);
+    uint32_t lossSsthresh(uint32_t inFlight);
+
+    uint32_t mss = 0;
+    uint32_t cwnd = 0;
+    uint32_t ssthresh = UINT32_MAX;
+    uint32_t bytesAckedInAvoidance = 0;
+};
+
+//RFC 5681 slow start and congestion avoidance with the RFC 6582 window on entering recovery
+class NewRenoCongestion : public CongestionControl{
+  public:
+    void onAck(const AckEvent& ev) override;
+    void onLoss(uint32_t inFlight, std::chrono::steady_clock::time_point now) override;
+    void onRto(uint32_t inFlight, bool firstTimeout) override;
+    CongestionAlgo getAlgo() override;
+};
+
+//RFC 9438 CUBIC, with the reno friendly region and fast convergence
+class CubicCongestion : public CongestionControl{
+  public:
+    void onAck(const AckEvent& ev) override;
+    void onLoss(uint32_t inFlight, std::chrono::steady_clock::time_point now) override;
+    void onRto(uint32_t inFlight, bool firstTimeout) override;
+    void onRttSample(std::chrono::duration<double> rtt) override;
+    void onSend(uint32_t bytes, uint32_t inFlight, std::chrono::steady_clock::time_point now) override;
+    CongestionAlgo getAlgo() override;
+
+  private:
+    void reduce(std::chrono::steady_clock::time_point now);
+
+    double wMax = 0; //segments
+    double wLastMax = 0;
+    double k = 0; //seconds until the curve is back at wMax
+    double wEst = 0; //reno friendly estimate, segments
+    bool epochStarted = false;
+    std::chrono::steady_clock::time_point epochStart;
+    std::chrono::steady_clock::time_point lastSend;
+    std::chrono::duration<double> minRtt{0};
+};
+
+enum class BbrMode{
+  STARTUP = 0,
+  DRAIN = 1,
+  PROBE_BW = 2,
+  PROBE_RTT = 3
+};
+
+/*
+BbrCongestion-
+Model based control in the style of BBR(draft-cardwell-iccrg-bbr-congestion-control). The window and pacing rate follow windowed estimates of
+the bottleneck bandwidth and the round trip propagation delay rather than loss. Like BBRv2, a loss caps the data in flight(inflightHi) until
+the next probe for more bandwidth.
+*/
+class BbrCongestion : public CongestionControl{
+  public:
+    void onAck(const AckEvent& ev) override;
+    void onLoss(uint32_t inFlight, std::chrono::steady_clock::time_point now) override;
+    void onRto(uint32_t inFlight, bool firstTimeout) override;
+    void onRttSample(std::chrono::duration<double> rtt) override;
+    CongestionAlgo getAlgo() override;
+    double getPacingRate() override;
+
+    BbrMode getMode();
+    double getMaxBw();
+    std::chrono::duration<double> getMinRtt();
+
+  private:
+    void updateMaxBw(const AckEvent& ev);
+    void updateMinRtt(const AckEvent& ev);
+    void checkFullPipe(const AckEvent& ev);
+    void advanceCycle(const AckEvent& ev);
+    void checkProbeRtt(const AckEvent& ev);
+    void enterProbeBw(std::chrono::steady_clock::time_point now);
+    void setPacingRate();
+    void setCwnd(const AckEvent& ev);
+    uint32_t bdp(double gain);
+
+    BbrMode mode = BbrMode::STARTUP;
+    double pacingGain = BBR_HIGH_GAIN;
+    double pacingRate = 0;
+
+    //round trips are counted in delivered bytes, a round ends once a segment sent after it began is delivered
+    uint64_t roundCount = 0;
+    uint64_t nextRoundDelivered = 0;
+    bool roundStart = false;
+
+    std::deque<std::pair<uint64_t, double> > bwFilter; //(round, bytes per second), front is the max
+    std::chrono::duration<double> minRtt{0};
+    std::chrono::duration<double> pendingRtt{0};
+    std::chrono::steady_clock::time_point minRttStamp;
+    bool minRttExpired = false;
+
+    bool filledPipe = false;
+    double fullBw = 0;
+    int fullBwCount = 0;
+
+    int cycleIndex = 0;
+    std::chrono::steady_clock::time_point cycleStamp;
+
+    bool probeRttDoneSet = false;
+    std::chrono::steady_clock::time_point probeRttDone;
+    uint32_t priorCwnd = 0;
+    uint32_t inflightHi = UINT32_MAX;
+};
+
+std::unique_ptr<CongestionControl> makeCongestionControl(CongestionAlgo algo, uint32_t mss);
@@ -1,19 +1,22 @@
 #include "driver.h"
 #include "state.h"
-#include <poll.h>
 #include <climits>
+#include <chrono>
 #include "ipPacket.h"
 #include "tcpPacket.h"
 #include <cstdint>
 #include <queue>
 #include "network.h"
+#include "reactor.h"
+#include <functional>
+#include <sys/prctl.h>
 
 using namespace std;
 
 const uint32_t bestLocalAddr=1;
 
 //range from dynPortStart to dynPortEnd
-unordered_map<uint16_t,bool> usedPorts;
+thread_local unordered_map<uint16_t,bool> usedPorts;
 
 std::size_t ConnHash::operator()(const ConnPair& p) const {
   
@@ -23,31 +26,74 @@ std::size_t ConnHash::operator()(const ConnPair& p) const {
   (std::hash<uint16_t>{}(p.second.second) << 3);
 }
 
-std::unordered_map<int, ConnPair> idMap;
-ConnectionMap connections;
+thread_local std::unordered_map<int, ConnPair> idMap;
+thread_local ConnectionMap connections;
+
+//ids of connections that may be able to make send/receive progress. Only these are serviced by the driver loop, so idle connections cost nothing per iteration.
+//membership is tracked inside the tcb itself so a connection is never queued twice.
+thread_local std::deque<int> sendReadyList;
+thread_local std::deque<int> recReadyList;
+thread_local std::deque<int> ackReadyList;
+
+//a connection waiting in the paced queue for its next departure time
+struct PacedSend{
+  std::chrono::steady_clock::time_point release;
+  int id;
+  bool operator>(const PacedSend& other) const{ return release > other.release; }
+};
+//earliest departure first, shared by every paced connection on the shard so one timer covers them all
+thread_local std::priority_queue<PacedSend, std::vector<PacedSend>, std::greater<PacedSend> > pacedQueue;
+
+//a connection's earliest timer deadline(rto, probe, reorder, delayed ack, sws or time wait). Connections with no timer running are not in the queue,
+//so idle connections cost nothing per wakeup. Entries are left in place when a timer is stopped or pushed back and skipped once they come up
+struct TimerEntry{
+  std::chrono::steady_clock::time_point deadline;
+  int id;
+  bool operator>(const TimerEntry& other) const{ return deadline > other.deadline; }
+};
+thread_local std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry> > timerQueue;
+thread_local std::vector<int> dueTimers;
+
+Reactor reactor;
 
 
 //simulates passing a passing an info/error message to a hooked up application that is not applicable to a made connection.
 void notifyApp(App* app, TcpCode c, uint32_t eId){
-  app->getAppNotifs().push_back(c);
+  notifyApp(app, NO_CONN_ID, c, eId, 0);
 }
 
 void notifyApp(App* app, int connId, TcpCode c, uint32_t eId){
-  app->getConnNotifs()[connId].push_back(c);
+  notifyApp(app, connId, c, eId, 0);
+}
+
+void notifyApp(App* app, int connId, TcpCode c, uint32_t eId, uint32_t byteCount){
+  notifyApp(app, connId, c, eId, byteCount, 0);
+}
+
+void notifyApp(App* app, int connId, TcpCode c, uint32_t eId, uint32_t byteCount, uint64_t userData){
+  AppNotif n;
+  n.connId = connId;
+  n.eventId = eId;
+  n.code = c;
+  n.byteCount = byteCount;
+  n.userData = userData;
+  app->pushNotif(n);
 }
 
 /*pickDynPort 
 picks an unused port from the dynamic range
 if for some reason it cant find one, returns 0(unspecified)
 the user should check for unspecified as an error
+when sharded, only ports that make the flow hash back to the current shard are considered, otherwise the peer's replies would be steered to another shard
 */
-uint16_t pickDynPort(){
+uint16_t pickDynPort(uint32_t localAddr, RemotePair rP){
   
-  for(uint16_t p = DYN_PORT_START; p <= DYN_PORT_END; p++){
-    if(usedPorts.find(p) == usedPorts.end()){
-      usedPorts[p] = true;
-      return p;
-    }
+  bool steer = (shardCount > 1) && (rP.first != UNSPECIFIED) && (rP.second != UNSPECIFIED);
+  for(uint32_t p = DYN_PORT_START; p <= DYN_PORT_END; p++){
+    if(usedPorts.find(p) != usedPorts.end()) continue;
+    if(steer && !ownsFlow(ConnPair(LocalPair(localAddr, p), rP))) continue;
+    usedPorts[p] = true;
+    return p;
   }
   return UNSPECIFIED;
 
@@ -56,9 +102,10 @@ uint16_t pickDynPort(){
 /*pickId
 picks an available id to map a connection to. 
 returns bool specifying whether it worked or not
+ids are striped across shards(shard i only hands out ids equal to i mod shardCount) so they stay unique process wide
 */
 bool pickId(int& id){
-  for(int i = 0; i <= INT_MAX; i++){
+  for(int i = shardIndex; i <= INT_MAX - shardCount; i += shardCount){
     if(idMap.find(i) == idMap.end()){
       id = i;
       return true;
@@ -85,6 +132,42 @@ uint32_t pickDynAddr(){
   return bestLocalAddr;
 }
 
+/*
+findConn-
+looks up a connection by id, returns nullptr if the id is no longer mapped to a live connection(ie it was removed after being queued)
+*/
+Tcb* findConn(int id){
+  auto idIter = idMap.find(id);
+  if(idIter == idMap.end()) return nullptr;
+  auto connIter = connections.find(idIter->second);
+  if(connIter == connections.end()) return nullptr;
+  return &connIter->second;
+}
+
+void scheduleSend(Tcb& b){
+  if(b.markSendReady()) sendReadyList.push_back(b.getId());
+}
+
+void scheduleRec(Tcb& b){
+  if(b.markRecReady()) recReadyList.push_back(b.getId());
+}
+
+void scheduleAck(Tcb& b){
+  if(b.markAckPending()) ackReadyList.push_back(b.getId());
+}
+
+void schedulePacedSend(Tcb& b, std::chrono::steady_clock::time_point release){
+  if(b.markPacedQueued()) pacedQueue.push(PacedSend{release, b.getId()});
+}
+
+//called whenever a connection arms a timer, queues it again if that timer is now its earliest deadline.
+//A connection without an id yet can't be found from the queue, so it is left unqueued rather than marked as queued
+void scheduleTimer(Tcb& b){
+  if(b.getId() == NO_CONN_ID) return;
+  std::chrono::steady_clock::time_point deadline;
+  if(b.nextTimerDeadline(deadline) && b.markTimerQueued(deadline)) timerQueue.push(TimerEntry{deadline, b.getId()});
+}
+
 void removeConn(Tcb& b){
 
   reclaimId(b.getId());
@@ -103,6 +186,54 @@ LocalCode remConnOnly(int socket, Tcb& b){
   return LocalCode::SUCCESS;
 }
 
+/*
+demultiplexSegment-
+gives a segment to the connection it belongs to, most specific match first, and answers for the fictional closed state when nothing matches.
+Also used by time wait when a new syn takes over its connection pair.
+*/
+LocalCode demultiplexSegment(int socket, SegmentEv& ev, RemoteCode& remCode){
+
+  IpPacket& ipP = ev.getIpPacket();
+  TcpPacket& p = ipP.getTcpPacket();
+  LocalPair lP(ipP.getDestAddr(), p.getDestPort());
+  RemotePair rP(ipP.getSrcAddr(), p.getSrcPort());
+  ConnPair cPair(lP,rP);
+
+  if(connections.find(cPair) != connections.end()){
+    return connections[cPair].processEventEntry(socket,ev, remCode);
+  }
+  RemotePair addrUnspec(UNSPECIFIED, rP.second);
+  cPair.second = addrUnspec;
+  if(connections.find(cPair) != connections.end()){
+    return connections[cPair].processEventEntry(socket,ev, remCode);
+  }
+  RemotePair portUnspec(rP.first, UNSPECIFIED);
+  cPair.second = portUnspec;
+  if(connections.find(cPair) != connections.end() ){
+    return connections[cPair].processEventEntry(socket,ev, remCode);
+  }
+  RemotePair fullUnspec(UNSPECIFIED, UNSPECIFIED);
+  cPair.second = fullUnspec;
+  if(connections.find(cPair) != connections.end()){
+    return connections[cPair].processEventEntry(socket,ev, remCode);
+  }
+  
+  //if we've gotten to this point no conn exists: fictional closed state
+  bool sent = false;
+  if(!p.getFlag(TcpPacketFlags::RST)){
+    if(p.getFlag(TcpPacketFlags::ACK)){
+      sent = Tcb::sendReset(socket, lP, rP, 0, false, p.getAckNum());
+    }
+    else{
+      sent = Tcb::sendReset(socket, lP, rP, p.getSeqNum() + p.getSegSize(),true,0);
+    }
+  }
+  
+  remCode = RemoteCode::UNEXPECTEDPACKET;
+  if(!sent) return LocalCode::SOCKET;
+  else return LocalCode::SUCCESS;
+}
+
 /*
 multiplexIncoming-
 Upon notification of incoming packet on interface, this method
@@ -112,13 +243,15 @@ to a valid connection
 LocalCode multiplexIncoming(int socket, RemoteCode& remCode){
 
   IpPacket retPacket;
-  SegmentEv ev(retPacket,0);
   
   IpPacketCode pCode = IpPacketCode::SUCCESS;
-  bool goodRec = recPacket(socket,retPacket, pCode);
+  bool wouldBlock = false;
+  bool goodRec = recPacket(socket,retPacket, pCode, wouldBlock);
   if(!goodRec){
+    if(wouldBlock) return LocalCode::WOULDBLOCK;
     return LocalCode::SOCKET;
   }
+  SegmentEv ev(retPacket,0);
   if(pCode == IpPacketCode::SUCCESS){
     TcpPacket& p = retPacket.getTcpPacket();
     uint32_t sourceAddress = retPacket.getDestAddr();
@@ -132,43 +265,7 @@ LocalCode multiplexIncoming(int socket, RemoteCode& remCode){
       return LocalCode::SUCCESS;
     }
     
-    LocalPair lP(sourceAddress, sourcePort);
-    RemotePair rP(destAddress, destPort);
-    
-    ConnPair cPair(lP,rP);
-    if(connections.find(cPair) != connections.end()){
-      return connections[cPair].processEventEntry(socket,ev, remCode);
-    }
-    RemotePair addrUnspec(UNSPECIFIED, rP.second);
-    cPair.second = addrUnspec;
-    if(connections.find(cPair) != connections.end()){
-      return connections[cPair].processEventEntry(socket,ev, remCode);
-    }
-    RemotePair portUnspec(rP.first, UNSPECIFIED);
-    cPair.second = portUnspec;
-    if(connections.find(cPair) != connections.end() ){
-      return connections[cPair].processEventEntry(socket,ev, remCode);
-    }
-    RemotePair fullUnspec(UNSPECIFIED, UNSPECIFIED);
-    cPair.second = fullUnspec;
-    if(connections.find(cPair) != connections.end()){
-      return connections[cPair].processEventEntry(socket,ev, remCode);
-    }
-    
-    //if we've gotten to this point no conn exists: fictional closed state
-    bool sent = false;
-    if(!p.getFlag(TcpPacketFlags::RST)){
-      if(p.getFlag(TcpPacketFlags::ACK)){
-        sent = Tcb::sendReset(socket, lP, rP, 0, false, p.getAckNum());
-      }
-      else{
-        sent = Tcb::sendReset(socket, lP, rP, p.getSeqNum() + p.getSegSize(),true,0);
-      }
-    }
-    
-    remCode = RemoteCode::UNEXPECTEDPACKET;
-    if(!sent) return LocalCode::SOCKET;
-    else return LocalCode::SUCCESS;
+    return demultiplexSegment(socket, ev, remCode);
     
   }
   else{
@@ -213,34 +310,59 @@ LocalCode multiplexIncoming(int socket, RemoteCode& remCode){
   
 }
 
+//only the connections that were ready at the start of the call are serviced, anything that requeues itself waits for the next loop iteration.
 LocalCode tryConnectionSends(int socket){
-  for(auto iter = connections.begin(); iter != connections.end(); iter++){
-    Tcb& b = iter->second;
-    LocalCode c = b.trySend(socket);
+  size_t numReady = sendReadyList.size();
+  for(size_t i = 0; i < numReady; i++){
+    int id = sendReadyList.front();
+    sendReadyList.pop_front();
+    Tcb* b = findConn(id);
+    if(b == nullptr) continue;
+    b->clearSendReady();
+    LocalCode c = b->trySend(socket);
     if(c != LocalCode::SUCCESS) return c;
   }
   return LocalCode::SUCCESS;
 }
 
-void tryConnectionRecs(){  
-  for(auto iter = connections.begin(); iter != connections.end(); iter++){
-    Tcb& b = iter->second;
-    b.tryProcessReads();
+//moves connections whose departure time has come from the paced queue onto the send ready list
+void releasePacedSends(){
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  while(!pacedQueue.empty() && pacedQueue.top().release <= now){
+    int id = pacedQueue.top().id;
+    pacedQueue.pop();
+    Tcb* b = findConn(id);
+    if(b == nullptr) continue;
+    b->clearPacedQueued();
+    scheduleSend(*b);
   }
 }
 
-void checkConnectionTimeWaits(){
-  for(auto iter = connections.begin(); iter != connections.end();){
-    Tcb& b = iter->second;
-    if(b.timeWaitTimerExpired()){
-      iter = connections.erase(iter);
-    }
-    else{
-      iter++;
-    }
+//sends the acks still owed at the end of a loop iteration, one per connection however many segments arrived. Connections that sent data since are skipped
+LocalCode flushPendingAcks(int socket){
+  while(!ackReadyList.empty()){
+    int id = ackReadyList.front();
+    ackReadyList.pop_front();
+    Tcb* b = findConn(id);
+    if(b == nullptr) continue;
+    if(!b->flushPendingAck(socket)) return LocalCode::SOCKET;
   }
+  return LocalCode::SUCCESS;
 }
 
+void tryConnectionRecs(){
+  size_t numReady = recReadyList.size();
+  for(size_t i = 0; i < numReady; i++){
+    int id = recReadyList.front();
+    recReadyList.pop_front();
+    Tcb* b = findConn(id);
+    if(b == nullptr) continue;
+    b->clearRecReady();
+    b->tryProcessReads();
+  }
+}
+
+
 LocalCode checkSavedPreEstabProcessing(int socket, RemoteCode& remCode){
   for(auto iter = connections.begin(); iter != connections.end(); iter++){
     Tcb& b = iter->second;
@@ -252,16 +374,78 @@ LocalCode checkSavedPreEstabProcessing(int socket, RemoteCode& remCode){
   return LocalCode::SUCCESS;
 }
 
-LocalCode checkRTO(int socket){
-  for(auto iter = connections.begin(); iter != connections.end(); iter++){
-    Tcb& b = iter->second;
+//true if the entry still matches what its connection has queued
+bool timerEntryLive(const TimerEntry& t){
+  Tcb* b = findConn(t.id);
+  return b != nullptr && b->timerQueuedFor(t.deadline);
+}
+
+/*
+serviceTimers-
+fires any expired rto, probe, reorder, delayed ack, sws and time wait timers of the connections whose timer queue entries are due, then takes the
+earliest deadline still pending from the timer and paced queues so the reactor timer can be armed for it. haveDeadline is false if nothing is
+waiting on a timer.
+*/
+LocalCode serviceTimers(int socket, std::chrono::steady_clock::time_point& nextDeadline, bool& haveDeadline){
+
+  haveDeadline = false;
+  //taken off the queue before any callback runs, a timer left running past its deadline(ex: sws) is queued again for the next iteration
+  //rather than coming straight back up here
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  dueTimers.clear();
+  while(!timerQueue.empty() && timerQueue.top().deadline <= now){
+    TimerEntry t = timerQueue.top();
+    timerQueue.pop();
+    if(!timerEntryLive(t)) continue;
+    findConn(t.id)->clearTimerQueued();
+    dueTimers.push_back(t.id);
+  }
+
+  for(int id : dueTimers){
+    Tcb* conn = findConn(id);
+    if(conn == nullptr) continue;
+    Tcb& b = *conn;
+    
+    if(b.timeWaitTimerExpired()){
+      removeConn(b);
+      continue;
+    }
     if(b.rtoTimerExpired()){
-      if(!rtoExpireCallback(socket)) return LocalCode::SOCKET;
+      if(!b.rtoExpireCallback(socket)) return LocalCode::SOCKET;
+    }
+    if(b.probeTimerExpired()){
+      if(!b.probeTimeoutCallback(socket)) return LocalCode::SOCKET;
+    }
+    if(b.reorderTimerExpired()){
+      if(!b.reorderTimeoutCallback(socket)) return LocalCode::SOCKET;
     }
+    if(b.delAckTimerExpired()){
+      if(!b.delAckTimeoutCallback(socket)) return LocalCode::SOCKET;
+    }
+    if(b.swsTimerExpired()){
+      scheduleSend(b);
+    }
+    //whatever is still running, or was armed again by the callbacks, gets its next entry
+    scheduleTimer(b);
+  }
+  //a stale entry on top would only cost an early wakeup, but dropping it here keeps the reactor armed for a real deadline
+  while(!timerQueue.empty() && !timerEntryLive(timerQueue.top())) timerQueue.pop();
+  if(!timerQueue.empty()){
+    nextDeadline = timerQueue.top().deadline;
+    haveDeadline = true;
+  }
+  if(!pacedQueue.empty() && (!haveDeadline || pacedQueue.top().release < nextDeadline)){
+    nextDeadline = pacedQueue.top().release;
+    haveDeadline = true;
   }
   return LocalCode::SUCCESS;
 }
 
+//wakes the driver loop up from another thread, ie after an app has handed it new work.
+bool wakeTcp(){
+  return reactor.wake();
+}
+
 LocalCode send(App* app, int socket, bool urgent, deque<uint8_t>& data, LocalPair lP, RemotePair rP, bool push, uint32_t timeout){
 
   SendEv ev(data,urgent,push,0);
@@ -292,6 +476,47 @@ LocalCode receive(App* app, int socket, uint32_t amount, std::vector<uint8_t>& b
 
 }
 
+/*
+sendZeroCopy-
+Sends len bytes straight from the app's memory, with no copy into the connection's send buffer. The app must leave them untouched until
+the connection reports ZEROCOPYDONE for the send(or fails it).
+*/
+LocalCode sendZeroCopy(App* app, int socket, bool urgent, const uint8_t* data, uint32_t len, LocalPair lP, RemotePair rP, bool push){
+
+  SendEv ev(data, len, urgent, push, 0);
+  ConnPair p(lP,rP);
+
+  if(connections.find(p) != connections.end()){
+    Tcb& oldConn = connections[p];
+    return oldConn.processEventEntry(socket, ev);
+  }
+
+  notifyApp(app,TcpCode::NOCONNEXISTS, ev.getId());
+  return LocalCode::SUCCESS;
+
+}
+
+/*
+receive-
+Reads into memory the app registered rather than a buffer the event owns. dest must stay valid for capacity bytes until the read completes,
+which is as soon as lowWater bytes are available(up to capacity are copied then). Completion is a RECEIVEDONE notification carrying userData and
+the bytes filled, any other code with userData(ex: CONNCLOSING, CONNRST) means the read ended without data and dest is free as well.
+*/
+LocalCode receive(App* app, int socket, uint8_t* dest, uint32_t capacity, uint32_t lowWater, uint64_t userData, LocalPair lP, RemotePair rP){
+
+  ReceiveEv ev(dest, capacity, lowWater, userData, 0);
+
+  ConnPair p(lP, rP);
+  if(connections.find(p) != connections.end()){
+      Tcb& oldConn = connections[p];
+      return oldConn.processEventEntry(socket, ev);
+  }
+
+  notifyApp(app, NO_CONN_ID, TcpCode::NOCONNEXISTS, ev.getId(), 0, userData);
+  return LocalCode::SUCCESS;
+
+}
+
 LocalCode close(App* app, int socket, LocalPair lP, RemotePair rP){
 
   CloseEv ev(0);
@@ -320,6 +545,75 @@ LocalCode abort(App* app, int socket, LocalPair lP, RemotePair rP){
   return LocalCode::SUCCESS;
 }
 
+/*
+setBufferSizes-
+Sets the send and/or receive buffer size of a connection, a size of 0 leaves that side as it is(and still autotuned). Sizes set this way are
+no longer autotuned. The app is told RESOURCES if the global buffer budget cannot cover the request.
+*/
+LocalCode setBufferSizes(App* app, LocalPair lP, RemotePair rP, uint32_t sendBytes, uint32_t recBytes){
+
+  ConnPair p(lP, rP);
+  if(connections.find(p) == connections.end()){
+    notifyApp(app, TcpCode::NOCONNEXISTS, 0);
+    return LocalCode::SUCCESS;
+  }
+
+  Tcb& b = connections[p];
+  bool ok = true;
+  if(sendBytes > 0) ok = b.setSendBufferSize(sendBytes);
+  if(ok && recBytes > 0) ok = b.setRecBufferSize(recBytes);
+  if(!ok) notifyApp(app, b.getId(), TcpCode::RESOURCES, 0);
+  return LocalCode::SUCCESS;
+}
+
+//picks the congestion controller for one connection, the default is DEFAULT_CONGESTION_ALGO
+LocalCode setCongestionControl(App* app, LocalPair lP, RemotePair rP, CongestionAlgo algo){
+
+  ConnPair p(lP, rP);
+  if(connections.find(p) == connections.end()){
+    notifyApp(app, TcpCode::NOCONNEXISTS, 0);
+    return LocalCode::SUCCESS;
+  }
+  connections[p].setCongestionAlgo(algo);
+  return LocalCode::SUCCESS;
+}
+
+//lowers(or raises) the bound a connection's computed rto may not go below, RTO_FLOOR_MILLISECONDS by default
+LocalCode setRtoFloor(App* app, LocalPair lP, RemotePair rP, uint32_t milliseconds){
+
+  ConnPair p(lP, rP);
+  if(connections.find(p) == connections.end()){
+    notifyApp(app, TcpCode::NOCONNEXISTS, 0);
+    return LocalCode::SUCCESS;
+  }
+  connections[p].setRtoFloor(std::chrono::milliseconds(milliseconds));
+  return LocalCode::SUCCESS;
+}
+
+//sets how long a connection may hold an ack for in order data, capped at DEL_ACK_MILLISECONDS. 0 acks every segment straight away
+LocalCode setDelayedAck(App* app, LocalPair lP, RemotePair rP, uint32_t milliseconds){
+
+  ConnPair p(lP, rP);
+  if(connections.find(p) == connections.end()){
+    notifyApp(app, TcpCode::NOCONNEXISTS, 0);
+    return LocalCode::SUCCESS;
+  }
+  connections[p].setDelayedAck(std::chrono::milliseconds(milliseconds));
+  return LocalCode::SUCCESS;
+}
+
+//turns pacing of a connection's sends on or off, on by default
+LocalCode setPacing(App* app, LocalPair lP, RemotePair rP, bool on){
+
+  ConnPair p(lP, rP);
+  if(connections.find(p) == connections.end()){
+    notifyApp(app, TcpCode::NOCONNEXISTS, 0);
+    return LocalCode::SUCCESS;
+  }
+  connections[p].setPacing(on);
+  return LocalCode::SUCCESS;
+}
+
 /*
 open-
 Models an open event call from an app to a kernel.
@@ -350,6 +644,39 @@ LocalCode open(App* app, int socket, bool passive, LocalPair lP, RemotePair rP,
   
 }
 
+//carries out an app command that was posted to this shard's mailbox
+LocalCode runShardCommand(int socket, ShardCommand& cmd){
+
+  switch(cmd.type){
+    case ShardCommandType::OPEN:{
+      int createdId = 0;
+      return open(cmd.app, socket, cmd.passive, cmd.lP, cmd.rP, createdId);
+    }
+    case ShardCommandType::SEND:
+      if(cmd.sendBuffer != nullptr) return sendZeroCopy(cmd.app, socket, cmd.urgent, cmd.sendBuffer, cmd.amount, cmd.lP, cmd.rP, cmd.push);
+      return send(cmd.app, socket, cmd.urgent, cmd.data, cmd.lP, cmd.rP, cmd.push, 0);
+    case ShardCommandType::RECEIVE:{
+      if(cmd.recBuffer != nullptr) return receive(cmd.app, socket, cmd.recBuffer, cmd.amount, cmd.lowWater, cmd.userData, cmd.lP, cmd.rP);
+      std::vector<uint8_t> buff;
+      return receive(cmd.app, socket, cmd.amount, buff, cmd.lP, cmd.rP);
+    }
+    case ShardCommandType::CLOSE:
+      return close(cmd.app, socket, cmd.lP, cmd.rP);
+    case ShardCommandType::ABORT:
+      return abort(cmd.app, socket, cmd.lP, cmd.rP);
+  }
+  return LocalCode::SUCCESS;
+}
+
+LocalCode drainMailbox(int socket, ShardMailbox& mailbox){
+  ShardCommand cmd;
+  while(mailbox.pop(cmd)){
+    LocalCode c = runShardCommand(socket, cmd);
+    if(c != LocalCode::SUCCESS) return c;
+  }
+  return LocalCode::SUCCESS;
+}
+
 /*
 entryTcp-
 Starts the tcp implementation, equivalent to a tcp module being loaded.
@@ -361,31 +688,81 @@ LocalCode entryTcp(char* sourceAddr){
   bool worked = bindSocket(sourceAddr, socket);
   if(!worked){
     return LocalCode::SOCKET;
-  }  
+  }
+  if(!reactor.init(socket)){
+    return LocalCode::SOCKET;
+  }
+  return runDriverLoop(socket, reactor, nullptr, nullptr);
+}
+
+/*
+runDriverLoop-
+main loop shared by entryTcp and the shard workers. mailbox and running are only used by shards(null otherwise), 
+the loop exits once running is cleared.
+*/
+LocalCode runDriverLoop(int socket, Reactor& r, ShardMailbox* mailbox, const std::atomic<bool>* running){
+
   LocalCode c = LocalCode::SUCCESS;
   RemoteCode remCode = RemoteCode::SUCCESS;
 
-  struct pollfd pollItem;
-  pollItem.fd = socket;
-  pollItem.events = POLLIN; //read
-  while(true){
+  DriverLoopScope loopScope;
+  //socket is edge triggered, so this stays set until a read actually reports the socket is drained
+  bool socketPending = false;
+  //pacing gaps are tens of microseconds, best effort since a failure only costs accuracy
+  prctl(PR_SET_TIMERSLACK, PACE_TIMER_SLACK_NANOSECONDS);
+  while(running == nullptr || running->load(std::memory_order_acquire)){
+  
+    if(mailbox != nullptr){
+      c = drainMailbox(socket, *mailbox);
+      if(c != LocalCode::SUCCESS) return c;
+    }
+    c = drainAppRings(socket);
+    if(c != LocalCode::SUCCESS) return c;
   
     c = checkSavedPreEstabProcessing(socket,remCode);
     if(c != LocalCode::SUCCESS) return c;
     if(remCode != RemoteCode::SUCCESS) return LocalCode::SUCCESS;
 
-    int numRet = poll(&pollItem, 1, -1);
-    if((numRet > 0) && (pollItem.revents & POLLIN)){
-      multiplexIncoming(socket, remCode);
+    //bounded so a flood of incoming packets cant starve timers and sends, anything left over is picked up next iteration
+    for(int i = 0; socketPending && i < RECV_BATCH_MAX; i++){
+      if(multiplexIncoming(socket, remCode) == LocalCode::WOULDBLOCK){
+        socketPending = false;
+      }
     }
-
-    c = checkRTO(socket);
-    if(c != LocalCode::SUCCESS) return c;
       
+    releasePacedSends();
     c = tryConnectionSends(socket);
     if(c != LocalCode::SUCCESS) return c;
     tryConnectionRecs();
-    checkConnectionTimeWaits();
+    
+    std::chrono::steady_clock::time_point nextDeadline;
+    bool haveDeadline = false;
+    c = serviceTimers(socket, nextDeadline, haveDeadline);
+    if(c != LocalCode::SUCCESS) return c;
+
+    //last, so any ack that could ride on data sent this iteration already has
+    c = flushPendingAcks(socket);
+    if(c != LocalCode::SUCCESS) return c;
+    
+    bool armed = haveDeadline ? r.armTimer(nextDeadline) : r.disarmTimer();
+    if(!armed) return LocalCode::SOCKET;
+    
+    //only sleep if there is nothing left to do right now
+    bool block = !socketPending && sendReadyList.empty() && recReadyList.empty();
+    if(block){
+      //advertise the sleep before the last look at the app rings, a racing submit is either seen here or wakes the reactor
+      setDriverIdle(true);
+      block = !appRingsPending();
+    }
+    bool socketReady = false;
+    bool timerFired = false;
+    bool woken = false;
+    bool waited = r.wait(block, socketReady, timerFired, woken);
+    setDriverIdle(false);
+    if(!waited){
+      return LocalCode::SOCKET;
+    }
+    if(socketReady) socketPending = true;
   
   }
   
@@ -8,31 +8,57 @@ typedef std::pair<uint32_t, uint16_t> RemotePair;
 typedef std::pair<LocalPair, RemotePair> ConnPair;
 
 #include "state.h"
+#include "shard.h"
+#include <atomic>
 
 struct ConnHash{
   std::size_t operator()(const ConnPair& p) const;
 };
 
 typedef std::unordered_map<ConnPair, Tcb, ConnHash > ConnectionMap;
-extern std::unordered_map<int, ConnPair> idMap;
-extern ConnectionMap connections;
+//each shard thread owns its own connection table, so these are per thread
+extern thread_local std::unordered_map<int, ConnPair> idMap;
+extern thread_local ConnectionMap connections;
 
 const uint16_t DYN_PORT_START = 49152;
 const uint16_t DYN_PORT_END = 65535;
+const int RECV_BATCH_MAX = 64; //max packets read off the socket per driver loop iteration
+const unsigned long PACE_TIMER_SLACK_NANOSECONDS = 1000; //the kernel's default 50us timer slack would swamp pacing gaps
 
 void notifyApp(App* app, int connId, TcpCode c, uint32_t eId);
+void notifyApp(App* app, int connId, TcpCode c, uint32_t eId, uint32_t byteCount);
+void notifyApp(App* app, int connId, TcpCode c, uint32_t eId, uint32_t byteCount, uint64_t userData);
 LocalCode remConnFlushAll(int socket, Tcb& b, Event& e);
 LocalCode remConnOnly(int socket, Tcb& b);
+LocalCode demultiplexSegment(int socket, SegmentEv& ev, RemoteCode& remCode);
+
+void scheduleSend(Tcb& b);
+void scheduleRec(Tcb& b);
+void scheduleAck(Tcb& b);
+void schedulePacedSend(Tcb& b, std::chrono::steady_clock::time_point release);
+void scheduleTimer(Tcb& b);
+Tcb* findConn(int id);
 
 void reclaimId(int id);
-uint16_t pickDynPort();
+uint16_t pickDynPort(uint32_t localAddr, RemotePair rP);
 bool pickId(int& id);
 uint32_t pickDynAddr();
 void removeConn(Tcb& b);
 
 LocalCode send(App* app, bool urgent, std::vector<uint8_t>& data, LocalPair lP, RemotePair rP);
+LocalCode sendZeroCopy(App* app, int socket, bool urgent, const uint8_t* data, uint32_t len, LocalPair lP, RemotePair rP, bool push);
 LocalCode receive(App* app, bool urgent, uint32_t amount, LocalPair lP, RemotePair rP);
+LocalCode receive(App* app, int socket, uint8_t* dest, uint32_t capacity, uint32_t lowWater, uint64_t userData, LocalPair lP, RemotePair rP);
 LocalCode close(App* app, int socket, LocalPair lP, RemotePair rP);
 LocalCode abort(App* app, int socket, LocalPair lP, RemotePair rP);
 LocalCode open(App* app, int socket, bool passive, LocalPair lP, RemotePair rP, int& createdId);
+LocalCode setBufferSizes(App* app, LocalPair lP, RemotePair rP, uint32_t sendBytes, uint32_t recBytes);
+LocalCode setCongestionControl(App* app, LocalPair lP, RemotePair rP, CongestionAlgo algo);
+LocalCode setRtoFloor(App* app, LocalPair lP, RemotePair rP, uint32_t milliseconds);
+LocalCode setDelayedAck(App* app, LocalPair lP, RemotePair rP, uint32_t milliseconds);
+LocalCode setPacing(App* app, LocalPair lP, RemotePair rP, bool on);
 LocalCode entryTcp(char* sourceAddr);
+LocalCode runShardCommand(int socket, ShardCommand& cmd);
+LocalCode serviceTimers(int socket, std::chrono::steady_clock::time_point& nextDeadline, bool& haveDeadline);
+LocalCode runDriverLoop(int socket, Reactor& r, ShardMailbox* mailbox, const std::atomic<bool>* running);
+bool wakeTcp();
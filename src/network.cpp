@@ -5,11 +5,21 @@
 #include <cstdio>
 #include <iostream>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <ctime>
+#include <linux/net_tstamp.h>
 #include "../tests/testingUtil.h"
 
 using namespace std;
 
 uint8_t ipBuffer[IP_PACKET_MAX_SIZE];
+//set by setTxTimeOffload, SO_TXTIME is only asked for when this is on
+std::atomic<bool> txTimeWanted(false);
+//set once the raw socket accepts SO_TXTIME, after which paced segments carry their departure time down to the qdisc
+std::atomic<bool> txTimeOn(false);
 
 //TODO: look into path mtu discovery.
 uint32_t getMtu(uint32_t destAddr){
@@ -50,11 +60,52 @@ bool bindSocket(char* sourceAddress, int& sRet){
     return false;
   }
   
+  //driver watches the socket edge triggered, so reads need to be able to run until the socket is drained
+  int flags = fcntl(s, F_GETFL, 0);
+  if(flags < 0 || fcntl(s, F_SETFL, flags | O_NONBLOCK) < 0){
+    return false;
+  }
+  
+  enableTxTime(s);
   sRet = s;
   return true;
 
 }
 
+/*
+setTxTimeOffload-
+opts in to handing paced segments to the qdisc ahead of their departure time. Off by default: setsockopt(SO_TXTIME) succeeds whatever qdisc is
+installed, but only fq and etf honour the time, anything else(fq_codel, pfifo) sends early segments straight away and pacing turns into bursts.
+Only turn it on when fq or etf is the egress qdisc. Applies to sockets bound afterwards, turning it off goes back to timing every segment here.
+*/
+void setTxTimeOffload(bool on){
+  txTimeWanted.store(on, std::memory_order_relaxed);
+  if(!on) txTimeOn.store(false, std::memory_order_relaxed);
+}
+
+/*
+enableTxTime-
+asks the kernel to hold each segment until the departure time it is sent with, when setTxTimeOffload opted in. Best effort,
+without it the driver's paced queue does all of the timing. steady_clock is CLOCK_MONOTONIC on linux, so its times can be handed over as is.
+*/
+bool enableTxTime(int sock){
+  if(!txTimeWanted.load(std::memory_order_relaxed)) return false;
+  #ifdef SO_TXTIME
+    struct sock_txtime cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.clockid = CLOCK_MONOTONIC;
+    if(setsockopt(sock, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) == 0){
+      txTimeOn.store(true, std::memory_order_relaxed);
+      return true;
+    }
+  #endif
+  return false;
+}
+
+bool txTimeEnabled(){
+  return txTimeOn.load(std::memory_order_relaxed);
+}
+
 bool sendPacket(int sock, uint32_t destAddr, TcpPacket& p){  
   struct sockaddr_in dest;
   dest.sin_family = AF_INET;
@@ -76,14 +127,54 @@ bool sendPacket(int sock, uint32_t destAddr, TcpPacket& p){
   return true;
 }
 
+//sends p to leave no earlier than departure. Falls back to an immediate send when offload is off or the time has already come
+bool sendPacket(int sock, uint32_t destAddr, TcpPacket& p, std::chrono::steady_clock::time_point departure){
+  #if defined(TEST_NO_SEND) || !defined(SO_TXTIME)
+    return sendPacket(sock, destAddr, p);
+  #else
+    if(!txTimeEnabled() || departure <= std::chrono::steady_clock::now()) return sendPacket(sock, destAddr, p);
+
+    struct sockaddr_in dest;
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = toAltOrder<uint32_t>(destAddr);
+    vector<uint8_t> buffer;
+    p.toBuffer(buffer);
+
+    struct iovec iov;
+    iov.iov_base = buffer.data();
+    iov.iov_len = buffer.size();
+    char control[CMSG_SPACE(sizeof(uint64_t))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &dest;
+    msg.msg_namelen = sizeof(dest);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_TXTIME;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+    uint64_t txTime = std::chrono::duration_cast<std::chrono::nanoseconds>(departure.time_since_epoch()).count();
+    memcpy(CMSG_DATA(cm), &txTime, sizeof(txTime));
+
+    ssize_t numBytes = sendmsg(sock, &msg, 0);
+    return numBytes >= 0;
+  #endif
+}
 
 //returns bool representing if there were no errors with actually getting the packet
 // goodPacket is a bool that represents whether or not the packet is a valid tcp/ip packet
-bool recPacket(int sock, IpPacket& packet, IpPacketCode& packetCode){
+// wouldBlock is set when the call failed only because the socket has been drained
+bool recPacket(int sock, IpPacket& packet, IpPacketCode& packetCode, bool& wouldBlock){
 
   ssize_t numRec = recvfrom(sock,ipBuffer,IP_PACKET_MAX_SIZE,0,nullptr, nullptr);
 	
   if(numRec < 0){
+    wouldBlock = (errno == EAGAIN || errno == EWOULDBLOCK);
     return false;
   }   
     
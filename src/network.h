@@ -1,12 +1,18 @@
 #pragma once
 #include "ipPacket.h"
 #include <vector>
+#include <cstddef>
+#include <chrono>
 #define TCP_PROTO 6 
 #define defaultMTU 576
 
 bool bindSocket(char* sourceAddress, int& socket);
 bool sendPacket(int sock, uint32_t destAddr, TcpPacket& p);
-bool recPacket(int sock, IpPacket& packet, IpPacketCode& packetCode);
+bool sendPacket(int sock, uint32_t destAddr, TcpPacket& p, std::chrono::steady_clock::time_point departure);
+void setTxTimeOffload(bool on);
+bool enableTxTime(int sock);
+bool txTimeEnabled();
+bool recPacket(int sock, IpPacket& packet, IpPacketCode& packetCode, bool& wouldBlock);
 uint32_t getMtu(uint32_t destAddr);
 uint32_t getMmsR();
 uint32_t getMmsS();
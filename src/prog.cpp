@@ -20,9 +20,9 @@ int main(int argc, char* argv[]){
         LocalPair lp(0,0);
         RemotePair rp(0, 0);
   
-        App a(0, {}, {});
+        App a(0);
         Tcb b(&a, lp, rp, true, 0);
-        b.setCurrentState(make_unique<EstabS>());
+        b.setCurrentState(EstabS::instance);
         std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     
         TcpPacket p;
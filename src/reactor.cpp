@@ -0,0 +1,125 @@
+#include "reactor.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+
+using namespace std;
+
+Reactor::~Reactor(){
+  shutdown();
+}
+
+void Reactor::shutdown(){
+  if(epollFd >= 0) ::close(epollFd);
+  if(timerFd >= 0) ::close(timerFd);
+  if(wakeFd >= 0) ::close(wakeFd);
+  epollFd = -1;
+  timerFd = -1;
+  wakeFd = -1;
+  sockFd = -1;
+}
+
+//socket is expected to already be non blocking, since it is watched edge triggered and must be drained until EAGAIN
+bool Reactor::init(int socket){
+
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if(epollFd < 0) return false;
+  
+  //steady_clock is CLOCK_MONOTONIC on linux, so deadlines can be handed to the timer as absolute times
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(timerFd < 0){
+    shutdown();
+    return false;
+  }
+  
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(wakeFd < 0){
+    shutdown();
+    return false;
+  }
+  
+  sockFd = socket;
+  
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = sockFd;
+  if(sockFd >= 0 && epoll_ctl(epollFd, EPOLL_CTL_ADD, sockFd, &ev) < 0){
+    shutdown();
+    return false;
+  }
+  
+  ev.events = EPOLLIN;
+  ev.data.fd = timerFd;
+  if(epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev) < 0){
+    shutdown();
+    return false;
+  }
+  
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeFd;
+  if(epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) < 0){
+    shutdown();
+    return false;
+  }
+  
+  return true;
+}
+
+bool Reactor::armTimer(std::chrono::steady_clock::time_point deadline){
+
+  std::chrono::nanoseconds sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+  //an all zero value would disarm the timer instead of firing it right away
+  if(sinceEpoch.count() <= 0) sinceEpoch = std::chrono::nanoseconds{1};
+  
+  struct itimerspec spec{};
+  spec.it_value.tv_sec = sinceEpoch.count() / 1000000000;
+  spec.it_value.tv_nsec = sinceEpoch.count() % 1000000000;
+  return timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0;
+}
+
+bool Reactor::disarmTimer(){
+  struct itimerspec spec{};
+  return timerfd_settime(timerFd, 0, &spec, nullptr) == 0;
+}
+
+//safe to call from any thread
+bool Reactor::wake(){
+  uint64_t one = 1;
+  return ::write(wakeFd, &one, sizeof(one)) == sizeof(one);
+}
+
+/*
+wait-
+blocks until at least one watched fd is ready, or just polls if block is false(ie there is already work queued in the driver).
+returns false only on an unrecoverable epoll error.
+*/
+bool Reactor::wait(bool block, bool& socketReady, bool& timerFired, bool& woken){
+
+  struct epoll_event events[REACTOR_MAX_EVENTS];
+  int numRet = epoll_wait(epollFd, events, REACTOR_MAX_EVENTS, block ? -1 : 0);
+  if(numRet < 0){
+    return errno == EINTR;
+  }
+  
+  for(int i = 0; i < numRet; i++){
+    int fd = events[i].data.fd;
+    uint64_t count = 0;
+    if(fd == sockFd){
+      socketReady = true;
+    }
+    else if(fd == timerFd){
+      //reading resets the expiration count so the level triggered fd does not keep firing
+      ::read(timerFd, &count, sizeof(count));
+      timerFired = true;
+    }
+    else if(fd == wakeFd){
+      ::read(wakeFd, &count, sizeof(count));
+      woken = true;
+    }
+  }
+  
+  return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+const int REACTOR_MAX_EVENTS = 8;
+
+/*
+Reactor-
+epoll based event loop primitive used by the driver.
+Watches the raw socket(edge triggered), a timerfd armed to the earliest pending tcp deadline(rto, sws, time wait, paced departures)
+and an eventfd that other threads can write to in order to wake the driver up.
+*/
+class Reactor{
+  public:
+    Reactor() = default;
+    ~Reactor();
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+    
+    bool init(int socket);
+    void shutdown();
+    bool armTimer(std::chrono::steady_clock::time_point deadline);
+    bool disarmTimer();
+    bool wake();
+    bool wait(bool block, bool& socketReady, bool& timerFired, bool& woken);
+    
+  private:
+    int epollFd = -1;
+    int timerFd = -1;
+    int wakeFd = -1;
+    int sockFd = -1;
+};
@@ -0,0 +1,153 @@
+#include "reassembly.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+using namespace std;
+
+static bool seqLess(uint32_t a, uint32_t b){
+  return static_cast<int32_t>(a - b) < 0;
+}
+
+//appends whatever part of [seq, seq + len) lies past the end of h. seq must not be past the end of h
+void ReassemblyQueue::appendTail(Held& h, uint32_t hSeq, uint32_t seq, const uint8_t* data, size_t len){
+  uint32_t hEnd = hSeq + static_cast<uint32_t>(h.data.size());
+  uint32_t end = seq + static_cast<uint32_t>(len);
+  if(!seqLess(hEnd, end)) return;
+  size_t skip = hEnd - seq;
+  h.data.insert(h.data.end(), data + skip, data + len);
+}
+
+/*
+insert-
+Adds [seq, seq + len). Any held range that overlaps or touches it is folded into a single range, bytes already held win over the new copy.
+*/
+void ReassemblyQueue::insert(uint32_t seq, const uint8_t* data, size_t len, bool push){
+
+  if(len == 0) return;
+  uint32_t end = seq + static_cast<uint32_t>(len);
+  lastInsertSeq = seq;
+
+  //first range that could touch the new one is the last one starting at or before seq(if it reaches seq), otherwise the next one
+  RangeMap::iterator it = ranges.upper_bound(seq);
+  if(it != ranges.begin()){
+    RangeMap::iterator prev = std::prev(it);
+    if(!seqLess(prev->first + static_cast<uint32_t>(prev->second.data.size()), seq)) it = prev;
+  }
+
+  if(it == ranges.end() || seqLess(end, it->first)){
+    Held h;
+    h.data.assign(data, data + len);
+    h.push = push;
+    ranges.emplace_hint(it, seq, move(h));
+    byteCount += len;
+    return;
+  }
+
+  uint32_t mergedSeq = seq;
+  Held merged;
+  if(!seqLess(seq, it->first)){
+    //extend the existing range in place rather than copying it
+    mergedSeq = it->first;
+    merged = move(it->second);
+    byteCount -= merged.data.size();
+    it = ranges.erase(it);
+    appendTail(merged, mergedSeq, seq, data, len);
+  }
+  else{
+    merged.data.assign(data, data + len);
+  }
+  merged.push = merged.push || push;
+
+  while(it != ranges.end() && !seqLess(mergedSeq + static_cast<uint32_t>(merged.data.size()), it->first)){
+    //the new copy may already cover the start of this range, the held bytes go over it
+    vector<uint8_t>& held = it->second.data;
+    size_t offset = it->first - mergedSeq;
+    size_t overlap = min(merged.data.size() - offset, held.size());
+    copy(held.begin(), held.begin() + overlap, merged.data.begin() + offset);
+    appendTail(merged, mergedSeq, it->first, held.data(), held.size());
+    merged.push = merged.push || it->second.push;
+    byteCount -= it->second.data.size();
+    it = ranges.erase(it);
+  }
+
+  byteCount += merged.data.size();
+  ranges.emplace_hint(it, mergedSeq, move(merged));
+}
+
+/*
+popReady-
+Removes and returns the first range if it starts at or before rNxt and still has bytes past it. Ranges that are entirely behind rNxt are
+dropped on the way. Returns false once the next range starts beyond rNxt(a gap is still open) or nothing is held.
+*/
+bool ReassemblyQueue::popReady(uint32_t rNxt, ReassemblyRange& out){
+
+  while(!ranges.empty()){
+    RangeMap::iterator it = ranges.begin();
+    if(seqLess(rNxt, it->first)) return false;
+
+    out.seq = it->first;
+    out.data = move(it->second.data);
+    out.push = it->second.push;
+    byteCount -= out.data.size();
+    ranges.erase(it);
+    if(seqLess(rNxt, out.seq + static_cast<uint32_t>(out.data.size()))) return true;
+  }
+  return false;
+}
+
+/*
+sackBlocks-
+Fills out with up to maxBlocks [left, right) edges of held ranges for a sack option. RFC 2018 4 wants the block holding the most recently
+received segment first, the rest follow in sequence order.
+*/
+void ReassemblyQueue::sackBlocks(vector<pair<uint32_t, uint32_t> >& out, size_t maxBlocks){
+
+  out.clear();
+  if(maxBlocks == 0 || ranges.empty()) return;
+
+  RangeMap::iterator recent = ranges.upper_bound(lastInsertSeq);
+  if(recent != ranges.begin()){
+    recent = std::prev(recent);
+    uint32_t recentEnd = recent->first + static_cast<uint32_t>(recent->second.data.size());
+    if(seqLess(lastInsertSeq, recentEnd)) out.push_back(make_pair(recent->first, recentEnd));
+    else recent = ranges.end();
+  }
+  else recent = ranges.end();
+
+  for(RangeMap::iterator it = ranges.begin(); it != ranges.end() && out.size() < maxBlocks; it++){
+    if(it == recent) continue;
+    out.push_back(make_pair(it->first, it->first + static_cast<uint32_t>(it->second.data.size())));
+  }
+}
+
+void ReassemblyQueue::clear(){
+  ranges.clear();
+  byteCount = 0;
+  finHeld = false;
+}
+
+void ReassemblyQueue::holdFin(uint32_t seq){
+  finHeld = true;
+  finSeq = seq;
+}
+
+bool ReassemblyQueue::finReady(uint32_t rNxt){
+  return finHeld && (finSeq == rNxt);
+}
+
+void ReassemblyQueue::clearFin(){
+  finHeld = false;
+}
+
+bool ReassemblyQueue::empty(){
+  return ranges.empty();
+}
+
+size_t ReassemblyQueue::size(){
+  return byteCount;
+}
+
+size_t ReassemblyQueue::rangeCount(){
+  return ranges.size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <vector>
+#include <utility>
+
+//a run of out of order bytes starting at seq
+struct ReassemblyRange{
+  uint32_t seq = 0;
+  std::vector<uint8_t> data;
+  bool push = false;
+};
+
+/*
+ReassemblyQueue-
+Holds in window data that arrived ahead of rNxt until the gap before it is filled. Ranges are kept in a map ordered by sequence number and never
+overlap or touch, an insert merges with its neighbours so it costs O(log n) plus the bytes it copies. Ordering is modular(RFC 9293 sequence
+comparison), which is valid since everything held is within one receive window of rNxt.
+A fin that arrives out of order is remembered here too, it can only be processed once every byte before it has been received.
+*/
+class ReassemblyQueue{
+  public:
+    void insert(uint32_t seq, const uint8_t* data, size_t len, bool push);
+    bool popReady(uint32_t rNxt, ReassemblyRange& out);
+    void sackBlocks(std::vector<std::pair<uint32_t, uint32_t> >& out, size_t maxBlocks);
+    void clear();
+
+    void holdFin(uint32_t seq);
+    bool finReady(uint32_t rNxt);
+    void clearFin();
+
+    bool empty();
+    size_t size();
+    size_t rangeCount();
+
+  private:
+    struct SeqLess{
+      bool operator()(uint32_t a, uint32_t b) const { return static_cast<int32_t>(a - b) < 0; }
+    };
+    struct Held{
+      std::vector<uint8_t> data;
+      bool push = false;
+    };
+    typedef std::map<uint32_t, Held, SeqLess> RangeMap;
+
+    static void appendTail(Held& h, uint32_t hSeq, uint32_t seq, const uint8_t* data, size_t len);
+
+    RangeMap ranges;
+    size_t byteCount = 0;
+    bool finHeld = false;
+    uint32_t finSeq = 0;
+    uint32_t lastInsertSeq = 0; //start of the most recently received segment, its range is reported first in sack blocks
+};
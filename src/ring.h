@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+const size_t CACHE_LINE_BYTES = 64;
+
+/*
+SpscRing-
+Fixed capacity lock free single producer single consumer ring. Capacity is rounded up to a power of two so a position maps to a slot with a mask.
+head and tail only ever grow, each side keeps a cached copy of the other side's index so it only touches the shared cache line when it looks full/empty.
+*/
+template<typename T>
+class SpscRing{
+  public:
+    explicit SpscRing(size_t minCapacity){
+      size_t cap = 1;
+      while(cap < minCapacity) cap <<= 1;
+      slots.resize(cap);
+      mask = cap - 1;
+    }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    //producer side, returns false if the ring is full
+    bool push(T val){
+      size_t t = tail.load(std::memory_order_relaxed);
+      if(t - cachedHead > mask){
+        cachedHead = head.load(std::memory_order_acquire);
+        if(t - cachedHead > mask) return false;
+      }
+      slots[t & mask] = std::move(val);
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    //consumer side, returns false if the ring is empty
+    bool pop(T& out){
+      size_t h = head.load(std::memory_order_relaxed);
+      if(h == cachedTail){
+        cachedTail = tail.load(std::memory_order_acquire);
+        if(h == cachedTail) return false;
+      }
+      out = std::move(slots[h & mask]);
+      head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    //producer side
+    bool full(){
+      return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) > mask;
+    }
+
+    //safe from either side, may be stale by the time it is used
+    bool empty(){
+      return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity(){ return mask + 1; }
+
+  private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    //consumer owned
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    //producer owned
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+};
+
+/*
+MpscRing-
+Fixed capacity lock free multi producer single consumer ring(Vyukov bounded queue). Every slot carries a sequence number that tells a producer whether the
+slot is free for its position and tells the consumer whether the slot has been published yet.
+*/
+template<typename T>
+class MpscRing{
+  public:
+    explicit MpscRing(size_t minCapacity){
+      size_t cap = 1;
+      while(cap < minCapacity) cap <<= 1;
+      slots.reset(new Slot[cap]);
+      for(size_t i = 0; i < cap; i++){
+        slots[i].seq.store(i, std::memory_order_relaxed);
+      }
+      mask = cap - 1;
+    }
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    //any thread, returns false if the ring is full
+    bool push(T val){
+      size_t pos = tail.load(std::memory_order_relaxed);
+      Slot* s = nullptr;
+      while(true){
+        s = &slots[pos & mask];
+        size_t seq = s->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0){
+          if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if(diff < 0){
+          return false;
+        }
+        else{
+          pos = tail.load(std::memory_order_relaxed);
+        }
+      }
+      s->val = std::move(val);
+      s->seq.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    //consumer only, returns false if nothing has been published
+    bool pop(T& out){
+      Slot& s = slots[head & mask];
+      if(s.seq.load(std::memory_order_acquire) != head + 1) return false;
+      out = std::move(s.val);
+      s.seq.store(head + mask + 1, std::memory_order_release);
+      head++;
+      return true;
+    }
+
+    size_t capacity(){ return mask + 1; }
+
+  private:
+    struct Slot{
+      std::atomic<size_t> seq;
+      T val;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> tail{0};
+    alignas(CACHE_LINE_BYTES) size_t head = 0;
+};
@@ -0,0 +1,232 @@
+#include "seqRing.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdlib>
+#include <utility>
+
+using namespace std;
+
+SeqRing::~SeqRing(){
+  free();
+}
+
+SeqRing::SeqRing(SeqRing&& other){
+  *this = move(other);
+}
+
+SeqRing& SeqRing::operator=(SeqRing&& other){
+  if(this != &other){
+    free();
+    base = other.base;
+    capacity = other.capacity;
+    mask = other.mask;
+    doubleMapped = other.doubleMapped;
+    headOffset = other.headOffset;
+    used = other.used;
+    headSeq = other.headSeq;
+    external = move(other.external);
+    externalBytes = other.externalBytes;
+    other.base = nullptr;
+    other.capacity = 0;
+    other.mask = 0;
+    other.doubleMapped = false;
+    other.headOffset = 0;
+    other.used = 0;
+    other.external.clear();
+    other.externalBytes = 0;
+  }
+  return *this;
+}
+
+void SeqRing::free(){
+  if(base == nullptr) return;
+  if(doubleMapped){
+    munmap(base, 2 * capacity);
+  }
+  else{
+    std::free(base);
+  }
+  base = nullptr;
+  capacity = 0;
+  mask = 0;
+  doubleMapped = false;
+}
+
+//maps the same memfd pages at base and base + cap, so reads that run off the end of the ring continue at its start
+bool SeqRing::mapDouble(size_t cap){
+
+  int fd = memfd_create("tcpSendBuffer", MFD_CLOEXEC);
+  if(fd < 0) return false;
+  if(ftruncate(fd, cap) < 0){
+    ::close(fd);
+    return false;
+  }
+  //reserve the whole range first so nothing else can land between the two halves
+  void* region = mmap(nullptr, 2 * cap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(region == MAP_FAILED){
+    ::close(fd);
+    return false;
+  }
+  uint8_t* r = static_cast<uint8_t*>(region);
+  bool mapped = (mmap(r, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED)
+    && (mmap(r + cap, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED);
+  //the mappings keep the memfd alive
+  ::close(fd);
+  if(!mapped){
+    munmap(region, 2 * cap);
+    return false;
+  }
+  base = r;
+  return true;
+}
+
+//moves the held bytes into a ring of at least minCapacity, starting at offset 0
+bool SeqRing::grow(size_t minCapacity){
+
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t cap = 1;
+  while(cap < minCapacity || cap < SEQ_RING_MIN_BYTES || cap < page) cap <<= 1;
+
+  SeqRing fresh;
+  fresh.capacity = cap;
+  fresh.mask = cap - 1;
+  fresh.doubleMapped = fresh.mapDouble(cap);
+  if(!fresh.doubleMapped){
+    fresh.base = static_cast<uint8_t*>(malloc(cap));
+    if(fresh.base == nullptr) return false;
+  }
+  if(used > 0) copyRing(0, used, fresh.base);
+  fresh.used = used;
+  fresh.headSeq = headSeq;
+  fresh.external = move(external);
+  fresh.externalBytes = externalBytes;
+  *this = move(fresh);
+  return true;
+}
+
+size_t SeqRing::offsetOf(uint32_t seq){
+  return (headOffset + (seq - headSeq)) & mask;
+}
+
+//copies len ring bytes starting index bytes past the head
+void SeqRing::copyRing(size_t index, size_t len, uint8_t* dst){
+  size_t off = (headOffset + index) & mask;
+  size_t first = doubleMapped ? len : min(len, capacity - off);
+  memcpy(dst, base + off, first);
+  if(first < len) memcpy(dst + first, base, len - first);
+}
+
+//relabels the held bytes so the first one is seq. Used once the initial send sequence number is known
+void SeqRing::anchor(uint32_t seq){
+  for(ExternalSpan& s : external) s.seq += seq - headSeq;
+  headSeq = seq;
+}
+
+bool SeqRing::append(const uint8_t* data, size_t len){
+
+  if(len == 0) return true;
+  if(used + len > capacity && !grow(used + len)) return false;
+  size_t off = (headOffset + used) & mask;
+  size_t first = doubleMapped ? len : min(len, capacity - off);
+  memcpy(base + off, data, first);
+  if(first < len) memcpy(base, data + first, len - first);
+  used += len;
+  return true;
+}
+
+bool SeqRing::append(const std::deque<uint8_t>& data){
+
+  size_t len = data.size();
+  if(len == 0) return true;
+  if(used + len > capacity && !grow(used + len)) return false;
+  size_t off = (headOffset + used) & mask;
+  for(auto iter = data.begin(); iter != data.end(); iter++){
+    base[off] = *iter;
+    off = (off + 1) & mask;
+  }
+  used += len;
+  return true;
+}
+
+//the bytes are the app's until they are acked, it must not touch them before then
+void SeqRing::appendExternal(const uint8_t* data, size_t len){
+  if(len == 0) return;
+  external.push_back(ExternalSpan{getTailSeq(), len, data});
+  externalBytes += len;
+}
+
+//assumes [seq, seq + len) is held
+void SeqRing::copyOut(uint32_t seq, size_t len, uint8_t* dst){
+
+  if(len == 0) return;
+  if(external.empty()){
+    copyRing(seq - headSeq, len, dst);
+    return;
+  }
+
+  //walk the spans, ring bytes sit at their sequence offset less the external bytes before them
+  size_t skipped = 0;
+  auto span = external.begin();
+  while(span != external.end() && static_cast<int32_t>(span->seq + span->len - seq) <= 0){
+    skipped += span->len;
+    span++;
+  }
+  while(len > 0){
+    size_t take;
+    if(span != external.end() && static_cast<int32_t>(seq - span->seq) >= 0){
+      size_t into = seq - span->seq;
+      take = min(len, span->len - into);
+      memcpy(dst, span->data + into, take);
+      skipped += span->len;
+      span++;
+    }
+    else{
+      take = (span != external.end()) ? min(len, static_cast<size_t>(span->seq - seq)) : len;
+      copyRing(seq - headSeq - skipped, take, dst);
+    }
+    seq += take;
+    dst += take;
+    len -= take;
+  }
+}
+
+//only meaningful when double mapped and no zero copy bytes are held, the returned pointer can be read for up to the capacity in bytes
+const uint8_t* SeqRing::linear(uint32_t seq){
+  if(!doubleMapped || !external.empty()) return nullptr;
+  return base + offsetOf(seq);
+}
+
+//drops every byte before seq. Sequence numbers past the held bytes(ex: a fin) just empty the buffer
+void SeqRing::release(uint32_t seq){
+
+  int32_t diff = seq - headSeq;
+  if(diff <= 0) return;
+  size_t advance = diff;
+  if(advance > size()) advance = size();
+  while(advance > 0){
+    size_t step;
+    if(!external.empty() && external.front().seq == headSeq){
+      ExternalSpan& s = external.front();
+      step = min(advance, s.len);
+      s.seq += step;
+      s.data += step;
+      s.len -= step;
+      externalBytes -= step;
+      if(s.len == 0) external.pop_front();
+    }
+    else{
+      step = external.empty() ? advance : min(advance, static_cast<size_t>(external.front().seq - headSeq));
+      headOffset = (headOffset + step) & mask;
+      used -= step;
+    }
+    headSeq += step;
+    advance -= step;
+  }
+}
+
+uint32_t SeqRing::getHeadSeq(){ return headSeq; }
+uint32_t SeqRing::getTailSeq(){ return headSeq + size(); }
+size_t SeqRing::size(){ return used + externalBytes; }
+size_t SeqRing::getCapacity(){ return capacity; }
+bool SeqRing::isDoubleMapped(){ return doubleMapped; }
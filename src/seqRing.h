@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+
+const size_t SEQ_RING_MIN_BYTES = 4096; //rounded up to the page size and a power of two
+
+/*
+SeqRing-
+Ring of bytes addressed by tcp sequence number, one per direction of a connection. The send side keeps its queued and unacknowledged bytes in one,
+the receive side the in order bytes the app has not read yet.
+Capacity is a power of two(and a whole number of pages) so a sequence number maps to an offset with a mask. When possible the ring is backed by a memfd
+that is mapped twice back to back, so any run of bytes up to the capacity can be read linearly even when it wraps. If that mapping fails a plain heap
+buffer is used and wrapping copies are split in two.
+Storage is allocated on the first append so listeners and idle connections dont pay for it.
+Zero copy sends are not copied in at all. Their bytes stay in the app's memory as external spans that take up sequence numbers but no ring space,
+the ring holds the rest in sequence order.
+*/
+class SeqRing{
+  public:
+    SeqRing() = default;
+    ~SeqRing();
+    SeqRing(const SeqRing&) = delete;
+    SeqRing& operator=(const SeqRing&) = delete;
+    SeqRing(SeqRing&& other);
+    SeqRing& operator=(SeqRing&& other);
+
+    void anchor(uint32_t seq);
+    bool append(const uint8_t* data, size_t len);
+    bool append(const std::deque<uint8_t>& data);
+    void appendExternal(const uint8_t* data, size_t len);
+    void copyOut(uint32_t seq, size_t len, uint8_t* dst);
+    const uint8_t* linear(uint32_t seq);
+    void release(uint32_t seq);
+
+    uint32_t getHeadSeq();
+    uint32_t getTailSeq();
+    size_t size();
+    size_t getCapacity();
+    bool isDoubleMapped();
+
+  private:
+    bool grow(size_t minCapacity);
+    bool mapDouble(size_t cap);
+    void free();
+    size_t offsetOf(uint32_t seq);
+    void copyRing(size_t index, size_t len, uint8_t* dst);
+
+    struct ExternalSpan{
+      uint32_t seq;
+      size_t len;
+      const uint8_t* data;
+    };
+
+    uint8_t* base = nullptr;
+    size_t capacity = 0;
+    size_t mask = 0;
+    bool doubleMapped = false;
+
+    size_t headOffset = 0; //ring offset of headSeq
+    size_t used = 0;
+    uint32_t headSeq = 0; //first sequence number still held(not yet released)
+    std::deque<ExternalSpan> external; //in sequence order
+    size_t externalBytes = 0;
+};
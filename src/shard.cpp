@@ -0,0 +1,547 @@
+#include "shard.h"
+#include "driver.h"
+#include "state.h"
+#include "network.h"
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <unistd.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+const uint8_t SYMMETRIC_RSS_KEY[RSS_KEY_LEN] = {
+  0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+  0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+  0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+  0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a
+};
+
+thread_local int shardIndex = 0;
+int shardCount = 1;
+
+//a shard owns its own raw socket, reactor, and(through the thread local driver globals) its own connection table and timers
+class Shard{
+  public:
+    int socket = -1;
+    Reactor reactor;
+    ShardMailbox mailbox;
+    std::thread worker;
+    LocalCode result = LocalCode::SUCCESS;
+};
+
+std::vector<std::unique_ptr<Shard> > shards;
+std::atomic<bool> shardsRunning{false};
+//used to spread opens that dont have a full 4 tuple yet, the shard that takes it picks a local port that steers back to itself
+std::atomic<uint32_t> nextUnpinnedShard{0};
+
+//apps whose rings the drivers drain. Only attach/detach and a driver picking up a changed list take this lock, submitting and reaping never do
+std::mutex attachedLock;
+std::vector<App*> attachedApps;
+//bumped on every attach/detach. Each driver keeps its own copy of the list and only retakes the lock when this moves
+std::atomic<uint64_t> attachedGeneration{0};
+thread_local std::vector<App*> shardApps;
+thread_local uint64_t shardAppsGeneration = 0;
+//what each driver last copied, and whether it is inside runDriverLoop. detachApp waits on these instead of holding drivers off with the lock
+std::atomic<uint64_t> shardSeenGeneration[MAX_SHARDS];
+std::atomic<bool> shardLooping[MAX_SHARDS];
+//set by a driver right before it blocks, submitters only pay for a wakeup when the driver is actually asleep
+std::atomic<bool> driverIdle[MAX_SHARDS];
+
+/*
+toeplitzHash-
+standard rss toeplitz hash. For every set bit of the input the current 32 bit window of the key is xored in, and the window slides one bit per input bit.
+assumes key is at least len + 4 bytes.
+*/
+uint32_t toeplitzHash(const uint8_t* input, size_t len, const uint8_t* key){
+
+  uint32_t result = 0;
+  uint32_t window = (key[0] << 24) | (key[1] << 16) | (key[2] << 8) | key[3];
+  for(size_t i = 0; i < len; i++){
+    for(int bit = 7; bit >= 0; bit--){
+      if(input[i] & (1 << bit)){
+        result ^= window;
+      }
+      uint8_t nextKeyByte = key[i + 4];
+      window = (window << 1) | ((nextKeyByte >> bit) & 0x1);
+    }
+  }
+  return result;
+}
+
+//hashes the 4 tuple in network order with the same layout as rss(addresses then ports)
+uint32_t flowHash(ConnPair p){
+
+  uint8_t input[12];
+  uint32_t locAddr = p.first.first;
+  uint32_t remAddr = p.second.first;
+  for(int i = 0; i < 4; i++){
+    input[i] = (locAddr >> (24 - (8 * i))) & 0xff;
+    input[4 + i] = (remAddr >> (24 - (8 * i))) & 0xff;
+  }
+  input[8] = (p.first.second >> 8) & 0xff;
+  input[9] = p.first.second & 0xff;
+  input[10] = (p.second.second >> 8) & 0xff;
+  input[11] = p.second.second & 0xff;
+  return toeplitzHash(input, sizeof(input), SYMMETRIC_RSS_KEY);
+}
+
+int shardForFlow(ConnPair p, int numShards){
+  if(numShards <= 1) return 0;
+  return flowHash(p) % numShards;
+}
+
+bool ownsFlow(ConnPair p){
+  return shardForFlow(p, shardCount) == shardIndex;
+}
+
+/*
+buildSteeringFilter-
+classic bpf program that accepts a packet only if shardForFlow puts it on shard index, so the kernel does the steering and a shard's socket never
+queues another shard's packets. The program sees the packet from the ip header on. It hashes the same input as flowHash for an incoming segment
+(local is the destination): dst address, src address, dst port, src port. The toeplitz windows only depend on the key, so they are worked out here
+and every input bit becomes a test and an xor of a constant.
+*/
+std::vector<sock_filter> buildSteeringFilter(int index, int numShards){
+
+  //scratch slots: running hash, tcp src port, tcp dst port
+  const uint32_t hashSlot = 0;
+  const uint32_t srcPortSlot = 1;
+  const uint32_t dstPortSlot = 2;
+  
+  std::vector<sock_filter> prog;
+  //x = ip header length, then stash both ports so x is free for the hash loop
+  prog.push_back(BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0));
+  prog.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_IND, 0));
+  prog.push_back(BPF_STMT(BPF_ST, srcPortSlot));
+  prog.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2));
+  prog.push_back(BPF_STMT(BPF_ST, dstPortSlot));
+  prog.push_back(BPF_STMT(BPF_LD | BPF_IMM, 0));
+  prog.push_back(BPF_STMT(BPF_ST, hashSlot));
+  
+  //each field is loaded into a, every set bit swaps it out to x while the window is xored into the hash
+  struct Field{ sock_filter load; int bits; };
+  const Field fields[4] = {
+    {BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 16), 32},
+    {BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 12), 32},
+    {BPF_STMT(BPF_LD | BPF_MEM, dstPortSlot), 16},
+    {BPF_STMT(BPF_LD | BPF_MEM, srcPortSlot), 16}
+  };
+  const uint8_t* key = SYMMETRIC_RSS_KEY;
+  uint32_t window = (key[0] << 24) | (key[1] << 16) | (key[2] << 8) | key[3];
+  int inputBit = 0;
+  for(int f = 0; f < 4; f++){
+    prog.push_back(fields[f].load);
+    for(int bit = fields[f].bits - 1; bit >= 0; bit--){
+      prog.push_back(BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 1u << bit, 0, 5));
+      prog.push_back(BPF_STMT(BPF_MISC | BPF_TAX, 0));
+      prog.push_back(BPF_STMT(BPF_LD | BPF_MEM, hashSlot));
+      prog.push_back(BPF_STMT(BPF_ALU | BPF_XOR | BPF_K, window));
+      prog.push_back(BPF_STMT(BPF_ST, hashSlot));
+      prog.push_back(BPF_STMT(BPF_MISC | BPF_TXA, 0));
+      uint8_t nextKeyByte = key[(inputBit / 8) + 4];
+      window = (window << 1) | ((nextKeyByte >> (7 - (inputBit % 8))) & 0x1);
+      inputBit++;
+    }
+  }
+  
+  prog.push_back(BPF_STMT(BPF_LD | BPF_MEM, hashSlot));
+  prog.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)numShards));
+  prog.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)index, 0, 1));
+  prog.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+  prog.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+  return prog;
+}
+
+/*
+attachSteeringFilter-
+puts the steering program on a shard's raw socket. Whatever was queued before the filter went on is thrown away, those segments may belong to
+another shard and the peer retransmits anything that mattered.
+*/
+bool attachSteeringFilter(int sock, int index, int numShards){
+
+  std::vector<sock_filter> prog = buildSteeringFilter(index, numShards);
+  struct sock_fprog fprog;
+  fprog.len = prog.size();
+  fprog.filter = prog.data();
+  if(setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0){
+    return false;
+  }
+  uint8_t discard[64];
+  while(recv(sock, discard, sizeof(discard), MSG_DONTWAIT) >= 0){}
+  return true;
+}
+
+void runShard(Shard* s, int index){
+  shardIndex = index;
+  s->result = runDriverLoop(s->socket, s->reactor, &s->mailbox, &shardsRunning);
+}
+
+void releaseShards(){
+  for(auto iter = shards.begin(); iter != shards.end(); iter++){
+    Shard& s = **iter;
+    if(s.socket >= 0) ::close(s.socket);
+  }
+  shards.clear();
+  shardCount = 1;
+}
+
+/*
+startShards-
+sharded equivalent of entryTcp. Starts numShards worker threads, each with its own raw socket and connection table.
+Each socket carries a steering filter, so the kernel only queues a packet on the socket of the shard the symmetric hash assigns its flow to.
+*/
+bool startShards(char* sourceAddr, int numShards){
+
+  if(numShards < 1 || numShards > MAX_SHARDS || !shards.empty()) return false;
+  
+  for(int i = 0; i < numShards; i++){
+    unique_ptr<Shard> s = make_unique<Shard>();
+    bool bound = bindSocket(sourceAddr, s->socket);
+    bool steered = bound && (numShards == 1 || attachSteeringFilter(s->socket, i, numShards));
+    if(!steered || !s->reactor.init(s->socket)){
+      shards.push_back(move(s));
+      releaseShards();
+      return false;
+    }
+    shards.push_back(move(s));
+  }
+  
+  shardCount = numShards;
+  shardsRunning.store(true, std::memory_order_release);
+  for(int i = 0; i < numShards; i++){
+    shards[i]->worker = std::thread(runShard, shards[i].get(), i);
+  }
+  return true;
+}
+
+void stopShards(){
+
+  shardsRunning.store(false, std::memory_order_release);
+  for(auto iter = shards.begin(); iter != shards.end(); iter++){
+    Shard& s = **iter;
+    s.reactor.wake();
+  }
+  for(auto iter = shards.begin(); iter != shards.end(); iter++){
+    Shard& s = **iter;
+    if(s.worker.joinable()) s.worker.join();
+  }
+  releaseShards();
+}
+
+void postToShard(int index, ShardCommand cmd){
+  Shard& s = *shards[index];
+  s.mailbox.push(move(cmd));
+  s.reactor.wake();
+}
+
+bool fullySpecified(LocalPair lP, RemotePair rP){
+  return lP.first != UNSPECIFIED && lP.second != UNSPECIFIED && rP.first != UNSPECIFIED && rP.second != UNSPECIFIED;
+}
+
+//commands for a known 4 tuple go to the shard that owns the flow. Commands for a listener(unspecified remote) go to every shard, since each shard keeps its own copy of the listener
+void routeCommand(ShardCommand cmd, bool broadcastUnspec){
+
+  ConnPair p(cmd.lP, cmd.rP);
+  if(fullySpecified(cmd.lP, cmd.rP) || !broadcastUnspec){
+    postToShard(shardForFlow(p, shardCount), move(cmd));
+    return;
+  }
+  for(int i = 0; i < shardCount; i++){
+    postToShard(i, cmd);
+  }
+}
+
+bool postOpen(App* app, bool passive, LocalPair lP, RemotePair rP){
+
+  if(shards.empty()) return false;
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::OPEN;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.passive = passive;
+  
+  if(!passive && !fullySpecified(lP, rP)){
+    postToShard(nextUnpinnedShard.fetch_add(1, std::memory_order_relaxed) % shardCount, move(cmd));
+    return true;
+  }
+  routeCommand(move(cmd), passive);
+  return true;
+}
+
+bool postSend(App* app, bool urgent, bool push, std::deque<uint8_t> data, LocalPair lP, RemotePair rP){
+
+  if(shards.empty()) return false;
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::SEND;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.urgent = urgent;
+  cmd.push = push;
+  cmd.data = move(data);
+  routeCommand(move(cmd), false);
+  return true;
+}
+
+bool postReceive(App* app, uint32_t amount, LocalPair lP, RemotePair rP){
+
+  if(shards.empty()) return false;
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::RECEIVE;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.amount = amount;
+  routeCommand(move(cmd), false);
+  return true;
+}
+
+bool postClose(App* app, LocalPair lP, RemotePair rP){
+
+  if(shards.empty()) return false;
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::CLOSE;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  routeCommand(move(cmd), true);
+  return true;
+}
+
+bool postAbort(App* app, LocalPair lP, RemotePair rP){
+
+  if(shards.empty()) return false;
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::ABORT;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  routeCommand(move(cmd), true);
+  return true;
+}
+
+void wakeShard(int index){
+  if(shards.empty()){
+    wakeTcp();
+    return;
+  }
+  shards[index]->reactor.wake();
+}
+
+/*
+attachApp-
+gives the app one ring pair per shard and starts having the drivers drain them. Must be called after startShards(if sharding) and before any submit.
+*/
+bool attachApp(App* app){
+
+  if(app->getQueues() != nullptr) return false;
+  unique_ptr<AppQueues> q = make_unique<AppQueues>();
+  for(int i = 0; i < shardCount; i++){
+    q->perShard.push_back(make_unique<AppRingPair>());
+  }
+  app->setQueues(move(q));
+  std::lock_guard<std::mutex> guard(attachedLock);
+  attachedApps.push_back(app);
+  attachedGeneration.fetch_add(1, std::memory_order_seq_cst);
+  return true;
+}
+
+/*
+detachApp-
+once this returns no driver touches the app's rings again, so it is safe to destroy the app. Drivers work off their own copy of the attached list,
+so after removing the app this waits(rcu style) until every driver inside its loop has copied the list again. Not to be called from a driver thread.
+*/
+void detachApp(App* app){
+  uint64_t gen = 0;
+  {
+    std::lock_guard<std::mutex> guard(attachedLock);
+    attachedApps.erase(std::remove(attachedApps.begin(), attachedApps.end(), app), attachedApps.end());
+    gen = attachedGeneration.fetch_add(1, std::memory_order_seq_cst) + 1;
+  }
+  for(int i = 0; i < MAX_SHARDS; i++){
+    while(shardLooping[i].load(std::memory_order_seq_cst) && shardSeenGeneration[i].load(std::memory_order_acquire) < gen){
+      wakeShard(i);
+      std::this_thread::yield();
+    }
+  }
+}
+
+//brings this driver's copy of the attached list up to date. Only takes the lock when an attach or detach happened since the last copy
+void refreshShardApps(){
+  if(attachedGeneration.load(std::memory_order_seq_cst) == shardAppsGeneration) return;
+  std::lock_guard<std::mutex> guard(attachedLock);
+  shardApps = attachedApps;
+  shardAppsGeneration = attachedGeneration.load(std::memory_order_relaxed);
+  shardSeenGeneration[shardIndex].store(shardAppsGeneration, std::memory_order_release);
+}
+
+DriverLoopScope::DriverLoopScope(){
+  shardLooping[shardIndex].store(true, std::memory_order_seq_cst);
+}
+
+DriverLoopScope::~DriverLoopScope(){
+  shardLooping[shardIndex].store(false, std::memory_order_seq_cst);
+}
+
+bool submitToShard(App* app, int index, ShardCommand cmd){
+
+  AppRingPair& rings = *app->getQueues()->perShard[index];
+  if(!rings.submissions.push(move(cmd))) return false;
+  //pairs with the fence in setDriverIdle, either the driver sees this submission on its last check or we see it is idle
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(driverIdle[index].load(std::memory_order_relaxed)){
+    wakeShard(index);
+  }
+  return true;
+}
+
+//same routing as the mailboxes, a command without a full 4 tuple(a listener) is handed to every shard and completes once per shard
+bool submitCommand(App* app, ShardCommand cmd, bool broadcastUnspec){
+
+  AppQueues* q = app->getQueues();
+  if(q == nullptr) return false;
+  int numRings = q->perShard.size();
+  if(fullySpecified(cmd.lP, cmd.rP) || !broadcastUnspec){
+    return submitToShard(app, shardForFlow(ConnPair(cmd.lP, cmd.rP), numRings), move(cmd));
+  }
+  for(int i = 0; i < numRings; i++){
+    if(q->perShard[i]->submissions.full()) return false;
+  }
+  for(int i = 0; i < numRings; i++){
+    submitToShard(app, i, cmd);
+  }
+  return true;
+}
+
+bool submitSend(App* app, uint64_t userData, bool urgent, bool push, std::deque<uint8_t> data, LocalPair lP, RemotePair rP){
+
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::SEND;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.urgent = urgent;
+  cmd.push = push;
+  cmd.data = move(data);
+  cmd.userData = userData;
+  return submitCommand(app, move(cmd), false);
+}
+
+//data must stay untouched until the connection reports ZEROCOPYDONE for it
+bool submitSendZeroCopy(App* app, uint64_t userData, bool urgent, bool push, const uint8_t* data, uint32_t len, LocalPair lP, RemotePair rP){
+
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::SEND;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.urgent = urgent;
+  cmd.push = push;
+  cmd.sendBuffer = data;
+  cmd.amount = len;
+  cmd.userData = userData;
+  return submitCommand(app, move(cmd), false);
+}
+
+bool submitReceive(App* app, uint64_t userData, uint32_t amount, LocalPair lP, RemotePair rP){
+
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::RECEIVE;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.amount = amount;
+  cmd.userData = userData;
+  return submitCommand(app, move(cmd), false);
+}
+
+//dest must stay valid for capacity bytes until a notification carrying userData reports the read done(RECEIVEDONE) or failed
+bool submitReceive(App* app, uint64_t userData, uint8_t* dest, uint32_t capacity, uint32_t lowWater, LocalPair lP, RemotePair rP){
+
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::RECEIVE;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.amount = capacity;
+  cmd.recBuffer = dest;
+  cmd.lowWater = lowWater;
+  cmd.userData = userData;
+  return submitCommand(app, move(cmd), false);
+}
+
+bool submitClose(App* app, uint64_t userData, LocalPair lP, RemotePair rP){
+
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::CLOSE;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.userData = userData;
+  return submitCommand(app, move(cmd), true);
+}
+
+bool submitAbort(App* app, uint64_t userData, LocalPair lP, RemotePair rP){
+
+  ShardCommand cmd;
+  cmd.type = ShardCommandType::ABORT;
+  cmd.app = app;
+  cmd.lP = lP;
+  cmd.rP = rP;
+  cmd.userData = userData;
+  return submitCommand(app, move(cmd), true);
+}
+
+bool reapCompletion(App* app, AppCompletion& out){
+
+  AppQueues* q = app->getQueues();
+  if(q == nullptr) return false;
+  for(auto iter = q->perShard.begin(); iter != q->perShard.end(); iter++){
+    if((*iter)->completions.pop(out)) return true;
+  }
+  return false;
+}
+
+/*
+drainAppRings-
+takes up to APP_RING_BATCH_MAX submissions from every attached app's ring for this shard and posts a completion for each.
+An app whose completion ring is full is skipped until it reaps, so completions are never dropped.
+*/
+LocalCode drainAppRings(int socket){
+
+  refreshShardApps();
+  for(auto iter = shardApps.begin(); iter != shardApps.end(); iter++){
+    AppQueues* q = (*iter)->getQueues();
+    if(shardIndex >= (int)q->perShard.size()) continue;
+    AppRingPair& rings = *q->perShard[shardIndex];
+    ShardCommand cmd;
+    for(int i = 0; i < APP_RING_BATCH_MAX && !rings.completions.full() && rings.submissions.pop(cmd); i++){
+      AppCompletion comp;
+      comp.userData = cmd.userData;
+      comp.type = cmd.type;
+      comp.code = runShardCommand(socket, cmd);
+      rings.completions.push(move(comp));
+    }
+  }
+  return LocalCode::SUCCESS;
+}
+
+//true if any attached app has submissions waiting for this shard
+bool appRingsPending(){
+
+  refreshShardApps();
+  for(auto iter = shardApps.begin(); iter != shardApps.end(); iter++){
+    AppQueues* q = (*iter)->getQueues();
+    if(shardIndex < (int)q->perShard.size() && !q->perShard[shardIndex]->submissions.empty()) return true;
+  }
+  return false;
+}
+
+void setDriverIdle(bool idle){
+  driverIdle[shardIndex].store(idle, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <linux/filter.h>
+#include "reactor.h"
+#include "ring.h"
+
+class App;
+enum class LocalCode;
+typedef std::pair<uint32_t, uint16_t> LocalPair;
+typedef std::pair<uint32_t, uint16_t> RemotePair;
+typedef std::pair<LocalPair, RemotePair> ConnPair;
+
+const int RSS_KEY_LEN = 40;
+const int MAX_SHARDS = 64;
+
+//0x6d5a repeated makes the toeplitz hash symmetric, so both directions of a flow land on the same shard
+extern const uint8_t SYMMETRIC_RSS_KEY[RSS_KEY_LEN];
+
+//which shard the current thread is running as. Everything outside of a shard worker(including the single threaded entryTcp) is shard 0
+extern thread_local int shardIndex;
+extern int shardCount;
+
+uint32_t toeplitzHash(const uint8_t* input, size_t len, const uint8_t* key);
+uint32_t flowHash(ConnPair p);
+int shardForFlow(ConnPair p, int numShards);
+bool ownsFlow(ConnPair p);
+std::vector<sock_filter> buildSteeringFilter(int index, int numShards);
+bool attachSteeringFilter(int sock, int index, int numShards);
+
+/*
+MpscMailbox-
+Unbounded lock free multi producer single consumer queue(Vyukov style linked list).
+Any thread can push, only the owning shard pops.
+*/
+template<typename T>
+class MpscMailbox{
+  public:
+    MpscMailbox(){
+      Node* stub = new Node();
+      head.store(stub, std::memory_order_relaxed);
+      tail = stub;
+    }
+    ~MpscMailbox(){
+      T discard;
+      while(pop(discard)){}
+      delete tail;
+    }
+    MpscMailbox(const MpscMailbox&) = delete;
+    MpscMailbox& operator=(const MpscMailbox&) = delete;
+    
+    void push(T val){
+      Node* n = new Node();
+      n->val = std::move(val);
+      //producers only contend on this exchange, the link from the previous node is published afterwards
+      Node* prev = head.exchange(n, std::memory_order_acq_rel);
+      prev->next.store(n, std::memory_order_release);
+    }
+    
+    //returns false if nothing is available. A push that is midway through linking its node is treated as not available yet
+    bool pop(T& out){
+      Node* next = tail->next.load(std::memory_order_acquire);
+      if(next == nullptr) return false;
+      out = std::move(next->val);
+      delete tail;
+      tail = next;
+      return true;
+    }
+    
+    bool empty(){
+      return tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+    
+  private:
+    struct Node{
+      std::atomic<Node*> next{nullptr};
+      T val;
+    };
+    std::atomic<Node*> head;
+    Node* tail;
+};
+
+enum class ShardCommandType{
+  OPEN = 0,
+  SEND = 1,
+  RECEIVE = 2,
+  CLOSE = 3,
+  ABORT = 4
+};
+
+//app request handed to the shard that owns the connection
+struct ShardCommand{
+  ShardCommandType type = ShardCommandType::OPEN;
+  App* app = nullptr;
+  LocalPair lP;
+  RemotePair rP;
+  bool passive = false;
+  bool urgent = false;
+  bool push = false;
+  uint32_t amount = 0;
+  std::deque<uint8_t> data;
+  uint64_t userData = 0; //opaque to the stack, handed back in the completion of an app ring submission
+  const uint8_t* sendBuffer = nullptr; //app memory a zero copy send goes out from, amount is its length
+  uint8_t* recBuffer = nullptr; //app registered memory a receive copies into, amount is its capacity
+  uint32_t lowWater = 0;
+};
+
+typedef MpscMailbox<ShardCommand> ShardMailbox;
+
+const size_t APP_RING_ENTRIES = 256;
+const int APP_RING_BATCH_MAX = 32; //max submissions taken from one app per driver loop iteration
+
+struct AppCompletion{
+  uint64_t userData = 0;
+  ShardCommandType type = ShardCommandType::SEND;
+  LocalCode code;
+};
+
+//submission and completion rings between one app thread and one shard. The app produces submissions and consumes completions, the shard does the opposite
+struct AppRingPair{
+  SpscRing<ShardCommand> submissions{APP_RING_ENTRIES};
+  SpscRing<AppCompletion> completions{APP_RING_ENTRIES};
+};
+
+struct AppQueues{
+  std::vector<std::unique_ptr<AppRingPair> > perShard;
+};
+
+bool startShards(char* sourceAddr, int numShards);
+void stopShards();
+
+bool postOpen(App* app, bool passive, LocalPair lP, RemotePair rP);
+bool postSend(App* app, bool urgent, bool push, std::deque<uint8_t> data, LocalPair lP, RemotePair rP);
+bool postReceive(App* app, uint32_t amount, LocalPair lP, RemotePair rP);
+bool postClose(App* app, LocalPair lP, RemotePair rP);
+bool postAbort(App* app, LocalPair lP, RemotePair rP);
+
+//app side of the rings. Each app thread is the only producer of its submissions and the only consumer of its completions, none of these lock
+bool attachApp(App* app);
+void detachApp(App* app);
+bool submitSend(App* app, uint64_t userData, bool urgent, bool push, std::deque<uint8_t> data, LocalPair lP, RemotePair rP);
+bool submitSendZeroCopy(App* app, uint64_t userData, bool urgent, bool push, const uint8_t* data, uint32_t len, LocalPair lP, RemotePair rP);
+bool submitReceive(App* app, uint64_t userData, uint32_t amount, LocalPair lP, RemotePair rP);
+bool submitReceive(App* app, uint64_t userData, uint8_t* dest, uint32_t capacity, uint32_t lowWater, LocalPair lP, RemotePair rP);
+bool submitClose(App* app, uint64_t userData, LocalPair lP, RemotePair rP);
+bool submitAbort(App* app, uint64_t userData, LocalPair lP, RemotePair rP);
+bool reapCompletion(App* app, AppCompletion& out);
+
+//driver side of the rings
+LocalCode drainAppRings(int socket);
+bool appRingsPending();
+void setDriverIdle(bool idle);
+
+//lives for as long as the calling thread is in runDriverLoop, detachApp only waits for drivers that are
+struct DriverLoopScope{
+  DriverLoopScope();
+  ~DriverLoopScope();
+};
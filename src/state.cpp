@@ -19,17 +19,103 @@
 #include <climits>
 #include <functional>
 #include <algorithm>
+#include <cstring>
 #include <memory>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 using namespace std;
 
-State::State(){}
 State::~State(){}
 
-App::App(int ident, std::deque<TcpCode> aNotif, std::unordered_map<int, std::deque<TcpCode> > cNotifs): id(ident), appNotifs(aNotif), connNotifs(cNotifs) {}
+ListenS ListenS::instance;
+SynSentS SynSentS::instance;
+SynRecS SynRecS::instance;
+EstabS EstabS::instance;
+FinWait1S FinWait1S::instance;
+FinWait2S FinWait2S::instance;
+CloseWaitS CloseWaitS::instance;
+ClosingS ClosingS::instance;
+LastAckS LastAckS::instance;
+TimeWaitS TimeWaitS::instance;
+
+App::App(int ident): id(ident){
+  notifFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+App::~App(){
+  if(notifFd >= 0) ::close(notifFd);
+}
 int App::getId(){ return id; }
-std::deque<TcpCode>& App::getAppNotifs(){ return appNotifs; }
-std::unordered_map<int, std::deque<TcpCode> >& App::getConnNotifs(){ return connNotifs; }
+int App::getNotifFd(){ return notifFd; }
+uint64_t App::getOverflowedNotifs(){ return overflowedNotifs.load(std::memory_order_relaxed); }
+AppQueues* App::getQueues(){ return queues.get(); }
+void App::setQueues(std::unique_ptr<AppQueues> q){ queues = std::move(q); }
+
+//a full ring parks the notification in the overflow list rather than dropping it or stalling the driver. Once anything is parked later
+//notifications queue behind it, so no connection's notifications get reordered
+bool App::pushNotif(AppNotif n){
+  if(overflowSize.load(std::memory_order_acquire) > 0 || !notifs.push(n)){
+    std::lock_guard<std::mutex> guard(overflowLock);
+    overflow.push_back(n);
+    overflowSize.store(overflow.size(), std::memory_order_release);
+    overflowedNotifs.fetch_add(1, std::memory_order_relaxed);
+  }
+  //only the first notification since the app last cleared the signal pays for the eventfd write
+  if(notifFd >= 0 && !notifSignaled.exchange(true, std::memory_order_acq_rel)){
+    uint64_t one = 1;
+    ssize_t w = write(notifFd, &one, sizeof(one));
+    (void)w;
+  }
+  return true;
+}
+
+bool App::popNotif(AppNotif& out){
+  if(notifs.pop(out)){
+    if(overflowSize.load(std::memory_order_acquire) > 0) refillFromOverflow();
+    return true;
+  }
+  if(overflowSize.load(std::memory_order_acquire) == 0) return false;
+  refillFromOverflow();
+  return notifs.pop(out);
+}
+
+//moves parked notifications into the ring slots the app has freed, oldest first. Producers only go back to the ring once the list is empty
+void App::refillFromOverflow(){
+  std::lock_guard<std::mutex> guard(overflowLock);
+  while(!overflow.empty() && notifs.push(overflow.front())) overflow.pop_front();
+  overflowSize.store(overflow.size(), std::memory_order_release);
+}
+
+//same as popNotif in a loop, parked notifications are moved over whenever the ring runs dry so a batch reaper drains the overflow list too
+size_t App::popNotifs(std::vector<AppNotif>& out, size_t max){
+  size_t count = 0;
+  AppNotif n;
+  while(count < max){
+    if(!notifs.pop(n)){
+      if(overflowSize.load(std::memory_order_acquire) == 0) break;
+      refillFromOverflow();
+      if(!notifs.pop(n)) break;
+    }
+    out.push_back(n);
+    count++;
+  }
+  //hand the slots this batch freed to whatever is still parked, producers only go back to the ring once the list is empty
+  if(overflowSize.load(std::memory_order_acquire) > 0) refillFromOverflow();
+  return count;
+}
+
+/*
+clearNotifSignal-
+called by the app after the eventfd polls readable and before it drains the ring. Anything pushed after this point signals the eventfd again.
+*/
+void App::clearNotifSignal(){
+  if(notifFd >= 0){
+    uint64_t count = 0;
+    ssize_t r = read(notifFd, &count, sizeof(count));
+    (void)r;
+  }
+  notifSignaled.store(false, std::memory_order_seq_cst);
+}
 
 Event::Event(uint32_t ident): id(ident){}
 uint32_t Event::getId() { return id; }
@@ -37,10 +123,17 @@ OpenEv::OpenEv(bool p, uint32_t id): Event(id), passive(p){}
 bool OpenEv::isPassive(){ return passive; }
 SegmentEv::SegmentEv(IpPacket ipPacket, uint32_t id): Event(id), ipPacket(ipPacket){}
 IpPacket& SegmentEv::getIpPacket(){ return ipPacket; }
-SendEv::SendEv(std::deque<uint8_t> d, bool urg, bool psh, uint32_t id): Event(id), data(d), urgent(urg), push(psh){
+SendEv::SendEv(std::deque<uint8_t> d, bool urg, bool psh, uint32_t id): Event(id), data(std::move(d)), urgent(urg), push(psh){
   originalDataLen = data.size();
+  unsentBytes = originalDataLen;
 }
+SendEv::SendEv(const uint8_t* zc, uint32_t len, bool urg, bool psh, uint32_t id): Event(id), originalDataLen(len), unsentBytes(len), zeroCopyData(zc), urgent(urg), push(psh){}
+uint32_t SendEv::getUnsentBytes(){ return unsentBytes; }
+void SendEv::markSent(uint32_t bytes){ unsentBytes -= bytes; }
 std::deque<uint8_t>& SendEv::getData(){ return data; }
+const uint8_t* SendEv::getZeroCopyData(){ return zeroCopyData; }
+bool SendEv::isZeroCopy(){ return zeroCopyData != nullptr; }
+uint32_t SendEv::getLength(){ return originalDataLen; }
 bool SendEv::isUrgent(){ return urgent; }
 bool SendEv::isPush(){ return push; }
 void SendEv::checkSetSeqNum(uint32_t seq){ 
@@ -52,9 +145,25 @@ void SendEv::checkSetSeqNum(uint32_t seq){
 bool SendEv::sendAcked(uint32_t ack){
   return ((assignedSeqNum + originalDataLen) <= ack);
 }
-ReceiveEv::ReceiveEv(uint32_t a, std::vector<uint8_t> buff, uint32_t id): Event(id), amount(a), providedBuffer(buff){}
+ReceiveEv::ReceiveEv(uint32_t a, std::vector<uint8_t> buff, uint32_t id): Event(id), amount(a), lowWater(a), providedBuffer(std::move(buff)){}
+ReceiveEv::ReceiveEv(uint8_t* dest, uint32_t capacity, uint32_t low, uint64_t data, uint32_t id): Event(id), amount(capacity), lowWater(std::min(low, capacity)), registeredBuffer(dest), userData(data){}
 uint32_t ReceiveEv::getAmount(){ return amount; }
+uint32_t ReceiveEv::getLowWater(){ return lowWater; }
+uint32_t ReceiveEv::getBytesRead(){ return bytesRead; }
+bool ReceiveEv::isRegistered(){ return registeredBuffer != nullptr; }
+uint64_t ReceiveEv::getUserData(){ return userData; }
 std::vector<uint8_t>& ReceiveEv::getBuffer(){ return providedBuffer; }
+//where the next len bytes of the read go, straight into the caller's memory when it registered some
+uint8_t* ReceiveEv::claim(uint32_t len){
+  uint8_t* dst;
+  if(registeredBuffer != nullptr) dst = registeredBuffer + bytesRead;
+  else{
+    providedBuffer.resize(bytesRead + len);
+    dst = providedBuffer.data() + bytesRead;
+  }
+  bytesRead += len;
+  return dst;
+}
 CloseEv::CloseEv(uint32_t id): Event(id){}
 AbortEv::AbortEv(uint32_t id): Event(id){}
 
@@ -72,9 +181,9 @@ App* Tcb::getParApp() { return parentApp; }
 int Tcb::getId(){ return id; }
 ConnPair Tcb::getConnPair(){ return ConnPair(lP,rP); }
 
-State* Tcb::getCurrentState(){return &*currentState;}
+State* Tcb::getCurrentState(){return currentState;}
 
-void Tcb::setCurrentState(std::unique_ptr<State> s){ currentState = std::move(s); }
+void Tcb::setCurrentState(State& s){ currentState = &s; }
 
 bool Tcb::getPushSeen(){ return pushSeen;}
 bool Tcb::getUrgentSignaled(){ return urgentSignaled;}
@@ -85,6 +194,76 @@ bool Tcb::swsTimerExpired(){
   }
   else return false;
 }
+bool Tcb::markPacedQueued(){
+  if(pacedQueued) return false;
+  pacedQueued = true;
+  return true;
+}
+void Tcb::clearPacedQueued(){
+  pacedQueued = false;
+}
+//returns true if the driver's timer queue needs a new entry, ie there is none yet or the new deadline comes before it
+bool Tcb::markTimerQueued(std::chrono::steady_clock::time_point deadline){
+  if(timerQueued && !(deadline < timerQueuedAt)) return false;
+  timerQueued = true;
+  timerQueuedAt = deadline;
+  return true;
+}
+bool Tcb::timerQueuedFor(std::chrono::steady_clock::time_point deadline){
+  return timerQueued && timerQueuedAt == deadline;
+}
+void Tcb::clearTimerQueued(){
+  timerQueued = false;
+}
+
+/*
+pacingRate-
+bytes per second this connection's sends are spread at, 0 when unpaced. A controller with its own rate(bbr) sets it, otherwise it follows
+the window like linux tcp_update_pacing_rate: cwnd per srtt, scaled up so pacing never holds the window back.
+*/
+double Tcb::pacingRate(){
+  if(!pacing) return 0;
+  double rate = congestionControl().getPacingRate();
+  if(rate > 0 || firstKarnMeasurement || srtt.count() <= 0) return rate;
+
+  uint32_t cwnd = congestionControl().getCwnd();
+  double ratio = (cwnd < congestionControl().getSsthresh() / 2) ? PACING_SS_RATIO : PACING_CA_RATIO;
+  return ratio * cwnd / std::chrono::duration<double>(srtt).count();
+}
+
+void Tcb::setPacing(bool on){
+  pacing = on;
+}
+
+std::chrono::steady_clock::time_point Tcb::getNextPacedSend(){
+  return nextPacedSend;
+}
+
+/*
+pacingHold-
+Whether the pacing rate says the next segment may not leave yet. If so the connection goes on the driver's paced queue, which requeues it for
+sending at its departure time. With the SO_TXTIME offload opted in the segment may go early, stamped with that time, and the qdisc holds it instead.
+*/
+bool Tcb::pacingHold(){
+  if(pacingRate() <= 0) return false;
+  std::chrono::steady_clock::duration early = txTimeEnabled() ? std::chrono::steady_clock::duration(PACE_OFFLOAD_HORIZON) : std::chrono::steady_clock::duration(PACE_SLACK);
+  std::chrono::steady_clock::time_point release = nextPacedSend - early;
+  if(std::chrono::steady_clock::now() >= release) return false;
+  schedulePacedSend(*this, release);
+  return true;
+}
+
+//spaces sends by size over rate and returns when this segment is due to leave. A flow that was idle starts from now rather than catching up on the time it did not use
+std::chrono::steady_clock::time_point Tcb::advancePacing(uint32_t bytes){
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double rate = pacingRate();
+  if(rate <= 0) return now;
+  if(nextPacedSend < now) nextPacedSend = now;
+  std::chrono::steady_clock::time_point departure = nextPacedSend;
+  nextPacedSend += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(bytes / rate));
+  return departure;
+}
+
 bool Tcb::swsTimerStopped(){
   return !swsTimerRunning;
 }
@@ -94,6 +273,87 @@ void Tcb::stopSwsTimer(){
 void Tcb::resetSwsTimer(){
   swsTimerExpire = std::chrono::steady_clock::now() + swsTimerInterval;
   swsTimerRunning = true;
+  scheduleTimer(*this);
+}
+
+//returns true if the connection was not already in the send ready list and needs to be linked in
+bool Tcb::markSendReady(){
+  if(sendReady) return false;
+  sendReady = true;
+  return true;
+}
+bool Tcb::markRecReady(){
+  if(recReady) return false;
+  recReady = true;
+  return true;
+}
+void Tcb::clearSendReady(){
+  sendReady = false;
+}
+void Tcb::clearRecReady(){
+  recReady = false;
+}
+bool Tcb::markAckPending(){
+  if(ackPending) return false;
+  ackPending = true;
+  return true;
+}
+bool Tcb::ackPendingNow(){ return ackPending; }
+
+//the ack may already have gone out with something else since it was scheduled
+bool Tcb::flushPendingAck(int socket){
+  if(!ackPending) return true;
+  return sendCurrentAck(socket);
+}
+
+//in order data with nothing held behind it, the only kind an ack may be delayed for
+bool Tcb::arrivesInOrder(TcpPacket& tcpP){
+  return (tcpP.getSeqNum() == rNxt) && reassembly.empty();
+}
+
+/*
+ackReceivedSegment-
+decides how soon the data on a segment is acked(RFC 9293 3.8.6.3, RFC 5681 4.2). Out of order or duplicate data, data that fills a hole,
+a push or a fin and anything in quick ack mode is acked right away, otherwise the ack waits for a second full sized segment or the delayed ack
+timer. Right away still means once the driver's current receive batch is done, so a burst of segments shares one ack. inOrder is
+arrivesInOrder from before the segment was processed. Segments that occupy no sequence space are not acked.
+*/
+void Tcb::ackReceivedSegment(TcpPacket& tcpP, bool inOrder){
+
+  uint32_t len = static_cast<uint32_t>(tcpP.getPayload().size());
+  bool fin = tcpP.getFlag(TcpPacketFlags::FIN);
+  if((len == 0) && !fin) return;
+
+  rcvMssSeen = max(rcvMssSeen, len);
+  rcvBytesUnacked += len;
+  bool now = !inOrder || fin || tcpP.getFlag(TcpPacketFlags::PSH) || (quickAcks > 0) || (delAckInterval.count() == 0) || (rcvBytesUnacked > rcvMssSeen);
+  if(quickAcks > 0) quickAcks--;
+
+  if(now){
+    delAckTimerRunning = false;
+    scheduleAck(*this);
+  }
+  else if(!delAckTimerRunning){
+    delAckTimerExpire = std::chrono::steady_clock::now() + delAckInterval;
+    delAckTimerRunning = true;
+    scheduleTimer(*this);
+  }
+}
+
+//any segment sent with the current rNxt acks everything received, so a standalone ack that was owed or held back is no longer needed
+void Tcb::ackCarried(){
+  ackPending = false;
+  delAckTimerRunning = false;
+  rcvBytesUnacked = 0;
+}
+
+bool Tcb::delAckTimeoutCallback(int socket){
+  delAckTimerRunning = false;
+  return sendCurrentAck(socket);
+}
+
+void Tcb::setDelayedAck(std::chrono::milliseconds interval){
+  delAckInterval = min(interval, std::chrono::milliseconds(DEL_ACK_MILLISECONDS));
 }
 
 bool Tcb::timeWaitTimerExpired(){
@@ -107,14 +367,16 @@ void Tcb::startTimeWaitTimer(){
   if(currentState->getNum() == StateNums::TIMEWAIT){
     timeWaitTimerExpire = std::chrono::steady_clock::now() + timeWaitInterval;
     timeWaitTimerRunning = true;
+    scheduleTimer(*this);
   }
 }
 
 
-void Tcb::tryStartRtoTimer(){
+void Tcb::tryStartRTOTimer(){
   if(!rtoTimerRunning){
     rtoTimerExpire = std::chrono::steady_clock::now() + rtoInterval;
     rtoTimerRunning = true;
+    scheduleTimer(*this);
   }
 }
 void Tcb::stopRTOTimer(){
@@ -127,18 +389,123 @@ bool Tcb::rtoTimerExpired(){
   }
   else return false;
 }
+
+bool Tcb::probeTimerExpired(){
+  if(probeTimerRunning){
+    return std::chrono::steady_clock::now() >= probeTimerExpire;
+  }
+  else return false;
+}
+
+bool Tcb::reorderTimerExpired(){
+  if(reorderTimerRunning){
+    return std::chrono::steady_clock::now() >= reorderTimerExpire;
+  }
+  else return false;
+}
+bool Tcb::delAckTimerExpired(){
+  if(delAckTimerRunning){
+    return std::chrono::steady_clock::now() >= delAckTimerExpire;
+  }
+  else return false;
+}
+/*
+nextTimerDeadline-
+finds the earliest expiry among the running rto, probe, reorder, delayed ack, sws and time wait timers so the driver can sleep until then.
+returns false if no timers are running, in which case deadline is untouched.
+*/
+bool Tcb::nextTimerDeadline(std::chrono::steady_clock::time_point& deadline){
+
+  bool found = false;
+  if(rtoTimerRunning){
+    deadline = rtoTimerExpire;
+    found = true;
+  }
+  if(swsTimerRunning && (!found || swsTimerExpire < deadline)){
+    deadline = swsTimerExpire;
+    found = true;
+  }
+  if(timeWaitTimerRunning && (!found || timeWaitTimerExpire < deadline)){
+    deadline = timeWaitTimerExpire;
+    found = true;
+  }
+  if(probeTimerRunning && (!found || probeTimerExpire < deadline)){
+    deadline = probeTimerExpire;
+    found = true;
+  }
+  if(reorderTimerRunning && (!found || reorderTimerExpire < deadline)){
+    deadline = reorderTimerExpire;
+    found = true;
+  }
+  if(delAckTimerRunning && (!found || delAckTimerExpire < deadline)){
+    deadline = delAckTimerExpire;
+    found = true;
+  }
+  return found;
+}
+
 void Tcb::checkChangeRTOTimer(){
   if(handshakeHadRetransmission){
-    rto = RTO_BAD_HANDSHAKE_INITIAL_SECONDS;
+    rtoInterval = std::chrono::seconds(RTO_BAD_HANDSHAKE_INITIAL_SECONDS);
   }
   //otherwise default will still be 1 second
 }
 
-void Tcb::addToRetransmissions(TcpPacket p){
+void Tcb::addToRetransmissions(TcpPacket& p){
+  if(retransmissions.empty()){
+    //nothing in flight, so the next rate sample interval starts with this send
+    firstSentTime = deliveredTime = std::chrono::steady_clock::now();
+  }
   retransmissions.push_back(Retransmit(p));
+  stampDelivery(retransmissions.back());
   tryStartRTOTimer();
 }
 
+void Tcb::stampDelivery(Retransmit& r){
+  r.stampDelivery(delivered, deliveredTime, firstSentTime, appLimitedUntil != 0);
+}
+
+/*
+markDelivered-
+Counts a segment the peer now holds toward the delivered total. The rate sample for the ack comes from the most recently sent segment it
+delivered, whose send starts the next sample interval.
+*/
+void Tcb::markDelivered(Retransmit& r, std::chrono::steady_clock::time_point now){
+
+  delivered += r.getSegLen();
+  deliveredTime = now;
+  if(!rateCandidate || r.getDelivered() >= pendingRate.priorDelivered){
+    rateCandidate = true;
+    pendingRate.priorDelivered = r.getDelivered();
+    pendingRate.appLimited = r.isAppLimited();
+    pendingSendElapsed = r.getLastSendTimestamp() - r.getFirstSentTime();
+    pendingPriorTime = r.getDeliveredTime();
+    firstSentTime = r.getLastSendTimestamp();
+  }
+  if(appLimitedUntil != 0 && delivered > appLimitedUntil) appLimitedUntil = 0;
+}
+
+/*
+takeRateSample-
+Turns what was delivered since the last call into a delivery rate. The interval is the longer of the send and ack intervals, so a burst of
+acks arriving closer together than the data was sent does not inflate the rate. Returns a zero rate if nothing was delivered.
+*/
+RateSample Tcb::takeRateSample(){
+
+  RateSample rs;
+  if(!rateCandidate) return rs;
+  rateCandidate = false;
+  rs = pendingRate;
+  std::chrono::duration<double> ackElapsed = deliveredTime - pendingPriorTime;
+  rs.interval = max(pendingSendElapsed, ackElapsed);
+  if(rs.interval.count() > 0) rs.deliveryRate = (delivered - rs.priorDelivered) / rs.interval.count();
+  return rs;
+}
+
+uint64_t Tcb::getDelivered(){
+  return delivered;
+}
+
 bool Tcb::noRetransmitsOutstanding(){
   return retransmissions.empty();
 }
@@ -147,18 +514,30 @@ bool Tcb::noRetransmitsOutstanding(){
 bool Tcb::rtoExpireCallback(int socket){
 
   stopRTOTimer();
+  resetSackScoreboard();
+  //RFC 6582 3.2 step 1, dup acks for data sent before the timeout must not start another fast retransmit
+  fastRecoveryActive = false;
+  recoveryInflation = 0;
+  dupAcks = 0;
+  recoveryPoint = sNxt;
+  probeTimerRunning = false;
+  reorderTimerRunning = false;
+  tlpOutstanding = false;
+  //a record that was never resent is timing out for the first time
+  congestionControl().onRto(sNxt - sUna, retransmissions.front().isKarnSuitable());
   Retransmit& r = retransmissions.front();
   r.incrementRetransmit();
-  TcpPacket& rPacket = r.getPacket();
+  stampDelivery(r);
+  TcpPacket rPacket = rebuildSegment(r);
   //RFC 6298 5.7
-  if(rPacket.getFlag(TcpPacketFlags::SYN) && (rto < RTO_BAD_HANDSHAKE_INITIAL_SECONDS)){
+  if(r.getFlag(TcpPacketFlags::SYN) && (rtoInterval < std::chrono::seconds(RTO_BAD_HANDSHAKE_INITIAL_SECONDS))){
       handshakeHadRetransmission = true;
   }
   
   if(!sendPacket(socket,rP.first,rPacket)) return false;
-  rto = rto * 2; // exponential backoff required by RFC 6298
+  rtoInterval = rtoInterval * 2; // exponential backoff required by RFC 6298
   if(RTO_CEILING_SECONDS > -1){
-    rto = min(rto, RTO_CEILING_SECONDS);
+    rtoInterval = min(rtoInterval, std::chrono::microseconds(std::chrono::seconds(RTO_CEILING_SECONDS)));
   }  
   tryStartRTOTimer();
 
@@ -169,63 +548,121 @@ void Tcb::takeKarnSamplesAndRemoveFullyAckedRetransmits(uint32_t ack){
 
   std::chrono::time_point<std::chrono::steady_clock> measuredEnd = std::chrono::steady_clock::now();
 
-  for(auto iter = retransmissions.begin(); iter < retransmissions.end();){
+  //records are only dropped once the scan is done, so a cumulative ack removes a whole run of segments in one erase
+  auto iter = retransmissions.begin();
+  for(; iter != retransmissions.end(); iter++){
     Retransmit& r = *iter;
-    TcpPacket& p = r.getPacket();
         
-    if(p.getSeqNum() < ack){
+    if(r.getSeq() < ack){
 
       bool newDataAcked = r.updateAck(ack);
       //dont want to take a sample(or restart the rto timer) if this ack is the same or lower than an ack already seen for this segment(meaning new data hasnt actually reached the peer)
-      if(!newDataAcked) return;
+      if(!newDataAcked) break;
 
       if(r.isKarnSuitable()){
         std::chrono::duration<double> rttMeasurement = measuredEnd - r.getTimestamp();
+        latestRtt = rttMeasurement;
+        congestionControl().onRttSample(rttMeasurement);
         updateKarnVariables(rttMeasurement);    
+        echoRttValid = false;
+      }
+      //RFC 7323 4.1, the echoed timestamp says which transmission is being acked so a resent segment still gives one sample
+      else if(echoRttValid){
+        latestRtt = echoRtt;
+        congestionControl().onRttSample(echoRtt);
+        updateKarnVariables(echoRtt);
+        echoRttValid = false;
       }
 
       tryStartRTOTimer(); 
       
-      //fully acked
-      if((p.getSeqNum() + p.getSegSize()) <= ack){
-        iter = retransmissions.erase(iter);
+      //not fully acked, no chance later retransmits are fully or partially acked either since retransmits do not overlap
+      if((r.getSeq() + r.getSegLen()) > ack) break;
+      //sacked segments were counted when the sack arrived
+      if(!r.isSacked()){
+        markDelivered(r, measuredEnd);
+        rackUpdate(r, measuredEnd);
       }
-      else return; // no chance later retransmits are fully or partially acked if this one isnt fully acked, since retransmits do not overlap
 
     }
-    else return; // no chance later retransmits are fully or partially acked if this one isnt fully acked, since retransmits do not overlap
+    else break; // no chance later retransmits are fully or partially acked if this one isnt fully acked, since retransmits do not overlap
   }
+  retransmissions.erase(retransmissions.begin(), iter);
+  echoRttValid = false;
 
-  //if we get here, all outstanding data has been acked, no need for timer
-  stopRTOTimer();
+  //all outstanding data has been acked, no need for timer
+  if(retransmissions.empty()) stopRTOTimer();
 
 }
 
+/*
+updateKarnVariables-
+RFC 6298 2.2 and 2.3, kept in microseconds so sub millisecond paths get a meaningful rto. The result is held between the connection's rto floor
+and the ceiling.
+*/
 void Tcb::updateKarnVariables(std::chrono::duration<double> rttMeasurement){
   int k = 4;  //recommended by RFC 6298, not really sure why
+  std::chrono::microseconds r = std::chrono::duration_cast<std::chrono::microseconds>(rttMeasurement);
 
   if(firstKarnMeasurement){
-    srtt = rttMeasurement;
-    rttvar = rttMeasurement / 2;
+    srtt = r;
+    rttvar = r / 2;
   }
   else{
-    rttvar = ((1.0 - KARN_BETA) * RTTVAR) + (KARN_BETA * abs(srtt - rttMeasurement));
-    srtt = ((1.0 - KARN_ALPHA) * srtt) + (KARN_ALPHA * rttMeasurement);
+    rttvar = std::chrono::duration_cast<std::chrono::microseconds>(((1.0 - KARN_BETA) * rttvar) + (KARN_BETA * std::chrono::abs(srtt - r)));
+    srtt = std::chrono::duration_cast<std::chrono::microseconds>(((1.0 - KARN_ALPHA) * srtt) + (KARN_ALPHA * r));
   }
 
-  rtoInterval = srtt + max(CLOCK_GRANULARITY, k * rttvar);
-  rtoInterval = max(rtoInterval, RTO_FLOOR_SECONDS);
+  rtoInterval = srtt + max(std::chrono::duration_cast<std::chrono::microseconds>(CLOCK_GRANULARITY), k * rttvar);
+  rtoInterval = max(rtoInterval, std::chrono::microseconds(rtoFloor));
+  if(RTO_CEILING_SECONDS > -1){
+    rtoInterval = min(rtoInterval, std::chrono::microseconds(std::chrono::seconds(RTO_CEILING_SECONDS)));
+  }
   firstKarnMeasurement = false;
 }
 
-Retransmit::Retransmit(TcpPacket& p): packet(p){
-  originalSendTimeStamp = std::chrono::steady_clock::now();
+//a floor set before the first rtt sample only applies from that sample on, the initial rto stays at RFC 6298's one second
+void Tcb::setRtoFloor(std::chrono::milliseconds floor){
+  rtoFloor = floor;
+  if(!firstKarnMeasurement) rtoInterval = max(rtoInterval, std::chrono::microseconds(rtoFloor));
+}
+
+std::chrono::microseconds Tcb::getRto(){
+  return rtoInterval;
+}
+
+std::chrono::microseconds Tcb::getSrtt(){
+  return srtt;
 }
-Retransmit::incrementRetransmit(){
+
+Retransmit::Retransmit(TcpPacket& p){
+  seq = p.getSeqNum();
+  segLen = p.getSegSize();
+  dataLen = p.getPayload().size();
+  syn = p.getFlag(TcpPacketFlags::SYN);
+  fin = p.getFlag(TcpPacketFlags::FIN);
+  ack = p.getFlag(TcpPacketFlags::ACK);
+  urg = p.getFlag(TcpPacketFlags::URG);
+  psh = p.getFlag(TcpPacketFlags::PSH);
+  urgentPointer = p.getUrg();
+  originalSendTimestamp = std::chrono::steady_clock::now();
+}
+void Retransmit::incrementRetransmit(){
   numRetransmits++;
 }
-TcpPacket Retransmit::getPacket(){
-  return packet;
+uint32_t Retransmit::getSeq(){ return seq; }
+uint32_t Retransmit::getSegLen(){ return segLen; }
+uint32_t Retransmit::getDataLen(){ return dataLen; }
+uint16_t Retransmit::getUrgentPointer(){ return urgentPointer; }
+bool Retransmit::getFlag(TcpPacketFlags flag){
+  switch(flag){
+    case TcpPacketFlags::SYN: return syn;
+    case TcpPacketFlags::FIN: return fin;
+    case TcpPacketFlags::ACK: return ack;
+    case TcpPacketFlags::URG: return urg;
+    case TcpPacketFlags::PSH: return psh;
+    default: return false;
+  }
 }
 
 bool Retransmit::isKarnSuitable(){
@@ -247,13 +684,470 @@ bool Retransmit::updateAck(uint32_t ack){
   else return false;
 
 }
+
+bool Retransmit::isSacked(){ return sacked; }
+void Retransmit::setSacked(bool s){ sacked = s; }
+bool Retransmit::isHoleRetransmitted(){ return holeRetransmitted; }
+void Retransmit::setHoleRetransmitted(bool h){ holeRetransmitted = h; }
+uint64_t Retransmit::getDelivered(){ return delivered; }
+std::chrono::steady_clock::time_point Retransmit::getDeliveredTime(){ return deliveredTime; }
+std::chrono::steady_clock::time_point Retransmit::getFirstSentTime(){ return firstSentTime; }
+std::chrono::steady_clock::time_point Retransmit::getLastSendTimestamp(){ return lastSendTimestamp; }
+bool Retransmit::isAppLimited(){ return appLimited; }
+bool Retransmit::isRackLost(){ return rackLost; }
+void Retransmit::setRackLost(bool l){ rackLost = l; }
+
+//called on every transmission of the segment, a resend is sampled like a fresh send
+void Retransmit::stampDelivery(uint64_t d, std::chrono::steady_clock::time_point dTime, std::chrono::steady_clock::time_point fTime, bool limited){
+  delivered = d;
+  deliveredTime = dTime;
+  firstSentTime = fTime;
+  appLimited = limited;
+  lastSendTimestamp = std::chrono::steady_clock::now();
+}
+
+static bool seqBefore(uint32_t a, uint32_t b){
+  return static_cast<int32_t>(a - b) < 0;
+}
+
+/*
+updateSackScoreboard-
+Marks every retransmission record that lies entirely inside one of the sack blocks on this ack. Blocks that are not between sUna and sNxt are
+ignored(RFC 2018 allows stale blocks, and anything else is bogus). Returns whether the ack carried any usable block.
+*/
+bool Tcb::updateSackScoreboard(TcpPacket& tcpP){
+
+  bool usable = false;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  for(TcpOption& o : tcpP.getOptions()){
+    if(o.getKind() != static_cast<uint8_t>(TcpOptionKind::SACK)) continue;
+    std::vector<uint8_t>& d = o.getData();
+    for(size_t i = 0; i + 8 <= d.size(); i += 8){
+      uint32_t left = toAltOrder<uint32_t>(unloadBytes<uint32_t>(d.data(), i));
+      uint32_t right = toAltOrder<uint32_t>(unloadBytes<uint32_t>(d.data(), i + 4));
+      if(!seqBefore(left, right) || seqBefore(left, sUna) || seqBefore(sNxt, right)) continue;
+      usable = true;
+
+      //records are in sequence order, so skip straight to the first one at or past the left edge
+      auto iter = std::lower_bound(retransmissions.begin(), retransmissions.end(), left, [](Retransmit& r, uint32_t seq){ return seqBefore(r.getSeq(), seq); });
+      for(; iter != retransmissions.end(); iter++){
+        if(seqBefore(right, iter->getSeq() + iter->getSegLen())) break;
+        if(!iter->isSacked()){
+          markDelivered(*iter, now);
+          rackUpdate(*iter, now);
+        }
+        iter->setSacked(true);
+      }
+    }
+  }
+  return usable;
+
+}
+
+//RFC 2018 8, after a timeout the peer may have dropped what it sacked, so everything is treated as unsacked again
+void Tcb::resetSackScoreboard(){
+  for(Retransmit& r : retransmissions){
+    r.setSacked(false);
+    r.setHoleRetransmitted(false);
+    r.setRackLost(false);
+  }
+  sackRecoveryActive = false;
+}
+
+/*
+sackRecovery-
+RFC 6675 loss recovery driven by the scoreboard. A record is lost once DUP_THRESH sacked records, or more than (DUP_THRESH - 1) * mss sacked
+bytes, lie above it, or once RACK has marked it. Recovery starts when a record is lost and lasts until everything sent before it started is acked.
+While in recovery only lost holes are resent, each once, and only while the estimated data in flight(pipe) is under the peer and congestion
+windows.
+*/
+LocalCode Tcb::sackRecovery(int socket){
+
+  if(!sackOk || retransmissions.empty()){
+    sackRecoveryActive = false;
+    return LocalCode::SUCCESS;
+  }
+  if(sackRecoveryActive && !seqBefore(sUna, recoveryPoint)) sackRecoveryActive = false;
+
+  //one pass from the top down finds which records are lost
+  uint32_t mss = getEffectiveSendMss({});
+  std::vector<bool> lost(retransmissions.size(), false);
+  uint32_t sackedAbove = 0;
+  uint32_t sackedBytesAbove = 0;
+  bool anyLost = false;
+  for(size_t i = retransmissions.size(); i-- > 0;){
+    Retransmit& r = retransmissions[i];
+    if(r.isSacked()){
+      sackedAbove++;
+      sackedBytesAbove += r.getSegLen();
+    }
+    else lost[i] = (sackedAbove >= DUP_THRESH) || (sackedBytesAbove > (DUP_THRESH - 1) * mss) || r.isRackLost();
+    anyLost = anyLost || lost[i];
+  }
+
+  if(!sackRecoveryActive){
+    //RFC 6675 5, the third duplicate ack starts recovery even if the scoreboard cannot prove loss yet
+    if(!anyLost && (dupAcks < DUP_THRESH)) return LocalCode::SUCCESS;
+    if(!anyLost) lost[0] = true;
+    sackRecoveryActive = true;
+    probeTimerRunning = false;
+    recoveryPoint = sNxt;
+    congestionControl().onLoss(sNxt - sUna, std::chrono::steady_clock::now());
+  }
+
+  //RFC 6675 SetPipe: unsacked bytes not yet deemed lost are still in flight, and so is every resent hole
+  uint32_t pipe = 0;
+  for(size_t i = 0; i < retransmissions.size(); i++){
+    Retransmit& r = retransmissions[i];
+    if(r.isSacked()) continue;
+    if(!lost[i]) pipe += r.getSegLen();
+    if(r.isHoleRetransmitted()) pipe += r.getSegLen();
+  }
+
+  for(size_t i = 0; i < retransmissions.size(); i++){
+    Retransmit& r = retransmissions[i];
+    if(!lost[i] || r.isSacked() || r.isHoleRetransmitted()) continue;
+    if(pipe >= min(sWnd, congestionControl().getCwnd())) break;
+
+    r.incrementRetransmit();
+    r.setHoleRetransmitted(true);
+    stampDelivery(r);
+    TcpPacket rPacket = rebuildSegment(r);
+    if(!sendPacket(socket, rP.first, rPacket)) return LocalCode::SOCKET;
+    pipe += r.getSegLen();
+  }
+  return LocalCode::SUCCESS;
+}
+
+bool Tcb::inSackRecovery(){
+  return sackRecoveryActive;
+}
+
+//RFC 5681 2, an ack that tells the sender nothing except that a segment arrived out of order
+bool Tcb::isDuplicateAck(TcpPacket& tcpP){
+  return !retransmissions.empty() && (tcpP.getAckNum() == sUna) && tcpP.getPayload().empty() && !tcpP.getFlag(TcpPacketFlags::SYN)
+    && !tcpP.getFlag(TcpPacketFlags::FIN) && (peerWindow(tcpP) == sWnd);
+}
+
+/*
+duplicateAck-
+RFC 5681 3.2 and RFC 6582 for connections without sack. The first two duplicates only allow limited transmit. The third starts fast
+retransmit unless the ack does not cover recoveryPoint, which means the loss was already dealt with by an earlier recovery or timeout. Every
+further duplicate while in recovery inflates the window by a segment, since each one means a segment left the network.
+*/
+LocalCode Tcb::duplicateAck(int socket){
+
+  uint32_t mss = getEffectiveSendMss({});
+  if(fastRecoveryActive){
+    recoveryInflation += mss;
+    scheduleSend(*this);
+    return LocalCode::SUCCESS;
+  }
+  if(dupAcks < DUP_THRESH){
+    scheduleSend(*this);
+    return LocalCode::SUCCESS;
+  }
+  if((dupAcks > DUP_THRESH) || !seqBefore(recoveryPoint, sUna)) return LocalCode::SUCCESS;
+
+  fastRecoveryActive = true;
+  recoveryPoint = sNxt;
+  congestionControl().onLoss(sNxt - sUna, std::chrono::steady_clock::now());
+  recoveryInflation = DUP_THRESH * mss;
+  if(!resendFirstUnacked(socket)) return LocalCode::SOCKET;
+  scheduleSend(*this);
+  return LocalCode::SUCCESS;
+}
+
+/*
+fastRecoveryAck-
+RFC 6582 3.2 steps 5 and 6. An ack covering recoveryPoint ends recovery and drops the inflation, leaving cwnd at what the controller set on
+the loss. A partial ack means the next hole was lost too: it is resent at once and the inflation deflated by what was acked.
+*/
+LocalCode Tcb::fastRecoveryAck(int socket, uint32_t ackNum, uint32_t ackedBytes){
+
+  if(!seqBefore(ackNum, recoveryPoint)){
+    fastRecoveryActive = false;
+    recoveryInflation = 0;
+    return LocalCode::SUCCESS;
+  }
+  recoveryInflation = (recoveryInflation > ackedBytes) ? (recoveryInflation - ackedBytes) : 0;
+  if(ackedBytes >= getEffectiveSendMss({})) recoveryInflation += getEffectiveSendMss({});
+  if(!resendFirstUnacked(socket)) return LocalCode::SOCKET;
+  return LocalCode::SUCCESS;
+}
+
+//resends the oldest unacked segment, leaving the rto timer and its backoff alone
+bool Tcb::resendFirstUnacked(int socket){
+  if(retransmissions.empty()) return true;
+  Retransmit& r = retransmissions.front();
+  r.incrementRetransmit();
+  stampDelivery(r);
+  TcpPacket rPacket = rebuildSegment(r);
+  return sendPacket(socket, rP.first, rPacket);
+}
+
+bool Tcb::inFastRecovery(){
+  return fastRecoveryActive;
+}
+
+//RFC 8985 6.1, whether the first transmission happened after the second. Ties are broken by sequence number
+static bool sentAfter(std::chrono::steady_clock::time_point t1, uint32_t seq1, std::chrono::steady_clock::time_point t2, uint32_t seq2){
+  return (t1 > t2) || ((t1 == t2) && seqBefore(seq2, seq1));
+}
+
+/*
+rackUpdate-
+RFC 8985 6.2 steps 1 to 3 for a newly delivered segment. Notes reordering when it ends below the highest delivered sequence, and moves the
+rack fields to it if it was sent later than the current one. A resent segment acked faster than the min rtt was likely delivered by its
+original transmission, so its send time says nothing.
+*/
+void Tcb::rackUpdate(Retransmit& r, std::chrono::steady_clock::time_point now){
+
+  uint32_t endSeq = r.getSeq() + r.getSegLen();
+  if(seqBefore(endSeq, rackFack)) rackReorderingSeen = true;
+  else rackFack = endSeq;
+
+  std::chrono::duration<double> rtt = now - r.getLastSendTimestamp();
+  if(!r.isKarnSuitable() && (rtt < rackMinRtt)) return;
+  if(r.isKarnSuitable() && ((rackMinRtt.count() <= 0) || (rtt < rackMinRtt))) rackMinRtt = rtt;
+
+  if(!rackValid || sentAfter(r.getLastSendTimestamp(), endSeq, rackXmitTs, rackEndSeq)){
+    rackValid = true;
+    rackRtt = rtt;
+    rackXmitTs = r.getLastSendTimestamp();
+    rackEndSeq = endSeq;
+  }
+}
+
+//RFC 8985 6.2 step 4, no allowance for reordering once recovery is underway unless reordering has actually been seen
+std::chrono::duration<double> Tcb::rackReoWnd(){
+  if(!rackReorderingSeen && (sackRecoveryActive || (dupAcks >= DUP_THRESH))) return std::chrono::duration<double>(0);
+  std::chrono::duration<double> wnd = rackMinRtt / 4;
+  if(!firstKarnMeasurement) wnd = min(wnd, std::chrono::duration<double>(srtt));
+  return wnd;
+}
+
+/*
+rackDetectLoss-
+RFC 8985 6.2 step 5. Any segment sent before the most recently delivered one is lost once a rack rtt plus the reordering window has passed
+since it was sent. Segments that still have time left arm the reorder timer for the latest of those deadlines. Returns whether anything was
+newly marked lost.
+*/
+bool Tcb::rackDetectLoss(std::chrono::steady_clock::time_point now){
+
+  reorderTimerRunning = false;
+  if(!sackOk || !rackValid) return false;
+
+  std::chrono::duration<double> reoWnd = rackReoWnd();
+  std::chrono::steady_clock::duration timeout{0};
+  bool newLoss = false;
+  for(Retransmit& r : retransmissions){
+    if(r.isSacked() || r.isRackLost()) continue;
+    if(!sentAfter(rackXmitTs, rackEndSeq, r.getLastSendTimestamp(), r.getSeq() + r.getSegLen())) continue;
+
+    std::chrono::steady_clock::duration remaining = r.getLastSendTimestamp() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(rackRtt + reoWnd) - now;
+    if(remaining <= std::chrono::steady_clock::duration::zero()){
+      r.setRackLost(true);
+      newLoss = true;
+    }
+    else timeout = max(timeout, remaining);
+  }
+  if(timeout > std::chrono::steady_clock::duration::zero()){
+    reorderTimerExpire = now + timeout;
+    reorderTimerRunning = true;
+    scheduleTimer(*this);
+  }
+  return newLoss;
+}
+
+//the reordering window ran out for a segment rack was waiting on
+bool Tcb::reorderTimeoutCallback(int socket){
+  rackDetectLoss(std::chrono::steady_clock::now());
+  return sackRecovery(socket) == LocalCode::SUCCESS;
+}
+
+/*
+armProbeTimer-
+RFC 8985 7.2. After new data is sent or acked the probe timeout is two smoothed rtts(plus the worst case delayed ack when only one segment is
+out, since its ack may be held back), and never later than the rto. Not armed during recovery or while a probe is outstanding.
+*/
+void Tcb::armProbeTimer(){
+
+  probeTimerRunning = false;
+  if(!sackOk || retransmissions.empty() || tlpOutstanding || sackRecoveryActive || fastRecoveryActive) return;
+
+  std::chrono::duration<double> pto{RTO_INITIAL_SECONDS};
+  if(!firstKarnMeasurement){
+    pto = 2 * std::chrono::duration<double>(srtt);
+    if(retransmissions.size() == 1) pto += std::chrono::milliseconds(WC_DEL_ACK_MILLISECONDS);
+  }
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  probeTimerExpire = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(pto);
+  if(rtoTimerRunning && (rtoTimerExpire < probeTimerExpire)) probeTimerExpire = rtoTimerExpire;
+  probeTimerRunning = true;
+  scheduleTimer(*this);
+}
+
+/*
+probeTimeoutCallback-
+RFC 8985 7.3. Sends one segment so the peer's ack(and its sack blocks) shows what happened to the tail: new data if the windows allow it,
+otherwise the last segment sent again. The rto is restarted from the probe.
+*/
+bool Tcb::probeTimeoutCallback(int socket){
+
+  probeTimerRunning = false;
+  if(retransmissions.empty()) return true;
+
+  tlpOutstanding = true;
+  uint32_t mss = getEffectiveSendMss({});
+  uint32_t newBytes = min(mss, sendQueueByteCount);
+  if((newBytes > 0) && (usableSendWindow() >= newBytes)){
+    tlpIsRetrans = false;
+    if(packageAndSendSegments(socket, usableSendWindow(), newBytes) != LocalCode::SUCCESS) return false;
+  }
+  else{
+    tlpIsRetrans = true;
+    Retransmit& r = retransmissions.back();
+    r.incrementRetransmit();
+    stampDelivery(r);
+    TcpPacket rPacket = rebuildSegment(r);
+    if(!sendPacket(socket, rP.first, rPacket)) return false;
+  }
+  tlpEndSeq = sNxt;
+  stopRTOTimer();
+  tryStartRTOTimer();
+  return true;
+}
+
+//builds the sack option for an ack out of the out of order queue, returns how many words it adds to the header
+uint8_t Tcb::addSackOption(std::vector<TcpOption>& options){
+
+  if(!sackOk || reassembly.empty()) return 0;
+
+  std::vector<std::pair<uint32_t, uint32_t> > blocks;
+  //the timestamp option takes the room of one block(RFC 2018 3)
+  reassembly.sackBlocks(blocks, tsOk ? MAX_SACK_BLOCKS - 1 : MAX_SACK_BLOCKS);
+  std::vector<uint8_t> data;
+  for(auto& b : blocks){
+    loadBytes<uint32_t>(toAltOrder<uint32_t>(b.first), data);
+    loadBytes<uint32_t>(toAltOrder<uint32_t>(b.second), data);
+  }
+  options.push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::NOOP), 0, false, {}));
+  options.push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::NOOP), 0, false, {}));
+  options.push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::SACK), static_cast<uint8_t>(2 + data.size()), true, data));
+  return static_cast<uint8_t>(1 + 2 * blocks.size()); //two noops plus kind and length make one word, each block is two
+}
+
+//my side of the timestamp clock, millisecond ticks(RFC 7323 5.4 allows anything from 1ms to 1s)
+uint32_t Tcb::timestampNow(){
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()) + tsOffset;
+}
+
+TcpOption Tcb::buildTimestampOption(){
+  std::vector<uint8_t> data;
+  loadBytes<uint32_t>(toAltOrder<uint32_t>(timestampNow()), data);
+  loadBytes<uint32_t>(toAltOrder<uint32_t>(tsRecent), data);
+  return TcpOption(static_cast<uint8_t>(TcpOptionKind::TIMESTAMP), TIMESTAMP_OPTION_LEN, true, data);
+}
+
+//adds the timestamp option to a segment carrying an ack, returns how many words it adds to the header
+uint8_t Tcb::addTimestampOption(std::vector<TcpOption>& options){
+
+  if(!tsOk) return 0;
+
+  options.push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::NOOP), 0, false, {}));
+  options.push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::NOOP), 0, false, {}));
+  options.push_back(buildTimestampOption());
+  lastAckSent = rNxt;
+  return static_cast<uint8_t>(TIMESTAMP_OPTION_BYTES / 4);
+}
+
+bool Tcb::readTimestamp(TcpPacket& tcpP, uint32_t& tsVal, uint32_t& tsEcr){
+
+  for(TcpOption& o : tcpP.getOptions()){
+    if(o.getKind() != static_cast<uint8_t>(TcpOptionKind::TIMESTAMP) || o.getData().size() != 8) continue;
+    tsVal = toAltOrder<uint32_t>(unloadBytes<uint32_t>(o.getData().data(), 0));
+    tsEcr = toAltOrder<uint32_t>(unloadBytes<uint32_t>(o.getData().data(), 4));
+    return true;
+  }
+  return false;
+}
+
+/*
+checkPaws-
+RFC 7323 5.3 R1, rejects a segment whose timestamp is older than ts recent since it may be an old duplicate from before the sequence space
+wrapped. Resets are exempt, and like linux a segment without the option is let through rather than dropped.
+*/
+bool Tcb::checkPaws(TcpPacket& tcpP){
+
+  uint32_t tsVal = 0;
+  uint32_t tsEcr = 0;
+  if(!tsOk || tcpP.getFlag(TcpPacketFlags::RST) || !readTimestamp(tcpP, tsVal, tsEcr)) return true;
+  if(!seqBefore(tsVal, tsRecent)) return true;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if(now - tsRecentStamped > std::chrono::hours(24 * PAWS_IDLE_DAYS)){
+    tsRecent = tsVal;
+    tsRecentStamped = now;
+    return true;
+  }
+  return false;
+}
+
+//RFC 7323 4.3, only a segment covering the last ack i sent may move ts recent so that delayed acks echo the earliest unacked time
+void Tcb::updateTsRecent(TcpPacket& tcpP){
+
+  uint32_t tsVal = 0;
+  uint32_t tsEcr = 0;
+  if(!tsOk || !readTimestamp(tcpP, tsVal, tsEcr)) return;
+  if(!seqBefore(tsVal, tsRecent) && !seqBefore(lastAckSent, tcpP.getSeqNum())){
+    tsRecent = tsVal;
+    tsRecentStamped = std::chrono::steady_clock::now();
+  }
+}
+
+//turns the echo on an incoming ack into an rtt sample for takeKarnSamplesAndRemoveFullyAckedRetransmits
+void Tcb::noteEchoedTimestamp(TcpPacket& tcpP){
+
+  echoRttValid = false;
+  uint32_t tsVal = 0;
+  uint32_t tsEcr = 0;
+  if(!tsOk || !tcpP.getFlag(TcpPacketFlags::ACK) || !readTimestamp(tcpP, tsVal, tsEcr)) return;
+
+  //an echo from the future is bogus. Anything under a tick reads as 0, which would drag srtt and the congestion controller's min rtt to
+  //nothing, so it counts as one tick like linux does
+  int32_t ticks = static_cast<int32_t>(timestampNow() - tsEcr);
+  if(ticks < 0) return;
+  if(ticks == 0) ticks = 1;
+  echoRtt = std::chrono::milliseconds(ticks);
+  echoRttValid = true;
+}
+
+/*
+acceptsReopeningSyn-
+RFC 6191, a syn arriving in time wait may start a new incarnation straight away when it cannot be an old duplicate: its timestamp is newer
+than ts recent or, without timestamps on either incarnation, it starts past the old sequence space(RFC 1122 4.2.2.13).
+*/
+bool Tcb::acceptsReopeningSyn(TcpPacket& tcpP){
+
+  if(!tcpP.getFlag(TcpPacketFlags::SYN) || tcpP.getFlag(TcpPacketFlags::ACK) || tcpP.getFlag(TcpPacketFlags::RST)) return false;
+
+  uint32_t tsVal = 0;
+  uint32_t tsEcr = 0;
+  if(tsOk && readTimestamp(tcpP, tsVal, tsEcr)) return seqBefore(tsRecent, tsVal);
+  return seqBefore(rNxt, tcpP.getSeqNum());
+}
+
+bool Tcb::timestampsOk(){ return tsOk; }
+uint32_t Tcb::getTsRecent(){ return tsRecent; }
   
 void Tcb::okAcknowledgedSends(uint32_t ack){
 
   for(auto iter = unacknowledgedSends.begin(); iter < unacknowledgedSends.end();){
     SendEv& ev = *iter;
     if(ev.sendAcked(ack)){
-      notifyApp(parentApp, id, TcpCode::OK, ev.getId());   
+      if(ev.isZeroCopy()) notifyApp(parentApp, id, TcpCode::ZEROCOPYDONE, ev.getId(), ev.getLength());
+      else notifyApp(parentApp, id, TcpCode::OK, ev.getId());
       iter = unacknowledgedSends.erase(iter);
     }
     else return; 
@@ -300,6 +1194,7 @@ uint32_t Tcb::getEffectiveSendMss(vector<TcpOption> optionList){
     optionListByteCount += o.getData().size();
     
   }
+  if(tsOk) optionListByteCount += TIMESTAMP_OPTION_BYTES; //on every segment once negotiated
   uint32_t messageSize = peerMss + TCP_MIN_HEADER_LEN;
   uint32_t mmsS = getMmsS();
   if(mmsS < messageSize) messageSize = mmsS;
@@ -314,6 +1209,7 @@ LocalCode Tcb::packageAndSendSegments(int socket, uint32_t usableWindow, uint32_
   if(!closeQueue.empty() && (sendQueueByteCount <= numBytes) && (usableWindow > numBytes)) piggybackFin = true;
 
   TcpPacket sendPacket;
+  sendPacket.setSeq(sNxt);
   while(true){
   
      SendEv& ev = sendQueue.front();
@@ -329,25 +1225,28 @@ LocalCode Tcb::packageAndSendSegments(int socket, uint32_t usableWindow, uint32_
           sendPacket.setSeq(sNxt);
      }
      
-     while((ev.getData().size() > 0) && (numBytes > 0)){
-        sendPacket.getPayload().push_back(ev.getData().front());
-        ev.getData().pop_front();
-        sNxt++;
-        sendQueueByteCount--;
-        numBytes--;
-     }
+     //bulk copy straight out of the send buffer, the sequence number is the buffer index
+     uint32_t take = min(ev.getUnsentBytes(), numBytes);
+     std::vector<uint8_t>& payload = sendPacket.getPayload();
+     size_t oldSize = payload.size();
+     payload.resize(oldSize + take);
+     sendBuffer.copyOut(sNxt, take, payload.data() + oldSize);
+     ev.markSent(take);
+     sNxt += take;
+     sendQueueByteCount -= take;
+     numBytes -= take;
      
      if(ev.isUrgent()){
         sendPacket.setFlag(TcpPacketFlags::URG);
         sendPacket.setUrgentPointer(sNxt - sendPacket.getSeqNum() -1);
      }
      
-     if(ev.getData().size() == 0){
-        sendQueue.pop_front();
-        unacknowledgedSends.push_back(ev);
+     if(ev.getUnsentBytes() == 0){
         if(ev.isPush()){
           sendPacket.setFlag(TcpPacketFlags::PSH);
         }
+        unacknowledgedSends.push_back(std::move(ev));
+        sendQueue.pop_front();
      }
     
      if(numBytes == 0){
@@ -370,10 +1269,10 @@ LocalCode Tcb::packageAndSendSegments(int socket, uint32_t usableWindow, uint32_
 
 bool Tcb::scanForPush(uint32_t usableWindow, int& bytes){
     
-    int bytesCovered;
+    int bytesCovered = 0;
     for(auto iter = sendQueue.begin(); iter < sendQueue.end(); iter++){
       SendEv& ev = *iter;
-      bytesCovered+= ev.getData().size();
+      bytesCovered+= ev.getUnsentBytes();
       if(bytesCovered > usableWindow){
         return false;
       }
@@ -386,6 +1285,34 @@ bool Tcb::scanForPush(uint32_t usableWindow, int& bytes){
     return false;
 }
 
+/*
+usableSendWindow-
+How many more bytes may be sent right now: the smaller of the peer's window and the congestion window, less what is already in flight.
+The congestion window is stretched by fast recovery inflation and limited transmit.
+*/
+uint32_t Tcb::usableSendWindow(){
+  uint32_t flight = sNxt - sUna;
+  uint32_t cwnd = congestionControl().getCwnd() + recoveryInflation;
+  //RFC 3042 limited transmit, each of the first two duplicate acks lets one new segment out without touching cwnd
+  if(!fastRecoveryActive && !sackRecoveryActive && (dupAcks < DUP_THRESH)) cwnd += dupAcks * getEffectiveSendMss({});
+  uint32_t wnd = min(sWnd, cwnd);
+  return (wnd > flight) ? (wnd - flight) : 0;
+}
+
+CongestionControl& Tcb::congestionControl(){
+  if(!congestion) congestion = makeCongestionControl(congestionAlgo, getEffectiveSendMss({}));
+  return *congestion;
+}
+
+//switching controllers mid connection keeps the current window and threshold, like changing TCP_CONGESTION on a live socket
+void Tcb::setCongestionAlgo(CongestionAlgo algo){
+  congestionAlgo = algo;
+  if(!congestion || congestion->getAlgo() == algo) return;
+  std::unique_ptr<CongestionControl> next = makeCongestionControl(algo, getEffectiveSendMss({}));
+  next->init(getEffectiveSendMss({}), congestion->getCwnd(), congestion->getSsthresh());
+  congestion = std::move(next);
+}
+
 LocalCode Tcb::trySend(int socket){
 
   //sends should only be processed at or after establishment of the connection
@@ -395,11 +1322,15 @@ LocalCode Tcb::trySend(int socket){
 
   while(true){
     uint32_t effSendMss = getEffectiveSendMss(vector<TcpOption>{});
-    uint32_t usableWindow = sUna + sWnd - sNxt; 
+    uint32_t usableWindow = usableSendWindow();
     uint32_t minDu = min(usableWindow,sendQueueByteCount);
     if(minDu < 1){
+      //the window had room but the app gave nothing to fill it, rate samples until this data is delivered understate the path
+      if(sendQueueByteCount == 0 && usableWindow > 0) appLimitedUntil = max<uint64_t>(delivered + (sNxt - sUna), 1);
       break;
     }
+    //the driver requeues this connection once the pace timer expires
+    if(pacingHold()) break;
     bool nagleCheck = (((sNxt == sUna) && nagle) || !nagle);
     int endPush = 0;
   
@@ -428,6 +1359,7 @@ LocalCode Tcb::trySend(int socket){
       if(swsTimerStopped()){
         resetSwsTimer();
       }
+      //the driver requeues this connection once the sws timer expires. Anything held back by the window waits for an ack to requeue it.
       break;
       
     }
@@ -511,13 +1443,15 @@ bool Tcb::pickRealIsn(){
     return false;
   }
   
-  cleanup(0,sha256,ctx,outdigest);
-  
-  if(len < 4){
+  if(len < 8){
+    cleanup(0,sha256,ctx,outdigest);
     return false;
   }
   
   uint32_t bufferTrunc = outdigest[0] | (outdigest[1] << 8) | (outdigest[2] << 16) | (outdigest[3] << 24);
+  //the timestamp clock offset comes from the same digest(RFC 7323 5.4)
+  tsOffset = outdigest[4] | (outdigest[5] << 8) | (outdigest[6] << 16) | (outdigest[7] << 24);
+  cleanup(0,sha256,ctx,outdigest);
   
   iss = tVal + bufferTrunc;
   return true;
@@ -590,10 +1524,44 @@ bool Tcb::sendReset(int socket, LocalPair lp, RemotePair rp, uint32_t ackNum, bo
 //assumes seq num, data, urgPointer and urgFlag have already been set
 bool Tcb::sendDataPacket(int socket, TcpPacket& p){
 
- p.setFlag(TcpPacketFlags::ACK).setSrcPort(lP.second).setDestPort(rP.second).setAck(rNxt).setWindow(rWnd).setOptions(vector<TcpOption>{}).setRealChecksum(lP.first, rP.first);
+ vector<TcpOption> options;
+ p.setDataOffset(DEFAULT_TCP_DATA_OFFSET + addTimestampOption(options));
+ p.setFlag(TcpPacketFlags::ACK).setSrcPort(lP.second).setDestPort(rP.second).setAck(rNxt).setWindow(advertisedWindow()).setOptions(options).setRealChecksum(lP.first, rP.first);
       
   addToRetransmissions(p);
-  return sendPacket(socket,rP.first,p);
+  ackCarried();
+  congestionControl().onSend(p.getSegSize(), sNxt - sUna - p.getSegSize(), std::chrono::steady_clock::now());
+  std::chrono::steady_clock::time_point departure = advancePacing(p.getSegSize());
+  armProbeTimer();
+  return sendPacket(socket,rP.first,p,departure);
+}
+
+/*
+rebuildSegment-
+recreates a segment from its retransmission record. The payload is copied back out of the send buffer, which still holds everything past sUna.
+ack and window are refreshed to the current values.
+*/
+TcpPacket Tcb::rebuildSegment(Retransmit& r){
+
+  if(r.getFlag(TcpPacketFlags::SYN)){
+    return buildSyn(lP, rP, r.getFlag(TcpPacketFlags::ACK));
+  }
+  
+  TcpPacket p;
+  p.setSeq(r.getSeq());
+  std::vector<uint8_t>& payload = p.getPayload();
+  payload.resize(r.getDataLen());
+  sendBuffer.copyOut(r.getSeq(), r.getDataLen(), payload.data());
+  if(r.getFlag(TcpPacketFlags::FIN)) p.setFlag(TcpPacketFlags::FIN);
+  if(r.getFlag(TcpPacketFlags::PSH)) p.setFlag(TcpPacketFlags::PSH);
+  if(r.getFlag(TcpPacketFlags::URG)){
+    p.setFlag(TcpPacketFlags::URG);
+    p.setUrgentPointer(r.getUrgentPointer());
+  }
+  vector<TcpOption> options;
+  p.setDataOffset(DEFAULT_TCP_DATA_OFFSET + addTimestampOption(options));
+  p.setFlag(TcpPacketFlags::ACK).setSrcPort(lP.second).setDestPort(rP.second).setAck(rNxt).setWindow(advertisedWindow()).setOptions(options).setRealChecksum(lP.first, rP.first);
+  return p;
 }
 
 bool Tcb::sendCurrentAck(int socket){
@@ -601,8 +1569,12 @@ bool Tcb::sendCurrentAck(int socket){
   TcpPacket sPacket;
   vector<TcpOption> options;
   vector<uint8_t> data;
-  sPacket.setFlag(TcpPacketFlags::ACK).setSrcPort(lP.second).setDestPort(rP.second).setSeq(sNxt).setAck(rNxt).setWindow(rWnd).setOptions(options).setPayload(data).setRealChecksum(lP.first, rP.first);
+  uint8_t optionWords = addTimestampOption(options);
+  optionWords += addSackOption(options);
+  sPacket.setDataOffset(sPacket.getDataOffset() + optionWords);
+  sPacket.setFlag(TcpPacketFlags::ACK).setSrcPort(lP.second).setDestPort(rP.second).setSeq(sNxt).setAck(rNxt).setWindow(advertisedWindow()).setOptions(options).setPayload(data).setRealChecksum(lP.first, rP.first);
       
+  ackCarried();
   return sendPacket(socket,rP.first,sPacket);
 }
 
@@ -611,15 +1583,25 @@ bool Tcb::sendFin(int socket){
   TcpPacket sPacket;
   vector<TcpOption> options;
   vector<uint8_t> data;
-  sPacket.setFlag(TcpPacketFlags::FIN).setFlag(TcpPacketFlags::ACK).setSrcPort(lP.second).setDestPort(rP.second).setSeq(sNxt).setAck(rNxt).setWindow(rWnd).setOptions(options).setPayload(data).setRealChecksum(lP.first, rP.first);
+  sPacket.setDataOffset(sPacket.getDataOffset() + addTimestampOption(options));
+  sPacket.setFlag(TcpPacketFlags::FIN).setFlag(TcpPacketFlags::ACK).setSrcPort(lP.second).setDestPort(rP.second).setSeq(sNxt).setAck(rNxt).setWindow(advertisedWindow()).setOptions(options).setPayload(data).setRealChecksum(lP.first, rP.first);
       
   addToRetransmissions(sPacket);
+  ackCarried();
   return sendPacket(socket,rP.first,sPacket);
   
 }
 
 bool Tcb::sendSyn(int socket, LocalPair lp, RemotePair rp, bool sendAck){
 
+  TcpPacket sPacket = buildSyn(lp, rp, sendAck);
+  addToRetransmissions(sPacket);  
+  return sendPacket(socket, rp.first, sPacket);
+  
+}
+
+TcpPacket Tcb::buildSyn(LocalPair lp, RemotePair rp, bool sendAck){
+
   vector<TcpOption> options;
   vector<uint8_t> data;
   TcpPacket sPacket;
@@ -628,7 +1610,8 @@ bool Tcb::sendSyn(int socket, LocalPair lp, RemotePair rp, bool sendAck){
     sPacket.setFlag(TcpPacketFlags::ACK);
     sPacket.setAck(rNxt);
   }
-  sPacket.setFlag(TcpPacketFlags::SYN).setSrcPort(lp.second).setDestPort(rp.second).setSeq(iss).setWindow(rWnd).setOptions(options).setPayload(data);
+  //the window in a syn is never scaled(RFC 7323 2.2)
+  sPacket.setFlag(TcpPacketFlags::SYN).setSrcPort(lp.second).setDestPort(rp.second).setSeq(iss).setWindow(static_cast<uint16_t>(min(rWnd, MAX_UNSCALED_WINDOW))).setOptions(options).setPayload(data);
     
   if(myMss != DEFAULT_MSS){
     vector<uint8_t> mss;
@@ -637,17 +1620,47 @@ bool Tcb::sendSyn(int socket, LocalPair lp, RemotePair rp, bool sendAck){
     sPacket.getOptions().push_back(mssOpt);
     sPacket.setDataOffset(sPacket.getDataOffset() + 1); //since the mss option is 4 bytes we can cleanly add one word to offset.
   }
+
+  //always offered on an initial syn, but a syn-ack may only carry it if the peer's syn did
+  if(!sendAck || windowScaling){
+    TcpOption noop(static_cast<uint8_t>(TcpOptionKind::NOOP), 0, false, {});
+    TcpOption wsOpt(static_cast<uint8_t>(TcpOptionKind::WSCALE), 0x3, true, vector<uint8_t>{myWindowShift()});
+    sPacket.getOptions().push_back(noop);
+    sPacket.getOptions().push_back(wsOpt);
+    sPacket.setDataOffset(sPacket.getDataOffset() + 1); //noop plus the 3 byte option is one word
+  }
+
+  //same rule as window scaling
+  if(!sendAck || sackOk){
+    TcpOption noop(static_cast<uint8_t>(TcpOptionKind::NOOP), 0, false, {});
+    TcpOption sackPermOpt(static_cast<uint8_t>(TcpOptionKind::SACK_PERMITTED), 0x2, true, {});
+    sPacket.getOptions().push_back(noop);
+    sPacket.getOptions().push_back(noop);
+    sPacket.getOptions().push_back(sackPermOpt);
+    sPacket.setDataOffset(sPacket.getDataOffset() + 1);
+  }
+
+  //same rule again. An initial syn has nothing to echo yet, so its ts recent is still 0
+  if(!sendAck || tsOk){
+    TcpOption noop(static_cast<uint8_t>(TcpOptionKind::NOOP), 0, false, {});
+    sPacket.getOptions().push_back(noop);
+    sPacket.getOptions().push_back(noop);
+    sPacket.getOptions().push_back(buildTimestampOption());
+    sPacket.setDataOffset(sPacket.getDataOffset() + TIMESTAMP_OPTION_BYTES / 4);
+    if(sendAck) lastAckSent = rNxt;
+  }
   
   sPacket.setRealChecksum(lp.first, rp.first);
-
-  addToRetransmissions(sPacket);  
-  return sendPacket(socket, rp.first, sPacket);
+  return sPacket;
   
 }
 
 void Tcb::initSenderState(bool flipOpenType){
       sUna = iss;
       sNxt =  iss + 1;
+      recoveryPoint = iss;
+      sendBuffer.anchor(sNxt);
+      sendMeasureStart = std::chrono::steady_clock::now();
       if(flipOpenType) passiveOpen = !passiveOpen;
 }
 
@@ -663,7 +1676,7 @@ LocalCode ListenS::processEvent(int socket, Tcb& b, OpenEv& oe){
     bool ls = b.sendSyn(socket, cp.first, cp.second, false);
     if(ls){
       b.initSenderState(true);
-      b.setCurrentState(make_unique<SynSentS>());
+      b.setCurrentState(SynSentS::instance);
       return LocalCode::SUCCESS;
     }
     else return LocalCode::SOCKET;
@@ -714,26 +1727,78 @@ LocalCode TimeWaitS::processEvent(int socket, Tcb& b, OpenEv& oe){
 }
 
 
+/*
+checkAndSetPeerMSS-
+Reads the options on a peer's syn. Besides the mss this settles window scaling and sack: each is on only if this syn carries the option, since
+an initial syn from here always offers both and a syn-ack from here only answers an offer.
+*/
 void Tcb::checkAndSetPeerMSS(TcpPacket& tcpP){
 
+  windowScaling = false;
+  sackOk = false;
+  uint32_t tsVal = 0;
+  uint32_t tsEcr = 0;
+  tsOk = readTimestamp(tcpP, tsVal, tsEcr);
+  if(tsOk){
+    tsRecent = tsVal;
+    tsRecentStamped = std::chrono::steady_clock::now();
+  }
   vector<TcpOption>& options = tcpP.getOptions();
   for(auto i = options.begin(); i < options.end(); i++){
   
-    TcpOption o = *i;
+    TcpOption& o = *i;
     if(o.getKind() == static_cast<uint8_t>(TcpOptionKind::MSS)){
     
       uint16_t sentMss = toAltOrder<uint16_t>(unloadBytes<uint16_t>(o.getData().data(),0));
       peerMss = sentMss;
-      break;
+    }
+    else if((o.getKind() == static_cast<uint8_t>(TcpOptionKind::WSCALE)) && (o.getData().size() == 1)){
+      windowScaling = true;
+      sndWndShift = min(o.getData()[0], MAX_WINDOW_SHIFT); //RFC 7323 2.3, larger shifts are treated as 14
+    }
+    else if(o.getKind() == static_cast<uint8_t>(TcpOptionKind::SACK_PERMITTED)){
+      sackOk = true;
     }
   }
 
+  if(congestion) congestion->setMss(getEffectiveSendMss({}));
+
+  if(windowScaling){
+    rcvWndShift = myWindowShift();
+    updateWindowSWSRec(0); //the window can now open past 64k
+  }
+  else{
+    sndWndShift = 0;
+    rcvWndShift = 0;
+  }
+
+}
+
+//smallest shift that lets the largest receive buffer this connection may grow to be advertised
+uint8_t Tcb::myWindowShift(){
+  if(offeredWndShift < 0){
+    uint32_t target = recBufferLocked ? recBufferLimit : max(recBufferLimit, AUTOTUNE_REC_BUFFER_MAX);
+    uint8_t shift = 0;
+    while((shift < MAX_WINDOW_SHIFT) && ((target >> shift) > MAX_UNSCALED_WINDOW)) shift++;
+    offeredWndShift = shift;
+  }
+  return static_cast<uint8_t>(offeredWndShift);
+}
+
+//the peer's window in bytes. Windows on syns are never scaled
+uint32_t Tcb::peerWindow(TcpPacket& tcpP){
+  uint32_t wind = tcpP.getWindow();
+  if(tcpP.getFlag(TcpPacketFlags::SYN)) return wind;
+  return wind << sndWndShift;
 }
 
 void Tcb::initReceiverState(uint32_t seqNum){   
     irs = seqNum;
     appNewData = irs;
     rNxt = irs + 1;
+    recBuffer.anchor(rNxt);
+    recMeasureStart = std::chrono::steady_clock::now();
+    quickAcks = QUICKACK_SEGMENTS;
 }
 
 void Tcb::specifyRemotePair(RemotePair recPair){
@@ -820,7 +1885,7 @@ LocalCode ListenS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& r
     bool sent = b.sendSyn(socket, cp.first, recPair, true);
     if(sent){
       b.initSenderState(false);
-      b.setCurrentState(make_unique<SynRecS>());
+      b.setCurrentState(SynRecS::instance);
       b.specifyRemotePair(recPair);
       
       /*
@@ -850,8 +1915,12 @@ bool Tcb::checkBlindResetPossible(uint32_t seqNum){
   return (seqNum != rNxt);
 }
 
+//everything before the new sUna has reached the peer, so its bytes can leave the send buffer in one step
 void Tcb::advanceUna(uint32_t ackNum){
+  uint32_t acked = ackNum - sUna;
   sUna = ackNum;
+  sendBuffer.release(ackNum);
+  autotuneSendBuffer(acked);
 }
 
 void Tcb::updateWindowVars(uint32_t wind, uint32_t seqNum, uint32_t ackNum){
@@ -859,6 +1928,7 @@ void Tcb::updateWindowVars(uint32_t wind, uint32_t seqNum, uint32_t ackNum){
       if(sWnd >= maxSWnd) maxSWnd = sWnd;
       sWl1 = seqNum;
       sWl2 = ackNum;
+      scheduleSend(*this);
 }
 
 LocalCode SynSentS::establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode){ return LocalCode::SUCCESS;}
@@ -924,12 +1994,13 @@ LocalCode SynSentS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode&
       //standard connection attempt
       
       b.advanceUna(ackN);// ack already validated earlier in method
-      b.updateWindowVars(tcpP.getWindow(),seqN,ackN);
+      b.updateWindowVars(b.peerWindow(tcpP),seqN,ackN);
     
+      b.noteEchoedTimestamp(tcpP);
       b.takeKarnSamplesAndRemoveFullyAckedRetransmits(ackN);
       bool sent = b.sendCurrentAck(socket);
       if(sent){
-          b.setCurrentState(make_unique<EstabS>());
+          b.setCurrentState(EstabS::instance);
           b.checkChangeRTOTimer();
           b.checkSavePacketForEstabProcessing(se); 
           return LocalCode::SUCCESS;
@@ -944,7 +2015,7 @@ LocalCode SynSentS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode&
       //simultaneous connection attempt
       bool sent = b.sendSyn(socket, cp.first, cp.second, true);
       if(sent){
-        b.setCurrentState(make_unique<SynRecS>());
+        b.setCurrentState(SynRecS::instance);
         b.checkSavePacketForEstabProcessing(se);
         return LocalCode::SUCCESS;
       }
@@ -964,7 +2035,8 @@ LocalCode SynSentS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode&
 
 LocalCode Tcb::checkSequenceNum(int socket, TcpPacket& tcpP, RemoteCode& remCode){
 
-  if(!verifyRecWindow(tcpP)){
+  //PAWS comes ahead of the window check(RFC 7323 5.3) and is answered the same way
+  if(!checkPaws(tcpP) || !verifyRecWindow(tcpP)){
     remCode = RemoteCode::UNEXPECTEDPACKET;
     if(!tcpP.getFlag(TcpPacketFlags::RST)){
       bool sent = sendCurrentAck(socket);
@@ -974,20 +2046,10 @@ LocalCode Tcb::checkSequenceNum(int socket, TcpPacket& tcpP, RemoteCode& remCode
     return LocalCode::SUCCESS;
   }
   
+  updateTsRecent(tcpP);
   return LocalCode::SUCCESS;
 }
 
-/*Status checkSaveForLater(Tcb&b, IpPacket& ipP){
-
-  uint32_t seqNum = tcpP.getSeqNum();
-  //SHLD 31 packet in window but not the expected one should be held for later processing.
-  if(seqNum > b.rNxt){
-    b.waitingPackets[seqNum] = ipP;
-    return Status();
-  }
-
-}*/
-
 LocalCode Tcb::checkReset(int socket, TcpPacket& tcpP, bool windowChecked, RemoteCode& remCode, bool& reset){
 
   if(tcpP.getFlag(TcpPacketFlags::RST)){
@@ -1077,19 +2139,51 @@ LocalCode Tcb::establishedAckLogic(int socket, TcpPacket& tcpP, RemoteCode& remC
     uint32_t seqNum = tcpP.getSeqNum();
     
     if((ackNum >= sUna) && (ackNum <= sNxt)){
+
+      //has to be judged before the window below is updated from this packet
+      bool dupAck = isDuplicateAck(tcpP);
     
       if(ackNum > sUna){
-        sUna = ackNum;
+        AckEvent ackEv;
+        ackEv.ackedBytes = ackNum - sUna;
+        ackEv.inFlight = sNxt - sUna;
+        ackEv.inRecovery = sackRecoveryActive || fastRecoveryActive;
+        ackEv.now = std::chrono::steady_clock::now();
+        advanceUna(ackNum);
+        noteEchoedTimestamp(tcpP);
         takeKarnSamplesAndRemoveFullyAckedRetransmits(ackNum);
+        ackEv.delivered = delivered;
+        ackEv.rate = takeRateSample();
+        congestionControl().onAck(ackEv);
         okAcknowledgedSends(ackNum);
+        dupAcks = 0;
+        if(fastRecoveryActive){
+          LocalCode lc = fastRecoveryAck(socket, ackNum, ackEv.ackedBytes);
+          if(lc != LocalCode::SUCCESS) return lc;
+        }
+        //RFC 8985 7.4, without dsack there is no telling whether a resent probe repaired a loss, so it is assumed it did
+        if(tlpOutstanding && !seqBefore(ackNum, tlpEndSeq)){
+          tlpOutstanding = false;
+          if(tlpIsRetrans) congestionControl().onLoss(ackEv.inFlight, ackEv.now);
+        }
+        armProbeTimer();
+        scheduleSend(*this);
       }
       
       if((sWl1 < seqNum) || ((sWl1 == seqNum) && (sWl2 <= ackNum))){
-        sWnd = tcpP.getWindow();
-        if(sWnd >= maxSWnd) maxSWnd = sWnd;
-        sWl1 = seqNum;
-        sWl2 = ackNum;
+        updateWindowVars(peerWindow(tcpP), seqNum, ackNum);
+      }
+
+      if(dupAck) dupAcks++;
+      //without new sack information or a third duplicate nothing can have become lost, so recovery only needs a look then or when it is already running
+      if(sackOk){
+        bool sackInfo = updateSackScoreboard(tcpP);
+        bool rackLoss = rackDetectLoss(std::chrono::steady_clock::now());
+        if(sackInfo || rackLoss || sackRecoveryActive || (dupAcks >= DUP_THRESH)) return sackRecovery(socket);
+        if(dupAck) scheduleSend(*this);
+        return LocalCode::SUCCESS;
       }
+      if(dupAck) return duplicateAck(socket);
       return LocalCode::SUCCESS;
             
     }
@@ -1111,7 +2205,7 @@ LocalCode Tcb::checkUrg(TcpPacket& tcpP, Event& e){
     uint32_t segUp = tcpP.getSeqNum() + tcpP.getUrg();
     if(rUp < segUp) rUp = segUp;
     if((rUp >= appNewData) && !urgentSignaled){
-      notifyApp(parentApp, id, TcpCode::URGENTDATA, e.getId());
+      notifyApp(parentApp, id, TcpCode::URGENTDATA, e.getId(), rUp - appNewData);
       urgentSignaled = true;
     }
   }
@@ -1119,55 +2213,243 @@ LocalCode Tcb::checkUrg(TcpPacket& tcpP, Event& e){
 }
 
 
+//shared by every shard thread
+static std::atomic<uint64_t> bufferBudget{DEFAULT_BUFFER_BUDGET_BYTES};
+static std::atomic<uint64_t> bufferBytesCharged{0};
+
+void setBufferBudget(uint64_t bytes){
+  bufferBudget.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t getBufferBudget(){
+  return bufferBudget.load(std::memory_order_relaxed);
+}
+
+uint64_t getBufferBytesCharged(){
+  return bufferBytesCharged.load(std::memory_order_relaxed);
+}
+
+BufferCharge::~BufferCharge(){
+  resize(0);
+}
+
+BufferCharge::BufferCharge(BufferCharge&& other) : bytes(other.bytes){
+  other.bytes = 0;
+}
+
+BufferCharge& BufferCharge::operator=(BufferCharge&& other){
+  if(this != &other){
+    resize(0);
+    bytes = other.bytes;
+    other.bytes = 0;
+  }
+  return *this;
+}
+
+/*
+resize-
+Changes how many bytes this connection holds against the global budget. Shrinking always succeeds, growing fails and leaves the charge alone if
+it would take the total over the budget.
+*/
+bool BufferCharge::resize(uint64_t newBytes){
+  if(newBytes <= bytes){
+    bufferBytesCharged.fetch_sub(bytes - newBytes, std::memory_order_relaxed);
+    bytes = newBytes;
+    return true;
+  }
+
+  uint64_t delta = newBytes - bytes;
+  uint64_t cur = bufferBytesCharged.load(std::memory_order_relaxed);
+  do{
+    if(cur + delta > bufferBudget.load(std::memory_order_relaxed)) return false;
+  } while(!bufferBytesCharged.compare_exchange_weak(cur, cur + delta, std::memory_order_relaxed));
+  bytes = newBytes;
+  return true;
+}
+
+uint64_t BufferCharge::getBytes(){
+  return bytes;
+}
+
+/*
+resizeBuffers-
+Sets both buffer limits at once, charging whatever is above the defaults to the global budget. Returns false and changes nothing if the budget
+cannot cover it. The receive window is reopened right away if the buffer grew.
+*/
+bool Tcb::resizeBuffers(uint32_t sendBytes, uint32_t recBytes){
+  uint64_t over = 0;
+  if(sendBytes > DEFAULT_SEND_BUFFER_BYTES) over += sendBytes - DEFAULT_SEND_BUFFER_BYTES;
+  if(recBytes > DEFAULT_REC_BUFFER_BYTES) over += recBytes - DEFAULT_REC_BUFFER_BYTES;
+  if(!bufferCharge.resize(over)) return false;
+
+  sendBufferLimit = sendBytes;
+  recBufferLimit = recBytes;
+  //only an app shrinking its buffer can pull the right edge of the window back
+  uint32_t space = recBufferLimit - min(recBufferLimit, static_cast<uint32_t>(recBuffer.size()));
+  if(rWnd > space) rWnd = space;
+  updateWindowSWSRec(0);
+  return true;
+}
+
+//an app chosen size turns autotuning off for that direction, like SO_SNDBUF/SO_RCVBUF
+bool Tcb::setSendBufferSize(uint32_t bytes){
+  if(bytes < MIN_BUFFER_BYTES) bytes = MIN_BUFFER_BYTES;
+  if(!resizeBuffers(bytes, recBufferLimit)) return false;
+  sendBufferLocked = true;
+  return true;
+}
+
+bool Tcb::setRecBufferSize(uint32_t bytes){
+  if(bytes < MIN_BUFFER_BYTES) bytes = MIN_BUFFER_BYTES;
+  if(!resizeBuffers(sendBufferLimit, bytes)) return false;
+  recBufferLocked = true;
+  return true;
+}
+
+uint32_t Tcb::getSendBufferLimit(){
+  return sendBufferLimit;
+}
+
+uint32_t Tcb::getRecBufferLimit(){
+  return recBufferLimit;
+}
+
+/*
+autotuneSendBuffer-
+Sender side right sizing. Counts bytes acked over one rtt, and if the send buffer is less than twice that(one rtt in flight plus one queued
+behind it) it is grown to match, capped at AUTOTUNE_SEND_BUFFER_MAX. Buffers are never shrunk.
+*/
+void Tcb::autotuneSendBuffer(uint32_t ackedBytes){
+  if(sendBufferLocked) return;
+  ackedThisRtt += ackedBytes;
+  if(latestRtt.count() <= 0) return;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if(now - sendMeasureStart < latestRtt) return;
+
+  uint64_t want = min(2 * static_cast<uint64_t>(ackedThisRtt), static_cast<uint64_t>(AUTOTUNE_SEND_BUFFER_MAX));
+  if(want > sendBufferLimit) resizeBuffers(static_cast<uint32_t>(want), recBufferLimit);
+  ackedThisRtt = 0;
+  sendMeasureStart = now;
+}
+
+/*
+autotuneRecBuffer-
+Receiver side right sizing(linux tcp_rmem style dynamic right sizing). Counts bytes the app read over one rtt. The peer can send no faster than
+the app drains, so twice that is enough to keep the window from closing, capped at AUTOTUNE_REC_BUFFER_MAX. Buffers are never shrunk.
+*/
+void Tcb::autotuneRecBuffer(uint32_t copiedBytes){
+  if(recBufferLocked) return;
+  copiedThisRtt += copiedBytes;
+  if(latestRtt.count() <= 0) return;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if(now - recMeasureStart < latestRtt) return;
+
+  uint64_t want = min(2 * static_cast<uint64_t>(copiedThisRtt), static_cast<uint64_t>(AUTOTUNE_REC_BUFFER_MAX));
+  if(want > recBufferLimit) resizeBuffers(sendBufferLimit, static_cast<uint32_t>(want));
+  copiedThisRtt = 0;
+  recMeasureStart = now;
+}
+
+//the window field of a non syn segment, rWnd scaled down by the negotiated shift
+uint16_t Tcb::advertisedWindow(){
+  return static_cast<uint16_t>(min(rWnd >> rcvWndShift, MAX_UNSCALED_WINDOW));
+}
+
+uint32_t Tcb::getSendWindow(){
+  return sWnd;
+}
+
 void Tcb::updateWindowSWSRec(uint32_t freshRecDataAmount){
   
-  uint32_t reduction = ARRANGED_SEGMENTS_BYTES_MAX - arrangedSegmentsByteCount - rWnd;
-  if(reduction >= min(static_cast<uint32_t>(MAX_BUFFER_SWS_REC_FRACT * ARRANGED_SEGMENTS_BYTES_MAX), getEffectiveSendMss({}))){
-    rWnd = ARRANGED_SEGMENTS_BYTES_MAX - arrangedSegmentsByteCount;
+  uint32_t space = recBufferLimit - min(recBufferLimit, static_cast<uint32_t>(recBuffer.size()));
+  //the window cannot be offered past what the 16 bit field holds at the current shift
+  space = min(space, MAX_UNSCALED_WINDOW << rcvWndShift);
+  uint32_t reduction = (space > rWnd) ? (space - rWnd) : 0;
+  if(reduction >= min(static_cast<uint32_t>(MAX_BUFFER_SWS_REC_FRACT * recBufferLimit), getEffectiveSendMss({}))){
+    rWnd = space;
   }
   else{
     //sws rec algorithm says to keep right edge(rNxt + rWnd) fixed while the above condition is not met. In other words, reduce the advertised window as rNxt increases
-    rWnd -= freshRecDataAmount;
+    rWnd -= min(rWnd, freshRecDataAmount);
   }
 
 }
 
+/*
+appendInOrder-
+Appends the part of a segment from rNxt on to the in order buffer, as far as the receive buffer allows. seqNum must not be past rNxt.
+Returns how many bytes were new.
+*/
+uint32_t Tcb::appendInOrder(uint32_t seqNum, const uint8_t* data, uint32_t len, bool push){
+
+  uint32_t beginUnProc = rNxt - seqNum;
+  if(beginUnProc >= len) return 0;
+
+  uint32_t room = recBufferLimit - min(recBufferLimit, static_cast<uint32_t>(recBuffer.size()));
+  uint32_t taken = min(len - beginUnProc, room);
+  if(!recBuffer.append(data + beginUnProc, taken)) return 0;
+  rNxt += taken;
+  if(push && taken > 0 && (pushMarks.empty() || pushMarks.back() != rNxt)) pushMarks.push_back(rNxt);
+  return taken;
+}
+
 LocalCode Tcb::processData(TcpPacket& tcpP){
 
   uint32_t seqNum = tcpP.getSeqNum();
-  //at this point segment is in the window and any segment with seqNum > rNxt has been put aside for later processing.
-  //This leaves two cases: either seqNum < rNxt but there is unprocessed data in the window or seqNum == rNxt
-  //regardless want to start reading data at the first unprocessed byte and not reread already processed data.
-   
-  
-  if(arrangedSegments.empty() || (seqNum != arrangedSegments.back().getSeqNum())){
-    TcpSegmentSlice newSlice(tcpP.getFlag(TcpPacketFlags::PSH), seqNum, {});
-    arrangedSegments.push_back(newSlice);
+  vector<uint8_t>& payload = tcpP.getPayload();
+  bool push = tcpP.getFlag(TcpPacketFlags::PSH);
+  //at this point segment is in the window. Data starting past rNxt is held until the gap before it fills,
+  //otherwise start reading at the first unprocessed byte and dont reread already processed data.
+
+  if(static_cast<int32_t>(seqNum - rNxt) > 0){
+    //only keep what lies inside the advertised window
+    uint32_t ahead = seqNum - rNxt;
+    if(ahead < rWnd){
+      uint32_t len = min(static_cast<uint32_t>(payload.size()), rWnd - ahead);
+      reassembly.insert(seqNum, payload.data(), len, push);
+    }
+    return LocalCode::SUCCESS;
   }
-  
-  uint32_t beginUnProc = static_cast<uint32_t>(rNxt - seqNum); //CHECK THIS
-  uint32_t index = beginUnProc;
-  while((arrangedSegmentsByteCount < ARRANGED_SEGMENTS_BYTES_MAX) && (index < static_cast<uint32_t>(tcpP.getPayload().size()))){
-    arrangedSegments.back().getData().push(tcpP.getPayload()[index]);
-    index++;
-    arrangedSegmentsByteCount++;
-    rNxt++;
+
+  uint32_t fresh = appendInOrder(seqNum, payload.data(), static_cast<uint32_t>(payload.size()), push);
+
+  //each held range that the new data reaches is now in order too
+  if(fresh > 0){
+    ReassemblyRange r;
+    while(reassembly.popReady(rNxt, r)){
+      fresh += appendInOrder(r.seq, r.data.data(), static_cast<uint32_t>(r.data.size()), r.push);
+    }
   }
   
-  updateWindowSWSRec((index - beginUnProc));
+  updateWindowSWSRec(fresh);
+  if(fresh > 0) scheduleRec(*this);
    
   return LocalCode::SUCCESS;
 }
 
 LocalCode Tcb::checkFin(int socket, TcpPacket& tcpP, bool& fin, Event& e){
   
+  //a fin is only in order once every byte before it has arrived, until then it waits with the out of order data
+  bool finInOrder = false;
+  if(tcpP.getFlag(TcpPacketFlags::FIN)){
+    uint32_t finSeq = tcpP.getSeqNum() + static_cast<uint32_t>(tcpP.getPayload().size());
+    if(finSeq == rNxt) finInOrder = true;
+    else if(static_cast<int32_t>(finSeq - rNxt) > 0) reassembly.holdFin(finSeq);
+  }
+  if(reassembly.finReady(rNxt)) finInOrder = true;
+
   //can only process fin if we didnt fill up the buffer with processing data and have a non zero window left.
   if(rWnd > 0){
-    if(tcpP.getFlag(TcpPacketFlags::FIN)){
+    if(finInOrder){
+      reassembly.clearFin();
       rNxt = rNxt + 1;
-      //TODO: return conn closing to any pending recs and push any waiting segments.
+      //TODO: push any waiting segments.
       notifyApp(parentApp, id, TcpCode::CONNCLOSING, e.getId());
       fin = true;
+      //pending reads may now be completed with partial data, or answered with CONNCLOSING when there is none
+      scheduleRec(*this);
     }
   }
   return LocalCode::SUCCESS;
@@ -1196,7 +2478,7 @@ LocalCode SynRecS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& r
   if(reset){
     b.flushRetransmissions();
     if(b.wasPassiveOpen()){
-      b.setCurrentState(make_unique<ListenS>());
+      b.setCurrentState(ListenS::instance);
     }
     else{
       removeConn(b);
@@ -1212,7 +2494,7 @@ LocalCode SynRecS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& r
   if(tcpP.getFlag(TcpPacketFlags::SYN)){
   
     if(b.wasPassiveOpen()){
-      b.setCurrentState(make_unique<ListenS>());
+      b.setCurrentState(ListenS::instance);
       return LocalCode::SUCCESS;
     }
     //challenge ack recommended by RFC 5961  
@@ -1231,9 +2513,9 @@ LocalCode SynRecS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& r
   uint32_t ackNum = tcpP.getAckNum();
   if(!b.checkUnacceptableAck(ackNum)){
   
-    b.setCurrentState(make_unique<EstabS>());
+    b.setCurrentState(EstabS::instance);
     b.checkChangeRTOTimer();
-    b.updateWindowVars(tcpP.getWindow(), tcpP.getSeqNum(), ackNum);
+    b.updateWindowVars(b.peerWindow(tcpP), tcpP.getSeqNum(), ackNum);
     b.checkSavePacketForEstabProcessing(se);
     return LocalCode::SUCCESS;
     
@@ -1257,30 +2539,82 @@ LocalCode EstabS::establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentE
   s = b.checkUrg(tcpP,se);
   if(s != LocalCode::SUCCESS) return s;
   
-  s = b.processData(tcpP);  
+  bool inOrder = b.arrivesInOrder(tcpP);
+  s = b.processData(tcpP);
   if(s != LocalCode::SUCCESS) return s;
   
   bool fin = false;
   s = b.checkFin(socket,tcpP,fin,se);
   if(s != LocalCode::SUCCESS) return s;
+  b.ackReceivedSegment(tcpP, inOrder);
   
   if(fin){
-      b.setCurrentState(make_unique<CloseWaitS>());
+      b.setCurrentState(CloseWaitS::instance);
       return LocalCode::SUCCESS;
   }
-  
-  bool sent = b.sendCurrentAck(socket);
-  if(!sent) return LocalCode::SOCKET;
-  else return LocalCode::SUCCESS;
+  return LocalCode::SUCCESS;
 
 }
 
+/*
+headerPredicted-
+Van Jacobson header prediction(like linux tcp_rcv_established). Most segments on an established connection are either the next in sequence
+data acking nothing new, or a pure ack moving sUna, with only ACK(and maybe PSH) set, the negotiated options and an unchanged window.
+Data offset, flags and window are checked against the expected header in one compare, then the sequence number. Anything in recovery or with
+out of order data held takes the full path.
+*/
+bool Tcb::headerPredicted(TcpPacket& tcpP){
+
+  const uint8_t pshBit = 1 << static_cast<int>(TcpPacketFlags::PSH);
+  const uint8_t ackBit = 1 << static_cast<int>(TcpPacketFlags::ACK);
+  uint32_t rawWindow = sWnd >> sndWndShift;
+  uint32_t offset = DEFAULT_TCP_DATA_OFFSET + (tsOk ? TIMESTAMP_OPTION_BYTES / 4 : 0);
+  uint32_t expected = (offset << 24) | (ackBit << 16) | rawWindow;
+  uint32_t actual = (static_cast<uint32_t>(tcpP.getDataOffset()) << 24) | (static_cast<uint32_t>(tcpP.getFlags() & ~pshBit) << 16) | tcpP.getWindow();
+  if(actual != expected || (rawWindow << sndWndShift) != sWnd || tcpP.getSeqNum() != rNxt) return false;
+  if(fastRecoveryActive || sackRecoveryActive || !reassembly.empty()) return false;
+
+  uint32_t ackNum = tcpP.getAckNum();
+  uint32_t len = static_cast<uint32_t>(tcpP.getPayload().size());
+  if(len == 0){
+    if(!seqBefore(sUna, ackNum) || seqBefore(sNxt, ackNum)) return false;
+  }
+  else if(ackNum != sUna || len > rWnd) return false;
+
+  //the only option that fits in the expected header is a timestamp, PAWS still applies to it
+  if(tsOk){
+    uint32_t tsVal = 0;
+    uint32_t tsEcr = 0;
+    if(!readTimestamp(tcpP, tsVal, tsEcr) || seqBefore(tsVal, tsRecent)) return false;
+  }
+  return true;
+}
+
+//handles a segment headerPredicted accepted. A pure ack only needs the ack processing, data goes straight onto the receive buffer
+LocalCode Tcb::processPredicted(int socket, TcpPacket& tcpP, RemoteCode& remCode){
+
+  updateTsRecent(tcpP);
+  std::vector<uint8_t>& payload = tcpP.getPayload();
+  if(payload.empty()) return establishedAckLogic(socket, tcpP, remCode);
+
+  uint32_t fresh = appendInOrder(rNxt, payload.data(), static_cast<uint32_t>(payload.size()), tcpP.getFlag(TcpPacketFlags::PSH));
+  updateWindowSWSRec(fresh);
+  if(fresh > 0) scheduleRec(*this);
+  //the window is unchanged, only the record of which segment last set it moves
+  sWl1 = tcpP.getSeqNum();
+  sWl2 = tcpP.getAckNum();
+  ackReceivedSegment(tcpP, true);
+  return LocalCode::SUCCESS;
+}
+
 LocalCode EstabS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode){
 
   LocalCode s;
   IpPacket& ipP = se.getIpPacket();
   TcpPacket& tcpP = ipP.getTcpPacket();
 
+  if(b.headerPredicted(tcpP)) return b.processPredicted(socket, tcpP, remCode);
+
   s = b.checkSequenceNum(socket,tcpP, remCode);
   if(s != LocalCode::SUCCESS) return s;
   if(remCode != RemoteCode::SUCCESS) return LocalCode::SUCCESS;
@@ -1333,21 +2667,20 @@ LocalCode FinWait1S::establishedSegmentLaterProcessing(int socket, Tcb& b, Segme
   s = b.checkUrg(tcpP, se);
   if(s != LocalCode::SUCCESS) return s;
   
+  bool inOrder = b.arrivesInOrder(tcpP);
   s = b.processData(tcpP);
   if(s != LocalCode::SUCCESS) return s;
   
   bool fin = false;
   s = b.checkFin(socket,tcpP,fin,se);
   if(s != LocalCode::SUCCESS) return s;
+  b.ackReceivedSegment(tcpP, inOrder);
   
   if(fin){
-      b.setCurrentState(make_unique<ClosingS>());
+      b.setCurrentState(ClosingS::instance);
       return LocalCode::SUCCESS;
   }
-        
-  bool sent = b.sendCurrentAck(socket);
-  if(!sent) return LocalCode::SOCKET;
-  else return LocalCode::SUCCESS;
+  return LocalCode::SUCCESS;
 }
 
 LocalCode FinWait1S::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode){
@@ -1394,7 +2727,7 @@ LocalCode FinWait1S::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode&
   // if we've reached this part we know ack is set and acceptable
   bool finAcked = b.checkFinFullyAcknowledged(tcpP.getAckNum());
   if(finAcked){
-      b.setCurrentState(make_unique<FinWait2S>());
+      b.setCurrentState(FinWait2S::instance);
       //spec says to further process(urg,data,fin,etc) in finWait2, so use the newly updated state(which is finw2) for the later processing logic
       return b.getCurrentState()->establishedSegmentLaterProcessing(socket, b, se, remCode);
   }
@@ -1412,22 +2745,21 @@ LocalCode FinWait2S::establishedSegmentLaterProcessing(int socket, Tcb& b, Segme
   s = b.checkUrg(tcpP, se);
   if(s != LocalCode::SUCCESS) return s;
   
+  bool inOrder = b.arrivesInOrder(tcpP);
   s = b.processData(tcpP);
   if(s != LocalCode::SUCCESS) return s;
   
   bool fin = false;
   s = b.checkFin(socket,tcpP,fin,se);
   if(s != LocalCode::SUCCESS) return s;
+  b.ackReceivedSegment(tcpP, inOrder);
   
   if(fin){
-      b.setCurrentState(make_unique<TimeWaitS>());
+      b.setCurrentState(TimeWaitS::instance);
       b.startTimeWaitTimer();
       return LocalCode::SUCCESS;
   }
-        
-  bool sent = b.sendCurrentAck(socket);
-  if(!sent) return LocalCode::SOCKET;
-  else return LocalCode::SUCCESS;
+  return LocalCode::SUCCESS;
 
 }
 
@@ -1586,7 +2918,7 @@ LocalCode ClosingS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode&
   // if we've reached this part we know ack is set and acceptable
   if(b.checkFinFullyAcknowledged(tcpP.getAckNum())){
       //fin segment fully acknowledged
-      b.setCurrentState(make_unique<TimeWaitS>());
+      b.setCurrentState(TimeWaitS::instance);
       b.startTimeWaitTimer();
       return LocalCode::SUCCESS;
   }
@@ -1613,9 +2945,6 @@ LocalCode LastAckS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode&
   if(s != LocalCode::SUCCESS) return s;
   if(remCode != RemoteCode::SUCCESS) return LocalCode::SUCCESS;
   
-  //s = checkSaveForLater(b,ipP);
-  //if(s != LocalCode::Success) return s;
-  
   bool reset = false;
   s = b.checkReset(socket,tcpP,true,remCode, reset);
   if(s != LocalCode::SUCCESS) return s;
@@ -1674,12 +3003,18 @@ LocalCode TimeWaitS::establishedSegmentLaterProcessing(int socket, Tcb& b, Segme
 
 }
 
-//TODO: investigate if timestamp RFC 6191 is worth implementing
 LocalCode TimeWaitS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode){
 
   LocalCode s;
   IpPacket& ipP = se.getIpPacket();
   TcpPacket& tcpP = ipP.getTcpPacket();
+
+  //a syn that cannot be an old duplicate ends time wait early and goes to whoever is listening, as if this connection was already gone
+  if(b.acceptsReopeningSyn(tcpP)){
+    LocalCode c = remConnOnly(socket, b);
+    if(c != LocalCode::SUCCESS) return c;
+    return demultiplexSegment(socket, se, remCode);
+  }
   
   s = b.checkSequenceNum(socket,tcpP, remCode);
   if(s != LocalCode::SUCCESS) return s;
@@ -1718,10 +3053,17 @@ LocalCode TimeWaitS::processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode&
 
 bool Tcb::addToSendQueue(SendEv& se){
 
-  int sendQueueSize = sendQueueByteCount + se.getData().size();
-  if(sendQueueSize < SEND_QUEUE_BYTE_MAX){
+  //sent but unacked bytes still sit in the send buffer, so they count against the limit too
+  uint32_t sendQueueSize = sendQueueByteCount + se.getUnsentBytes();
+  bool fits = (sendBuffer.size() + se.getUnsentBytes()) <= sendBufferLimit;
+  //zero copy bytes stay where the app put them, the buffer only records their place in the sequence space
+  if(fits && se.isZeroCopy()) sendBuffer.appendExternal(se.getZeroCopyData(), se.getUnsentBytes());
+  else if(fits) fits = sendBuffer.append(se.getData());
+  if(fits){
       sendQueueByteCount = sendQueueSize;
-      sendQueue.push_back(se);
+      sendQueue.push_back(std::move(se));
+      sendQueue.back().getData().clear();
+      scheduleSend(*this);
       return true;
   }
   else{
@@ -1744,7 +3086,7 @@ LocalCode ListenS::processEvent(int socket, Tcb& b, SendEv& se){
   bool ls = b.sendSyn(socket, cp.first, cp.second, false);
   if(ls){
     b.initSenderState(true);
-    b.setCurrentState(make_unique<SynSentS>());
+    b.setCurrentState(SynSentS::instance);
     b.addToSendQueue(se);
     return LocalCode::SUCCESS;
   }
@@ -1798,6 +3140,7 @@ LocalCode TimeWaitS::processEvent(int socket, Tcb& b, SendEv& oe){
 bool Tcb::addToRecQueue(ReceiveEv& e){
   if((recQueue.size() + 1) < REC_QUEUE_MAX){
       recQueue.push_back(e);
+      scheduleRec(*this);
       return true;
   }
   else{
@@ -1823,14 +3166,26 @@ LocalCode SynRecS::processEvent(int socket, Tcb& b, ReceiveEv& e){
 }
 
 
+//completes queued reads in order for as long as there is enough data for them. After the peer's fin no more data is coming, so reads
+//left with nothing to take are answered with CONNCLOSING rather than waiting forever
 void Tcb::tryProcessReads(){
-  for(auto iter = recQueue.begin(); iter != recQueue.end(); iter++){
-    if(!processRead(*iter,false)){
-      return;
+  while(!recQueue.empty()){
+    ReceiveEv& e = recQueue.front();
+    bool moreData = processRead(e, false);
+    if(e.getBytesRead() == 0){
+      if(!peerFinished()) return;
+      notifyRead(e, TcpCode::CONNCLOSING);
     }
+    recQueue.pop_front();
+    if(!moreData && !peerFinished()) return;
   }
 }
 
+//the peer's fin has been taken, so what is in recBuffer is all the data there will be
+bool Tcb::peerFinished(){
+  return currentState->getNum() >= StateNums::CLOSEWAIT;
+}
+
 bool Tcb::processRead(ReceiveEv& e, bool save){
 
     //sends should only be processed at or after establishment of the connection
@@ -1839,42 +3194,31 @@ bool Tcb::processRead(ReceiveEv& e, bool save){
     }
 
     uint32_t readBytes = 0;
-    //processing the rec event when there isnt enough data available is only allowed in the close wait state(all the data has already communicated from peer, so can only give what we have left).
-    if((arrangedSegmentsByteCount >= e.getAmount()) || currentState->getNum() == StateNums::CLOSEWAIT){
+    //the read needs its low water mark of data available, it then takes as much as it can up to its amount.
+    //processing the rec event when there isnt enough data available is only allowed once the peer's fin is in(all the data has already communicated from peer, so can only give what we have left).
+    if((recBuffer.size() >= e.getLowWater()) || peerFinished()){
     
-      bool evaluateMoreSegments = true;  
-      while(evaluateMoreSegments && !arrangedSegments.empty()){
-        TcpSegmentSlice& slice = arrangedSegments.front();
-        while((slice.getData().size() > 0) && (readBytes < e.getAmount())){
-          e.getBuffer().push_back(slice.getData().front());
-          slice.getData().pop();
-          readBytes++;
-          arrangedSegmentsByteCount--;
-          appNewData++;
-        }
-        
-        if(slice.getData().size() == 0){
-          arrangedSegments.pop_front();
-          if(slice.isPush()){
-            pushSeen = true;
-          }
-        }
-        
-        if(readBytes == e.getAmount()){
-          evaluateMoreSegments = false;
-        }
-        
+      //one copy out of the ring, two if it wraps and is not double mapped
+      readBytes = min(static_cast<uint32_t>(recBuffer.size()), e.getAmount());
+      uint32_t head = recBuffer.getHeadSeq();
+      recBuffer.copyOut(head, readBytes, e.claim(readBytes));
+      recBuffer.release(head + readBytes);
+      appNewData += readBytes;
+      while(!pushMarks.empty() && !seqBefore(head + readBytes, pushMarks.front())){
+        pushSeen = true;
+        pushMarks.pop_front();
       }
       
       if(rUp > appNewData){
         if(!urgentSignaled){
-          notifyApp(parentApp, id, TcpCode::URGENTDATA, e.getId());
+          notifyApp(parentApp, id, TcpCode::URGENTDATA, e.getId(), rUp - appNewData);
           urgentSignaled = true;
         }
       }
       else{
         urgentSignaled = false;
       }
+      if(e.isRegistered() && readBytes > 0) notifyRead(e, TcpCode::RECEIVEDONE);
       
     }
     else{
@@ -1882,8 +3226,9 @@ bool Tcb::processRead(ReceiveEv& e, bool save){
       return false;
     }
     
+    autotuneRecBuffer(readBytes);
     updateWindowSWSRec(0);
-    return !arrangedSegments.empty();
+    return recBuffer.size() > 0;
 }
 
 LocalCode EstabS::processEvent(int socket, Tcb& b, ReceiveEv& e){
@@ -1902,13 +3247,13 @@ LocalCode FinWait2S::processEvent(int socket, Tcb& b, ReceiveEv& e){
 }
 
 bool Tcb::noIncomingData(){
-  return (arrangedSegmentsByteCount == 0);
+  return (recBuffer.size() == 0);
 }
 
 LocalCode CloseWaitS::processEvent(int socket, Tcb& b, ReceiveEv& e){
 
     if(b.noIncomingData()){
-      notifyApp(b.getParApp(), b.getId(), TcpCode::CONNCLOSING, e.getId());
+      b.notifyRead(e, TcpCode::CONNCLOSING);
       return LocalCode::SUCCESS;
     }
     
@@ -1917,31 +3262,36 @@ LocalCode CloseWaitS::processEvent(int socket, Tcb& b, ReceiveEv& e){
 }
 
 LocalCode ClosingS::processEvent(int socket, Tcb& b, ReceiveEv& e){
-  notifyApp(b.getParApp(), b.getId(),TcpCode::CONNCLOSING, e.getId());
+  b.notifyRead(e, TcpCode::CONNCLOSING);
   return LocalCode::SUCCESS;
 }
 
 LocalCode LastAckS::processEvent(int socket, Tcb& b, ReceiveEv& e){
-  notifyApp(b.getParApp(), b.getId(),TcpCode::CONNCLOSING, e.getId());
+  b.notifyRead(e, TcpCode::CONNCLOSING);
   return LocalCode::SUCCESS;
 }
 
 LocalCode TimeWaitS::processEvent(int socket, Tcb& b, ReceiveEv& e){
-  notifyApp(b.getParApp(), b.getId(),TcpCode::CONNCLOSING, e.getId());
+  b.notifyRead(e, TcpCode::CONNCLOSING);
   return LocalCode::SUCCESS;
 }
 
 void Tcb::respondToReads(TcpCode c){
   for(auto iter = recQueue.begin(); iter < recQueue.end(); iter++){
     ReceiveEv& rEv = *iter;
-    notifyApp(parentApp, id, c, rEv.getId());
+    notifyApp(parentApp, id, c, rEv.getId(), rEv.getAmount(), rEv.getUserData());
   }
 }
 
+//a registered read's notifications carry its userData, so the app can tell which of its buffers is free again
+void Tcb::notifyRead(ReceiveEv& e, TcpCode c){
+  notifyApp(parentApp, id, c, e.getId(), e.getBytesRead(), e.getUserData());
+}
+
 void Tcb::respondToSends(TcpCode c){
   for(auto iter = sendQueue.begin(); iter < sendQueue.end(); iter++){
     SendEv& sEv = *iter;
-    notifyApp(parentApp, id, c ,sEv.getId());
+    notifyApp(parentApp, id, c ,sEv.getId(), sEv.getUnsentBytes());
   }
 }
 
@@ -1975,7 +3325,7 @@ LocalCode SynRecS::processEvent(int socket, Tcb& b, CloseEv& e){
 
   if(b.noSendsOutstanding()){
     bool ls = b.sendFin(socket);
-    b.setCurrentState(make_unique<FinWait1S>());
+    b.setCurrentState(FinWait1S::instance);
     if(ls) return LocalCode::SUCCESS;
     else return LocalCode::SOCKET;
   }
@@ -1990,13 +3340,13 @@ LocalCode EstabS::processEvent(int socket, Tcb& b, CloseEv& e){
 
   if(b.noSendsOutstanding()){
     bool ls = b.sendFin(socket);
-    b.setCurrentState(make_unique<FinWait1S>());
+    b.setCurrentState(FinWait1S::instance);
     if(ls) return LocalCode::SUCCESS;
     else return LocalCode::SOCKET;
   }
   else{
     b.registerClose(e);
-    b.setCurrentState(make_unique<FinWait1S>());
+    b.setCurrentState(FinWait1S::instance);
     return LocalCode::SUCCESS;
   }
   
@@ -2016,13 +3366,13 @@ LocalCode CloseWaitS::processEvent(int socket, Tcb& b, CloseEv& e){
 
   if(b.noSendsOutstanding()){
     bool ls = b.sendFin(socket);
-    b.setCurrentState(make_unique<LastAckS>());
+    b.setCurrentState(LastAckS::instance);
     if(ls) return LocalCode::SUCCESS;
     else return LocalCode::SOCKET;
   }
   else{
     b.registerClose(e);
-    b.setCurrentState(make_unique<LastAckS>());
+    b.setCurrentState(LastAckS::instance);
     return LocalCode::SUCCESS;
   }
 
@@ -2115,14 +3465,20 @@ Tcb Tcb::buildTcbFromOpen(bool& success, App* app, int socket, LocalPair lP, Rem
   bool passive = ev.isPassive();
   Tcb newConn(app, lP, rP, passive);
   if(passive){
-    newConn.setCurrentState(make_unique<ListenS>());
+    newConn.setCurrentState(ListenS::instance);
   }
   else{
-    newConn.setCurrentState(make_unique<SynSentS>());
+    newConn.setCurrentState(SynSentS::instance);
   }
   
+  //address is picked first since a sharded port choice depends on the full 4 tuple
+  if(lP.first == UNSPECIFIED){
+    uint32_t chosenAddr = pickDynAddr(); 
+    lP.first = chosenAddr;
+    newConn.lP = lP;
+  }
   if(lP.second == UNSPECIFIED){
-    uint16_t chosenPort = pickDynPort();
+    uint16_t chosenPort = pickDynPort(lP.first, rP);
     if(chosenPort != UNSPECIFIED){
       lP.second = chosenPort;
       newConn.lP = lP;
@@ -2133,11 +3489,6 @@ Tcb Tcb::buildTcbFromOpen(bool& success, App* app, int socket, LocalPair lP, Rem
       return newConn;
     }
   }
-  if(lP.first == UNSPECIFIED){
-    uint32_t chosenAddr = pickDynAddr(); 
-    lP.first = chosenAddr;
-    newConn.lP = lP;
-  }
   
   ConnPair p(lP,rP);
   int id = 0;
@@ -2149,14 +3500,15 @@ Tcb Tcb::buildTcbFromOpen(bool& success, App* app, int socket, LocalPair lP, Rem
     return newConn;
   }
     
+  //the syn arms the rto, and the timer queue finds the connection by id
+  newConn.id = id;
   if(!passive){
     newConn.pickRealIsn();
   
     bool ls = newConn.sendSyn(socket,newConn.lP,newConn.rP,false);
     if(ls){
-      newConn.sUna = newConn.iss;
-      newConn.sNxt = newConn.iss + 1;
-      newConn.setCurrentState(make_unique<SynSentS>());
+      newConn.initSenderState(false);
+      newConn.setCurrentState(SynSentS::instance);
     }
     else{
       reclaimId(id);
@@ -2166,7 +3518,6 @@ Tcb Tcb::buildTcbFromOpen(bool& success, App* app, int socket, LocalPair lP, Rem
 
   }
   
-  newConn.id = id;
   createdId = id;
   success = true;
   return newConn;
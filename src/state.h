@@ -8,23 +8,49 @@
 #include <queue>
 #include <memory>
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include "ring.h"
+#include "seqRing.h"
+#include "reassembly.h"
+#include "congestion.h"
 
 const std::chrono::nanoseconds CLOCK_GRANULARITY{1}; //measured for linux
 const float KARN_BETA = 0.25; //suggested by RFC 6298
 const float KARN_ALPHA = 0.125; //suggested by RFC 6298
 const uint16_t UNSPECIFIED = 0;
 const int KEY_LEN = 16; //128 bits = 16 bytes recommended by RFC 6528
-const int ARRANGED_SEGMENTS_BYTES_MAX = 500;
-const int REC_QUEUE_MAX = 500;
-const int SEND_QUEUE_BYTE_MAX = 500;
+const int REC_QUEUE_MAX = 500; //pending receive calls, not bytes
+const uint32_t DEFAULT_SEND_BUFFER_BYTES = 16384; //starting send buffer, like linux tcp_wmem default
+const uint32_t DEFAULT_REC_BUFFER_BYTES = 65535; //starting receive buffer, the largest window that can be advertised unscaled
+const uint32_t MIN_BUFFER_BYTES = 536; //smallest size an app can ask for, one default mss
+const uint32_t AUTOTUNE_SEND_BUFFER_MAX = 4 * 1024 * 1024; //autotuning never grows past these, like linux tcp_wmem/tcp_rmem max
+const uint32_t AUTOTUNE_REC_BUFFER_MAX = 6 * 1024 * 1024;
+const uint64_t DEFAULT_BUFFER_BUDGET_BYTES = 256 * 1024 * 1024; //bytes all connections together may hold above the defaults
+const uint32_t MAX_UNSCALED_WINDOW = 65535;
+const int MAX_SACK_BLOCKS = 4; //what fits in the 40 bytes of option space(RFC 2018 3)
+const uint8_t TIMESTAMP_OPTION_LEN = 10; //RFC 7323 3.2, kind and length plus the two 4 byte clock values
+const uint32_t TIMESTAMP_OPTION_BYTES = 12; //with the two noops that keep the values word aligned
+const int PAWS_IDLE_DAYS = 24; //RFC 7323 5.5, a ts recent older than this may have wrapped and is not compared against
+const int DUP_THRESH = 3; //RFC 5681/6675
+const int DEL_ACK_MILLISECONDS = 40; //longest an ack for in order data is held back, like linux's minimum delayed ack timeout
+const int QUICKACK_SEGMENTS = 16; //data segments acked straight away at the start of a connection while the peer is in slow start, like linux
+const int WC_DEL_ACK_MILLISECONDS = 200; //RFC 8985 7.2, worst case delayed ack timer the probe timeout allows for
+const double PACING_SS_RATIO = 2.0; //pacing rate as a multiple of cwnd/srtt in slow start, like linux tcp_pacing_ss_ratio
+const double PACING_CA_RATIO = 1.2; //the same in congestion avoidance, like linux tcp_pacing_ca_ratio
+const std::chrono::microseconds PACE_SLACK{20}; //how early a paced segment may leave, about what the driver's timer wakeups resolve
+const std::chrono::milliseconds PACE_OFFLOAD_HORIZON{2}; //with the SO_TXTIME offload opted in, how far ahead of its departure time a segment is handed to the qdisc
+const uint8_t MAX_WINDOW_SHIFT = 14; //RFC 7323 2.3, keeps the scaled window under 2^30 so sequence comparisons stay valid
 const uint16_t DEFAULT_MSS = 536; // maximum segment size
 const float MAX_WINDOW_SWS_SEND_FRACT = 0.5;
 const float MAX_BUFFER_SWS_REC_FRACT = 0.5;
 const int SWS_MILLISECONDS = 300;
 const int MSL_SECONDS = 120; //maximum segment lifetime(arbitrarily set to 2 minutes in tcp spec)
-const int RTO_FLOOR_SECONDS = 1; //required by RFC 6298
+const int RTO_INITIAL_SECONDS = 1; //RFC 6298 2.1
+const int RTO_FLOOR_MILLISECONDS = 200; //default lower bound on a computed rto, like linux TCP_RTO_MIN. RFC 6298 2.4 suggests 1 second
 const int RTO_BAD_HANDSHAKE_INITIAL_SECONDS = 3; // required by RFC 6298 to be the initial timeout in established state if retransmission happens during the handshake under certain conditions
-int RTO_CEILING_SECONDS = -1; //60 optionally specified by RFC 6298, -1 means ceiling is not used. When this is set by user will need to check to make sure it is over the floor
+const int RTO_CEILING_SECONDS = -1; //60 optionally specified by RFC 6298, -1 means ceiling is not used. When this is set by user will need to check to make sure it is over the floor
 
 class Tcb;
 class State;
@@ -42,12 +68,15 @@ enum class TcpCode{
   URGENTDATA = -26,
   PUSHDATA = -27,
   NOCONNEXISTS = -28,
-  CLOSING = -29
+  CLOSING = -29,
+  ZEROCOPYDONE = -30, //a zero copy send was acked in full, its buffer is the app's again
+  RECEIVEDONE = -31 //a read into a registered buffer finished, byteCount bytes of it are filled and it is the app's again
 };
 
 enum class LocalCode{
   SUCCESS = 0,
-  SOCKET = -1
+  SOCKET = -1,
+  WOULDBLOCK = -2
 };
 
 enum class RemoteCode{
@@ -83,16 +112,24 @@ class SegmentEv : public Event{
 class SendEv: public Event{
   public:
     SendEv(std::deque<uint8_t> d, bool urg, bool psh, uint32_t id);
+    SendEv(const uint8_t* zc, uint32_t len, bool urg, bool psh, uint32_t id);
     std::deque<uint8_t>& getData();
+    const uint8_t* getZeroCopyData();
+    bool isZeroCopy();
+    uint32_t getLength();
     bool isUrgent();
     bool isPush();
     void checkSetSeqNum(uint32_t seq);
     bool sendAcked(uint32_t ack);
+    uint32_t getUnsentBytes();
+    void markSent(uint32_t bytes);
   private:
     uint32_t assignedSeqNum = 0;
     bool givenSeqNum = false;
     uint32_t originalDataLen;
+    uint32_t unsentBytes; //once queued on a connection the data itself lives in the connection's send buffer
     std::deque<uint8_t> data;
+    const uint8_t* zeroCopyData = nullptr; //app owned, sent from in place and handed back once acked
     bool urgent;
     bool push;
 };
@@ -100,11 +137,21 @@ class SendEv: public Event{
 class ReceiveEv: public Event{
   public:
     ReceiveEv(uint32_t a, std::vector<uint8_t> buff, uint32_t id);
+    ReceiveEv(uint8_t* dest, uint32_t capacity, uint32_t lowWater, uint64_t userData, uint32_t id);
     uint32_t getAmount();
+    uint32_t getLowWater();
+    uint32_t getBytesRead();
+    bool isRegistered();
+    uint64_t getUserData();
     std::vector<uint8_t>& getBuffer();
+    uint8_t* claim(uint32_t len);
   private:
     uint32_t amount;
+    uint32_t lowWater; //the read completes once this many bytes are available, taking up to amount
+    uint32_t bytesRead = 0;
     std::vector<uint8_t> providedBuffer;
+    uint8_t* registeredBuffer = nullptr; //caller owned, at least amount bytes. Used instead of providedBuffer when set
+    uint64_t userData = 0; //the app's tag for a registered read, handed back with every notification about it
 };
 
 class CloseEv: public Event{
@@ -118,16 +165,48 @@ class AbortEv: public Event{
 };
 
 
+struct AppQueues;
+
+const int NO_CONN_ID = -1; //connection id of notifications that are about the app call itself(ex: no such connection)
+const size_t APP_NOTIF_ENTRIES = 1024;
+
+struct AppNotif{
+  int connId = NO_CONN_ID;
+  uint32_t eventId = 0;
+  TcpCode code = TcpCode::OK;
+  uint32_t byteCount = 0;
+  uint64_t userData = 0; //set on notifications about registered buffer reads, so the app knows which buffer is free again
+};
+
 class App{
   public:
-    App(int ident, std::deque<TcpCode> aNotif, std::unordered_map<int, std::deque<TcpCode> > cNotifs);
+    App(int ident);
+    ~App();
+    App(const App&) = delete;
+    App& operator=(const App&) = delete;
     int getId();
-    std::deque<TcpCode>& getAppNotifs();
-    std::unordered_map<int, std::deque<TcpCode> >& getConnNotifs();
+    bool pushNotif(AppNotif n);
+    bool popNotif(AppNotif& out);
+    size_t popNotifs(std::vector<AppNotif>& out, size_t max);
+    int getNotifFd();
+    void clearNotifSignal();
+    uint64_t getOverflowedNotifs();
+    AppQueues* getQueues();
+    void setQueues(std::unique_ptr<AppQueues> q);
   private:
     int id;
-    std::deque<TcpCode> appNotifs;
-    std::unordered_map<int, std::deque<TcpCode> > connNotifs;
+    //pushed from whichever shard owns the connection, popped by the app thread
+    MpscRing<AppNotif> notifs{APP_NOTIF_ENTRIES};
+    int notifFd = -1; //eventfd, readable while there are notifications the app has not been signaled about yet
+    std::atomic<bool> notifSignaled{false};
+    //notifications that found the ring full, oldest first. Moved into the ring as the app reaps, like io_uring's cq overflow list
+    std::mutex overflowLock;
+    std::deque<AppNotif> overflow;
+    std::atomic<size_t> overflowSize{0};
+    std::atomic<uint64_t> overflowedNotifs{0};
+    std::unique_ptr<AppQueues> queues; //null until the app is attached to the driver rings
+
+    void refillFromOverflow();
 };
 
 #include "driver.h"
@@ -151,11 +230,12 @@ enum class StateNums{
 /*
 Using state pattern to handle state transitions and logic. 
 Each State is friended by Tcb to avoid having a ton of getters/setters for the inner tcb state(ie seq nums) that do nothing and expose all the private data.
+States hold no data of their own, so each one is a single static instance that every Tcb in that state points at. Transitions just swap the pointer.
 */
 class State{
   
   public:
-    State();
+    State() = default;
     virtual ~State();
     virtual LocalCode processEvent(int socket, Tcb& b, OpenEv& oe) = 0;
     virtual LocalCode processEvent(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode) = 0;
@@ -178,6 +258,7 @@ class ListenS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static ListenS instance;
 };
 
 class SynSentS : public State{
@@ -190,6 +271,7 @@ class SynSentS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static SynSentS instance;
 };
 
 class SynRecS : public State{
@@ -202,6 +284,7 @@ class SynRecS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static SynRecS instance;
 };
 
 class EstabS : public State{
@@ -214,6 +297,7 @@ class EstabS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static EstabS instance;
     
 };
 
@@ -227,6 +311,7 @@ class FinWait1S : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static FinWait1S instance;
 };
 
 class FinWait2S : public State{
@@ -239,6 +324,7 @@ class FinWait2S : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static FinWait2S instance;
 };
 
 class CloseWaitS : public State{
@@ -251,6 +337,7 @@ class CloseWaitS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static CloseWaitS instance;
 };
 
 class ClosingS : public State{
@@ -263,6 +350,7 @@ class ClosingS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static ClosingS instance;
 };
 
 class LastAckS : public State{
@@ -275,6 +363,7 @@ class LastAckS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static LastAckS instance;
 };
 
 class TimeWaitS : public State{
@@ -287,26 +376,91 @@ class TimeWaitS : public State{
     LocalCode processEvent(int socket, Tcb& b, AbortEv& se)override;
     LocalCode establishedSegmentLaterProcessing(int socket, Tcb& b, SegmentEv& se, RemoteCode& remCode)override;
     StateNums getNum();
+    static TimeWaitS instance;
+};
+
+
+/*
+BufferCharge-
+A connection's share of the global buffer budget. Only bytes above the default buffer sizes are charged, so ordinary connections never touch the
+budget. The charge is handed back when the connection goes away.
+*/
+class BufferCharge{
+  public:
+    BufferCharge() = default;
+    ~BufferCharge();
+    BufferCharge(const BufferCharge&) = delete;
+    BufferCharge& operator=(const BufferCharge&) = delete;
+    BufferCharge(BufferCharge&& other);
+    BufferCharge& operator=(BufferCharge&& other);
+
+    bool resize(uint64_t bytes);
+    uint64_t getBytes();
+
+  private:
+    uint64_t bytes = 0;
 };
 
+void setBufferBudget(uint64_t bytes);
+uint64_t getBufferBudget();
+uint64_t getBufferBytesCharged();
 
+/*
+Retransmit-
+record of one segment that is waiting to be acknowledged. Only the sequence range and the header bits needed to rebuild the segment are kept,
+the payload stays in the connection's send buffer until sUna moves past it.
+*/
 class Retransmit{
   public:
     Retransmit(TcpPacket& p);
     void incrementRetransmit();
     bool isKarnSuitable();
-    TcpPacket getPacket();
+    uint32_t getSeq();
+    uint32_t getSegLen();
+    uint32_t getDataLen();
+    bool getFlag(TcpPacketFlags flag);
+    uint16_t getUrgentPointer();
     std::chrono::time_point<std::chrono::steady_clock> getTimestamp();
     bool updateAck(uint32_t ack);
+    bool isSacked();
+    void setSacked(bool s);
+    bool isHoleRetransmitted();
+    void setHoleRetransmitted(bool h);
+    void stampDelivery(uint64_t delivered, std::chrono::steady_clock::time_point deliveredTime, std::chrono::steady_clock::time_point firstSentTime, bool appLimited);
+    uint64_t getDelivered();
+    std::chrono::steady_clock::time_point getDeliveredTime();
+    std::chrono::steady_clock::time_point getFirstSentTime();
+    std::chrono::steady_clock::time_point getLastSendTimestamp();
+    bool isAppLimited();
+    bool isRackLost();
+    void setRackLost(bool l);
   private:
-    TcpPacket packet;
+    uint32_t seq;
+    uint32_t segLen; //sequence space covered, counts syn and fin
+    uint32_t dataLen;
+    bool syn;
+    bool fin;
+    bool ack;
+    bool urg;
+    bool psh;
+    uint16_t urgentPointer;
     int numRetransmits = 0;
     std::chrono::time_point<std::chrono::steady_clock> originalSendTimestamp;
     // represents the the highest ack received that satisifies at least some of this segment
     //protects against multiple of the same ack num being seen as acknowledging new data when the segment is not fully acknowledged and removed from the retransmit queue
     uint32_t furthestAck;
     bool acked = false;
-}
+    //sack scoreboard(RFC 6675)
+    bool sacked = false; //the peer holds this whole segment out of order
+    bool holeRetransmitted = false; //already resent during the current sack recovery
+    //delivery rate sampling, the connection's delivery counters as they stood when this segment was last sent
+    uint64_t delivered = 0;
+    std::chrono::steady_clock::time_point deliveredTime;
+    std::chrono::steady_clock::time_point firstSentTime;
+    std::chrono::steady_clock::time_point lastSendTimestamp;
+    bool appLimited = false;
+    bool rackLost = false; //RFC 8985, a segment sent later than this one was delivered more than a reordering window ago
+};
 
 class Tcb{
 
@@ -345,10 +499,19 @@ class Tcb{
     bool swsTimerStopped();
     void stopSwsTimer();
     void resetSwsTimer();
+    bool markPacedQueued();
+    void clearPacedQueued();
+    bool markTimerQueued(std::chrono::steady_clock::time_point deadline);
+    bool timerQueuedFor(std::chrono::steady_clock::time_point deadline);
+    void clearTimerQueued();
+    double pacingRate();
+    void setPacing(bool on);
+    std::chrono::steady_clock::time_point getNextPacedSend();
       
-    void setCurrentState(std::unique_ptr<State> s);
+    void setCurrentState(State& s);
   
     void checkAndSetPeerMSS(TcpPacket& tcpP);
+    uint32_t peerWindow(TcpPacket& tcpP);
     
     bool checkSecurity(IpPacket& p);
     bool verifyRecWindow(TcpPacket& p);
@@ -358,18 +521,39 @@ class Tcb{
     LocalCode checkSyn(int socket, TcpPacket& tcpP, RemoteCode& remCode);
     LocalCode checkAck(int socket, TcpPacket& tcpP, RemoteCode& remCode);
     LocalCode establishedAckLogic(int socket, TcpPacket& tcpP, RemoteCode& remCode);
+    bool headerPredicted(TcpPacket& tcpP);
+    LocalCode processPredicted(int socket, TcpPacket& tcpP, RemoteCode& remCode);
     LocalCode checkUrg(TcpPacket& tcpP, Event& e);
     LocalCode processData(TcpPacket& tcpP);
+    uint32_t appendInOrder(uint32_t seqNum, const uint8_t* data, uint32_t len, bool push);
     LocalCode checkFin(int socket, TcpPacket& tcpP, bool& fin, Event& e);
     
     bool sendDataPacket(int socket, TcpPacket& p);
+    TcpPacket buildSyn(LocalPair lp, RemotePair rp, bool sendAck);
+    TcpPacket rebuildSegment(Retransmit& r);
+    TcpOption buildTimestampOption();
     bool sendCurrentAck(int socket);
     bool sendFin(int socket);
     bool sendSyn(int socket, LocalPair lp, RemotePair rp, bool sendAck);
     bool rtoExpireCallback(int socket);
+    bool probeTimeoutCallback(int socket);
+    bool reorderTimeoutCallback(int socket);
     
     bool addToSendQueue(SendEv& se);
     bool addToRecQueue(ReceiveEv& e);
+    
+    bool markSendReady();
+    bool markRecReady();
+    void clearSendReady();
+    void clearRecReady();
+    bool markAckPending();
+    bool ackPendingNow();
+    bool flushPendingAck(int socket);
+    void ackReceivedSegment(TcpPacket& tcpP, bool inOrder);
+    bool arrivesInOrder(TcpPacket& tcpP);
+    bool delAckTimerExpired();
+    bool delAckTimeoutCallback(int socket);
+    void setDelayedAck(std::chrono::milliseconds interval);
 
     void tryProcessReads();
     bool processRead(ReceiveEv& es, bool save);
@@ -387,6 +571,8 @@ class Tcb{
     bool noIncomingData();
     
     void respondToReads(TcpCode c);
+    void notifyRead(ReceiveEv& e, TcpCode c);
+    bool peerFinished();
     void respondToSends(TcpCode c);
     
     bool noSendsOutstanding();
@@ -401,9 +587,30 @@ class Tcb{
     void startTimeWaitTimer();
     
     bool noRetransmitsOutstanding();
-    void addToRetransmissions(TcpPacket p);
+    void addToRetransmissions(TcpPacket& p);
     void flushRetransmissions();
     void takeKarnSamplesAndRemoveFullyAckedRetransmits(uint32_t ack);
+    bool updateSackScoreboard(TcpPacket& tcpP);
+    void resetSackScoreboard();
+    LocalCode sackRecovery(int socket);
+    uint8_t addSackOption(std::vector<TcpOption>& options);
+    uint8_t addTimestampOption(std::vector<TcpOption>& options);
+    static bool readTimestamp(TcpPacket& tcpP, uint32_t& tsVal, uint32_t& tsEcr);
+    uint32_t timestampNow();
+    bool checkPaws(TcpPacket& tcpP);
+    void updateTsRecent(TcpPacket& tcpP);
+    void noteEchoedTimestamp(TcpPacket& tcpP);
+    bool acceptsReopeningSyn(TcpPacket& tcpP);
+    bool timestampsOk();
+    uint32_t getTsRecent();
+    bool inSackRecovery();
+    bool isDuplicateAck(TcpPacket& tcpP);
+    LocalCode duplicateAck(int socket);
+    LocalCode fastRecoveryAck(int socket, uint32_t ackNum, uint32_t ackedBytes);
+    bool resendFirstUnacked(int socket);
+    bool inFastRecovery();
+    bool rackDetectLoss(std::chrono::steady_clock::time_point now);
+    void armProbeTimer();
 
     void okAcknowledgedSends(uint32_t ack);
 
@@ -411,13 +618,45 @@ class Tcb{
     LocalCode tryProcessSavedPreEstabPackets(int socket, RemoteCode& remCode, bool cache);
 
     bool rtoTimerExpired();
+    bool probeTimerExpired();
+    bool reorderTimerExpired();
     void checkChangeRTOTimer();
     
+    bool nextTimerDeadline(std::chrono::steady_clock::time_point& deadline);
+
+    bool setSendBufferSize(uint32_t bytes);
+    bool setRecBufferSize(uint32_t bytes);
+    uint32_t getSendBufferLimit();
+    uint32_t getRecBufferLimit();
+    uint16_t advertisedWindow();
+    uint32_t getSendWindow();
+
+    void setCongestionAlgo(CongestionAlgo algo);
+    CongestionControl& congestionControl();
+    uint32_t usableSendWindow();
+    uint64_t getDelivered();
+    RateSample takeRateSample();
+
+    void setRtoFloor(std::chrono::milliseconds floor);
+    std::chrono::microseconds getRto();
+    std::chrono::microseconds getSrtt();
+    
   private:
   
     void updateWindowSWSRec(uint32_t freshRecDataAmount);
+    bool resizeBuffers(uint32_t sendBytes, uint32_t recBytes);
+    void autotuneSendBuffer(uint32_t ackedBytes);
+    void autotuneRecBuffer(uint32_t copiedBytes);
+    uint8_t myWindowShift();
+    void stampDelivery(Retransmit& r);
+    void markDelivered(Retransmit& r, std::chrono::steady_clock::time_point now);
+    bool pacingHold();
+    std::chrono::steady_clock::time_point advancePacing(uint32_t bytes);
+    void ackCarried();
+    void rackUpdate(Retransmit& r, std::chrono::steady_clock::time_point now);
+    std::chrono::duration<double> rackReoWnd();
   
-    int id = 0;
+    int id = NO_CONN_ID; //until the driver hands out one
     App* parentApp;
     
     //all multi-byte fields are guaranteed to be in host order.
@@ -427,7 +666,7 @@ class Tcb{
     //packets that were received in a pre-estab state that contained other control besides syn/ack or data that needs to be looked at once estab state has been reached
     std::vector<SegmentEv> preEstabSaved;
 
-    std::vector<Retransmit> retransmissions;
+    std::deque<Retransmit> retransmissions; //in sequence order, records never overlap
     
     uint32_t sUna = 0; // first seq num of data that has not been acknowledged by my peer.
     uint32_t sNxt = 0; // first seq num of data that has not been sent by me.
@@ -439,7 +678,7 @@ class Tcb{
     uint32_t sWl2 = 0; //ack number used for last peer window update 
 
     uint32_t rNxt = 0; // first seq num of data I have not received from my peer.
-    uint32_t rWnd = 0; // window advertised by me to my peer. how many bytes i can hold in buffer.
+    uint32_t rWnd = DEFAULT_REC_BUFFER_BYTES; // window advertised by me to my peer. how many bytes i can hold in buffer.
     uint32_t rUp = 0; //start sequence number of urgent data in my buffer
     uint32_t irs = 0; // initial sequence number chosen by peer for their data.
     
@@ -453,20 +692,110 @@ class Tcb{
     //16 bits to match ip packet 16 bit length field.
     uint16_t peerMss = DEFAULT_MSS;
     uint16_t myMss = DEFAULT_MSS;
+
+    //window scaling(RFC 7323). Both shifts stay 0 unless both syns carried the option
+    bool windowScaling = false;
+    uint8_t sndWndShift = 0; //applied to windows the peer advertises
+    uint8_t rcvWndShift = 0; //applied to windows i advertise
+    int offeredWndShift = -1; //fixed the first time it is needed so every syn i send carries the same shift
+
+    //selective acknowledgment(RFC 2018/6675)
+    bool sackOk = false; //both syns carried sack permitted
+    bool sackRecoveryActive = false;
+    uint32_t recoveryPoint = 0; //sNxt when recovery started, recovery ends once it is acked
+
+    //timestamps(RFC 7323). Like sack, only sent once both syns carried the option
+    bool tsOk = false;
+    uint32_t tsRecent = 0; //peer timestamp echoed back on everything i send
+    std::chrono::steady_clock::time_point tsRecentStamped; //when tsRecent was last set, for PAWS's idle check
+    uint32_t lastAckSent = 0; //ack field of the last segment i sent, decides which segments may update tsRecent
+    uint32_t tsOffset = 0; //random per connection so the raw clock is not shared across connections
+    bool echoRttValid = false; //the ack being processed echoed a timestamp, so a sample is available even for retransmitted segments
+    std::chrono::duration<double> echoRtt{0};
+
+    //fast retransmit and NewReno fast recovery(RFC 5681/6582), used when sack was not negotiated
+    int dupAcks = 0;
+    bool fastRecoveryActive = false;
+    uint32_t recoveryInflation = 0; //added on top of cwnd while in fast recovery, one segment per duplicate ack
+
+    //RACK-TLP(RFC 8985), used when sack was negotiated. The rack fields describe the most recently sent segment known to be delivered
+    bool rackValid = false;
+    std::chrono::steady_clock::time_point rackXmitTs;
+    uint32_t rackEndSeq = 0;
+    std::chrono::duration<double> rackRtt{0};
+    std::chrono::duration<double> rackMinRtt{0};
+    uint32_t rackFack = 0; //highest end sequence delivered
+    bool rackReorderingSeen = false;
+    std::chrono::steady_clock::time_point reorderTimerExpire;
+    bool reorderTimerRunning = false;
+    std::chrono::steady_clock::time_point probeTimerExpire;
+    bool probeTimerRunning = false;
+    bool tlpOutstanding = false; //a probe was sent and not yet acked
+    bool tlpIsRetrans = false;
+    uint32_t tlpEndSeq = 0;
+
+    CongestionAlgo congestionAlgo = DEFAULT_CONGESTION_ALGO;
+    std::unique_ptr<CongestionControl> congestion; //created on first use, once the mss is known
+
+    //delivery rate estimation(draft-cheng-iccrg-delivery-rate-estimation)
+    uint64_t delivered = 0; //bytes the peer is known to hold, cumulatively acked or sacked
+    std::chrono::steady_clock::time_point deliveredTime;
+    std::chrono::steady_clock::time_point firstSentTime; //send time of the segment the current sample interval starts at
+    uint64_t appLimitedUntil = 0; //nonzero while data sent when the app had nothing queued is in flight
+    bool rateCandidate = false; //an ack delivered something since the last sample was taken
+    RateSample pendingRate;
+    std::chrono::duration<double> pendingSendElapsed{0};
+    std::chrono::steady_clock::time_point pendingPriorTime; //deliveredTime when the sample segment was sent
         
-    std::deque<TcpSegmentSlice> arrangedSegments;
-    int arrangedSegmentsByteCount = 0;
+    SeqRing recBuffer; //in order data the app has not read, starting at appNewData
+    std::deque<uint32_t> pushMarks; //sequence numbers just past each pushed segment still in recBuffer. Urgent data is tracked by rUp
+    ReassemblyQueue reassembly; //in window data that arrived ahead of rNxt
     
     std::deque<ReceiveEv> recQueue;
     
     bool nagle = false;
     std::vector<SendEv> unacknowledgedSends; //send events whose data has been sent but not acknowledged fully
     std::deque<SendEv> sendQueue;//send events with data left that needs to be sent
-    int sendQueueByteCount = 0;
+    uint32_t sendQueueByteCount = 0;
+    SeqRing sendBuffer; //bytes of the queued sends, indexed by sequence number
+
+    //buffer sizing. Limits start at the defaults and grow with the measured bandwidth delay product unless the app has set them itself
+    uint32_t sendBufferLimit = DEFAULT_SEND_BUFFER_BYTES; //unacked plus unsent bytes
+    uint32_t recBufferLimit = DEFAULT_REC_BUFFER_BYTES; //received bytes the app has not read yet
+    bool sendBufferLocked = false;
+    bool recBufferLocked = false;
+    BufferCharge bufferCharge;
+    std::chrono::duration<double> latestRtt{0}; //most recent karn sample, zero until there is one
+    uint32_t ackedThisRtt = 0;
+    std::chrono::steady_clock::time_point sendMeasureStart;
+    uint32_t copiedThisRtt = 0;
+    std::chrono::steady_clock::time_point recMeasureStart;
+    
+    //whether this connection is currently linked into the driver's send/receive ready lists
+    bool sendReady = false;
+    bool recReady = false;
+
+    //delayed acks(RFC 1122 4.2.3.2, RFC 9293 3.8.6.3)
+    bool ackPending = false; //an ack is owed right away, it goes out once the driver's current receive batch is done
+    std::chrono::milliseconds delAckInterval{DEL_ACK_MILLISECONDS}; //0 acks every segment straight away
+    std::chrono::steady_clock::time_point delAckTimerExpire;
+    bool delAckTimerRunning = false;
+    uint32_t rcvBytesUnacked = 0; //in order data accepted since the last ack went out
+    uint32_t rcvMssSeen = 0; //largest payload the peer has sent, what counts as a full sized segment
+    int quickAcks = 0;
 
     std::chrono::milliseconds swsTimerInterval{SWS_MILLISECONDS};
     std::chrono::steady_clock::time_point swsTimerExpire;
     bool swsTimerRunning = false;
+
+    //pacing. nextPacedSend is the earliest departure time of the next segment, a connection held back by it waits in the driver's paced queue
+    bool pacing = true;
+    std::chrono::steady_clock::time_point nextPacedSend;
+    bool pacedQueued = false;
+
+    //the deadline of this connection's entry in the driver's timer queue, if it has one. Older entries that dont match are skipped
+    bool timerQueued = false;
+    std::chrono::steady_clock::time_point timerQueuedAt;
     
     std::chrono::seconds timeWaitInterval{MSL_SECONDS};
     std::chrono::steady_clock::time_point timeWaitTimerExpire;
@@ -474,15 +803,16 @@ class Tcb{
         
     std::deque<CloseEv> closeQueue;
     
-    std::unique_ptr<State> currentState;
+    State* currentState = nullptr; //one of the static state instances, never owned
     bool passiveOpen = false;
 
     //karn algorithm stuff
-    uint32_t srtt = 0; //smoothed rout trip time
-    uint32_t rttvar = 0; // round trip time variation
+    std::chrono::microseconds srtt{0}; //smoothed rout trip time
+    std::chrono::microseconds rttvar{0}; // round trip time variation
     bool firstKarnMeasurement = true;
     //retransmission timeout
-    std::chrono::seconds rtoInterval{RTO_FLOOR_SECONDS}; 
+    std::chrono::microseconds rtoInterval{std::chrono::seconds(RTO_INITIAL_SECONDS)};
+    std::chrono::milliseconds rtoFloor{RTO_FLOOR_MILLISECONDS};
     std::chrono::steady_clock::time_point rtoTimerExpire;
     bool rtoTimerRunning = false;
     bool handshakeHadRetransmission = false;
@@ -4,11 +4,6 @@
 
 using namespace std;
 
-TcpSegmentSlice::TcpSegmentSlice(bool p, uint32_t seq, std::queue<uint8_t> data): push(p), seqNum(seq), unreadData(data) {}
-bool TcpSegmentSlice::isPush(){ return push; }
-uint32_t TcpSegmentSlice::getSeqNum(){ return seqNum; }
-std::queue<uint8_t>& TcpSegmentSlice::getData() { return unreadData; }
-
 TcpOption::TcpOption(uint8_t k, uint8_t len, bool hasLen, vector<uint8_t> d): kind(k), length(len), hasLength(hasLen), data(d){
   size = calcSize();
 };
@@ -168,6 +163,11 @@ bool TcpPacket::getFlag(TcpPacketFlags flag){
   return static_cast<bool>((flags >> static_cast<int>(flag)) & 0x1);
 }
 
+//the whole flags byte, for checks that look at several flags at once
+uint8_t TcpPacket::getFlags(){
+  return flags;
+}
+
 TcpPacket& TcpPacket::setFlag(TcpPacketFlags flag){
   flags = flags | (0x1 << static_cast<int>(flag));
   return *this;
@@ -16,7 +16,11 @@ enum class TcpPacketCode{
 enum class TcpOptionKind{
   END = 0,
   NOOP = 1,
-  MSS = 2
+  MSS = 2,
+  WSCALE = 3,
+  SACK_PERMITTED = 4,
+  SACK = 5,
+  TIMESTAMP = 8
 };
 
 class TcpOption{
@@ -52,19 +56,6 @@ enum class TcpPacketFlags{
   CWR = 7
 };
 
-class TcpSegmentSlice{
-  public:
-    TcpSegmentSlice() = default;
-    TcpSegmentSlice(bool p, uint32_t seq, std::queue<uint8_t> data);
-    bool isPush();
-    uint32_t getSeqNum();
-    std::queue<uint8_t>& getData();
-  private:
-    bool push;
-    uint32_t seqNum;
-    std::queue<uint8_t> unreadData;
-};
-
 class TcpPacket{
 
   public:
@@ -96,6 +87,7 @@ class TcpPacket{
     uint32_t getSegSize();
     uint16_t calcSize();
     bool getFlag(TcpPacketFlags flag);
+    uint8_t getFlags();
     uint8_t getDataOffset();
     uint8_t getReserved();
     uint16_t getChecksum();
@@ -110,7 +102,7 @@ class TcpPacket{
     uint16_t destPort = 0;
     uint32_t seqNum = 0;
     uint32_t ackNum = 0;
-    uint8_t dataOffReserved = 0;
+    uint8_t dataOffReserved = DEFAULT_TCP_DATA_OFFSET << 4; //header with no options until options are added
     uint8_t flags = 0;
     uint16_t window = 0;
     uint16_t checksum = 0;
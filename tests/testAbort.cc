@@ -23,22 +23,23 @@ void testSimpleNotif(){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true,TEST_CONN_ID);
-    b.setCurrentState(make_unique<T>());
+    b.setCurrentState(T::instance);
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b);
     
     LocalCode lc = abort(&a, TEST_SOCKET, lp, rp);
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     ASSERT_NE(connections.find(cPair) , connections.end());
     Tcb& bNew = connections[cPair];
     State* testS = bNew.getCurrentState();
     EXPECT_TRUE(dynamic_cast<T*>(testS));
     
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 1) 
@@ -53,15 +54,15 @@ void testNormalAbort(){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<T>());
+    b.setCurrentState(T::instance);
     ReceiveEv e(1,{},TEST_EVENT_ID);
     SendEv sE({},false,false,TEST_EVENT_ID);
     TcpPacket p;
     ASSERT_TRUE(b.addToSendQueue(sE));
     ASSERT_TRUE(b.addToRecQueue(e));
-    ASSERT_TRUE(b.addToRetransmit(p));
+    b.addToRetransmissions(p);
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b);
     
@@ -70,11 +71,12 @@ void testNormalAbort(){
     LocalCode lc = abort(&a, TEST_SOCKET, lp, rp);
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     EXPECT_TRUE(connections.size() < 1);
     EXPECT_TRUE(bNew.noRetransmitsOutstanding());
   
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 2) 
@@ -90,15 +92,16 @@ TEST_F(AbortTestFixture, AbortNoConn){
 
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     LocalCode lc = abort(&a, TEST_SOCKET, lp, rp);
     
     ASSERT_EQ(lc , LocalCode::SUCCESS);
   
     EXPECT_TRUE(connections.size() < 1);
-    EXPECT_TRUE(a.getAppNotifs().size() > 0);
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
-    EXPECT_EQ(a.getAppNotifs()[0] , TcpCode::NOCONNEXISTS);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() > 0);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
+    EXPECT_EQ(notifs.appNotifs[0] , TcpCode::NOCONNEXISTS);
     
 }
 
@@ -107,9 +110,9 @@ TEST_F(AbortTestFixture, AbortListen){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<ListenS>());
+    b.setCurrentState(ListenS::instance);
     ReceiveEv e(1,{},TEST_EVENT_ID);
     ASSERT_TRUE(b.addToRecQueue(e));
     ConnPair cPair(lp,rp);
@@ -118,10 +121,11 @@ TEST_F(AbortTestFixture, AbortListen){
     LocalCode lc = abort(&a, TEST_SOCKET, lp, rp);
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     EXPECT_TRUE(connections.size() < 1);
   
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 1) 
@@ -135,9 +139,9 @@ TEST_F(AbortTestFixture, AbortSynSent){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true,TEST_CONN_ID);
-    b.setCurrentState(make_unique<SynSentS>());
+    b.setCurrentState(SynSentS::instance);
     ReceiveEv e(1,{},TEST_EVENT_ID);
     SendEv sE({},false,false,TEST_EVENT_ID);
     ASSERT_TRUE(b.addToRecQueue(e));
@@ -148,10 +152,11 @@ TEST_F(AbortTestFixture, AbortSynSent){
     LocalCode lc = abort(&a, TEST_SOCKET, lp, rp);
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     EXPECT_TRUE(connections.size() < 1);
   
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 2) 
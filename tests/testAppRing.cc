@@ -0,0 +1,266 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "../src/shard.h"
+#include "testingUtil.h"
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+namespace appRingTests{
+
+class AppRingTestFixture : public testing::Test{
+
+  void TearDown() override{
+    connections.clear();
+    idMap.clear();
+    interceptedPackets.clear();
+  }
+};
+
+TEST(SpscRingTest, WrapsAndReportsFull){
+
+    SpscRing<int> r(3);
+    ASSERT_EQ(r.capacity(), 4);
+    for(int round = 0; round < 3; round++){
+      for(int i = 0; i < 4; i++){
+        ASSERT_TRUE(r.push(i));
+      }
+      ASSERT_TRUE(r.full());
+      ASSERT_FALSE(r.push(4));
+      int val = -1;
+      for(int i = 0; i < 4; i++){
+        ASSERT_TRUE(r.pop(val));
+        ASSERT_EQ(val, i);
+      }
+      ASSERT_FALSE(r.pop(val));
+      ASSERT_TRUE(r.empty());
+    }
+
+}
+
+TEST(SpscRingTest, CrossThreadOrder){
+
+    const int total = 100000;
+    SpscRing<int> r(64);
+    thread producer([&r](){
+      for(int i = 0; i < total; i++){
+        while(!r.push(i)){
+          this_thread::yield();
+        }
+      }
+    });
+    int expected = 0;
+    while(expected < total){
+      int val = -1;
+      if(!r.pop(val)){
+        this_thread::yield();
+        continue;
+      }
+      ASSERT_EQ(val, expected);
+      expected++;
+    }
+    producer.join();
+
+}
+
+TEST_F(AppRingTestFixture, CloseCompletesThroughRings){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    ConnPair cPair(lp,rp);
+    connections[cPair] = move(b);
+    idMap[TEST_CONN_ID] = cPair;
+
+    ASSERT_TRUE(attachApp(&a));
+    ASSERT_TRUE(submitClose(&a, 7, lp, rp));
+    AppCompletion comp;
+    ASSERT_FALSE(reapCompletion(&a, comp));
+
+    ASSERT_EQ(drainAppRings(TEST_SOCKET), LocalCode::SUCCESS);
+    ASSERT_TRUE(reapCompletion(&a, comp));
+    EXPECT_EQ(comp.userData, 7);
+    EXPECT_EQ(comp.type, ShardCommandType::CLOSE);
+    EXPECT_EQ(comp.code, LocalCode::SUCCESS);
+    ASSERT_FALSE(reapCompletion(&a, comp));
+    EXPECT_TRUE(dynamic_cast<FinWait1S*>(connections[cPair].getCurrentState()));
+    detachApp(&a);
+
+}
+
+TEST_F(AppRingTestFixture, FullCompletionRingHoldsSubmissions){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    ASSERT_TRUE(attachApp(&a));
+    int submitted = 0;
+    while(submitReceive(&a, submitted, 1, lp, rp)){
+      submitted++;
+    }
+    ASSERT_EQ(submitted, APP_RING_ENTRIES);
+
+    //nothing is reaped, so the driver can only complete one ring's worth no matter how often it drains
+    for(size_t i = 0; i < APP_RING_ENTRIES; i++){
+      ASSERT_EQ(drainAppRings(TEST_SOCKET), LocalCode::SUCCESS);
+    }
+    ASSERT_TRUE(submitReceive(&a, submitted, 1, lp, rp));
+    ASSERT_EQ(drainAppRings(TEST_SOCKET), LocalCode::SUCCESS);
+
+    AppCompletion comp;
+    for(int i = 0; i <= submitted; i++){
+      ASSERT_EQ(drainAppRings(TEST_SOCKET), LocalCode::SUCCESS);
+      ASSERT_TRUE(reapCompletion(&a, comp));
+      ASSERT_EQ(comp.userData, i);
+      ASSERT_EQ(comp.type, ShardCommandType::RECEIVE);
+    }
+    ASSERT_FALSE(reapCompletion(&a, comp));
+    //no connection exists, each receive is reported to the app
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_EQ(notifs.appNotifs.size(), submitted + 1);
+    detachApp(&a);
+
+}
+
+TEST_F(AppRingTestFixture, DetachedAppIsNotDrained){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    App other(TEST_APP_ID + 1);
+    ASSERT_TRUE(attachApp(&a));
+    ASSERT_TRUE(attachApp(&other));
+    ASSERT_EQ(drainAppRings(TEST_SOCKET), LocalCode::SUCCESS);
+
+    //the driver's copy of the attached list has to notice the detach even though nothing else changed
+    ASSERT_TRUE(submitClose(&a, 1, lp, rp));
+    ASSERT_TRUE(submitClose(&other, 2, lp, rp));
+    detachApp(&a);
+    ASSERT_EQ(drainAppRings(TEST_SOCKET), LocalCode::SUCCESS);
+    AppCompletion comp;
+    EXPECT_FALSE(reapCompletion(&a, comp));
+    ASSERT_TRUE(reapCompletion(&other, comp));
+    EXPECT_EQ(comp.userData, 2);
+    detachApp(&other);
+
+}
+
+TEST(AppNotifTest, EventFdSignalsOncePerDrain){
+
+    App a(TEST_APP_ID);
+    ASSERT_GE(a.getNotifFd(), 0);
+    notifyApp(&a, TEST_CONN_ID, TcpCode::URGENTDATA, TEST_EVENT_ID, 10);
+    notifyApp(&a, TEST_CONN_ID, TcpCode::CONNCLOSING, TEST_EVENT_ID + 1);
+
+    //both pushes landed before the app looked, so the eventfd was only written once
+    uint64_t count = 0;
+    ASSERT_EQ(read(a.getNotifFd(), &count, sizeof(count)), sizeof(count));
+    EXPECT_EQ(count, 1);
+    a.clearNotifSignal();
+
+    vector<AppNotif> batch;
+    ASSERT_EQ(a.popNotifs(batch, 8), 2);
+    EXPECT_EQ(batch[0].connId, TEST_CONN_ID);
+    EXPECT_EQ(batch[0].eventId, TEST_EVENT_ID);
+    EXPECT_EQ(batch[0].code, TcpCode::URGENTDATA);
+    EXPECT_EQ(batch[0].byteCount, 10);
+    EXPECT_EQ(batch[1].eventId, TEST_EVENT_ID + 1);
+    EXPECT_EQ(batch[1].code, TcpCode::CONNCLOSING);
+
+    //nothing new, the eventfd stays quiet
+    ASSERT_LT(read(a.getNotifFd(), &count, sizeof(count)), 0);
+    notifyApp(&a, TEST_CONN_ID, TcpCode::OK, TEST_EVENT_ID);
+    ASSERT_EQ(read(a.getNotifFd(), &count, sizeof(count)), sizeof(count));
+
+}
+
+TEST(AppNotifTest, FullRingOverflowsInOrder){
+
+    App a(TEST_APP_ID);
+    for(size_t i = 0; i < APP_NOTIF_ENTRIES + 3; i++){
+      notifyApp(&a, TEST_CONN_ID, TcpCode::OK, i);
+    }
+    EXPECT_EQ(a.getOverflowedNotifs(), 3);
+    AppNotif n;
+    ASSERT_TRUE(a.popNotif(n));
+    ASSERT_EQ(n.eventId, 0);
+
+    //reaping made room, but newer notifications still queue behind the parked ones
+    notifyApp(&a, TEST_CONN_ID, TcpCode::ZEROCOPYDONE, APP_NOTIF_ENTRIES + 3);
+    for(size_t i = 1; i < APP_NOTIF_ENTRIES + 4; i++){
+      ASSERT_TRUE(a.popNotif(n));
+      ASSERT_EQ(n.eventId, i);
+    }
+    EXPECT_EQ(n.code, TcpCode::ZEROCOPYDONE);
+    ASSERT_FALSE(a.popNotif(n));
+
+}
+
+TEST(AppNotifTest, BatchPopDrainsOverflow){
+
+    App a(TEST_APP_ID);
+    const size_t total = APP_NOTIF_ENTRIES + 10;
+    for(size_t i = 0; i < total; i++){
+      notifyApp(&a, TEST_CONN_ID, TcpCode::OK, i);
+    }
+    EXPECT_EQ(a.getOverflowedNotifs(), 10);
+
+    vector<AppNotif> batch;
+    while(a.popNotifs(batch, 100) > 0){}
+    ASSERT_EQ(batch.size(), total);
+    for(size_t i = 0; i < total; i++){
+      ASSERT_EQ(batch[i].eventId, i);
+    }
+
+    //once drained, new notifications go straight to the ring again
+    notifyApp(&a, TEST_CONN_ID, TcpCode::ZEROCOPYDONE, total);
+    batch.clear();
+    ASSERT_EQ(a.popNotifs(batch, 100), 1);
+    EXPECT_EQ(batch[0].eventId, total);
+    EXPECT_EQ(batch[0].code, TcpCode::ZEROCOPYDONE);
+    EXPECT_EQ(a.getOverflowedNotifs(), 10);
+
+}
+
+TEST(AppNotifTest, ConcurrentProducersKeepOrder){
+
+    const int producers = 4;
+    const int perProducer = 5000;
+    App a(TEST_APP_ID);
+    vector<thread> threads;
+    for(int p = 0; p < producers; p++){
+      threads.push_back(thread([&a, p](){
+        for(int i = 0; i < perProducer; i++){
+          while(!a.pushNotif(AppNotif{p, (uint32_t)i, TcpCode::OK, 0})){
+            this_thread::yield();
+          }
+        }
+      }));
+    }
+
+    vector<uint32_t> nextExpected(producers, 0);
+    int received = 0;
+    while(received < producers * perProducer){
+      AppNotif n;
+      if(!a.popNotif(n)){
+        this_thread::yield();
+        continue;
+      }
+      ASSERT_EQ(n.eventId, nextExpected[n.connId]);
+      nextExpected[n.connId]++;
+      received++;
+    }
+    for(auto iter = threads.begin(); iter != threads.end(); iter++){
+      iter->join();
+    }
+
+}
+
+}
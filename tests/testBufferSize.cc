@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "testingUtil.h"
+#include <thread>
+#include <chrono>
+
+using namespace std;
+
+namespace bufferSizeTests{
+
+class BufferSizeFixture : public testing::Test{
+
+  void TearDown() override{
+    interceptedPackets.clear();
+    setBufferBudget(DEFAULT_BUFFER_BUDGET_BYTES);
+  }
+};
+
+//sends and acks numBytes with an rtt of a few milliseconds so autotuning has a sample and a full measurement window
+void sendAndAckAfterDelay(Tcb& b, uint32_t numBytes){
+  std::deque<uint8_t> msg(numBytes);
+  SendEv e(msg, false, false, TEST_EVENT_ID);
+  ASSERT_TRUE(b.addToSendQueue(e));
+  ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, numBytes, numBytes) == LocalCode::SUCCESS);
+  this_thread::sleep_for(chrono::milliseconds(2));
+  //initSenderState(false) leaves sUna at 0 and data starts at 1
+  b.takeKarnSamplesAndRemoveFullyAckedRetransmits(numBytes + 1);
+  b.advanceUna(numBytes + 1);
+}
+
+TEST_F(BufferSizeFixture, DefaultLimits){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    EXPECT_EQ(b.getSendBufferLimit(), DEFAULT_SEND_BUFFER_BYTES);
+    EXPECT_EQ(b.getRecBufferLimit(), DEFAULT_REC_BUFFER_BYTES);
+    EXPECT_EQ(b.advertisedWindow(), DEFAULT_REC_BUFFER_BYTES);
+
+    //far more than the old fixed 500 byte queue
+    std::deque<uint8_t> msg(DEFAULT_SEND_BUFFER_BYTES);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    EXPECT_TRUE(b.addToSendQueue(e));
+}
+
+TEST_F(BufferSizeFixture, AppSendSizeLimitsQueue){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    ASSERT_TRUE(b.setSendBufferSize(1000));
+
+    std::deque<uint8_t> first(900);
+    SendEv e(first, false, false, TEST_EVENT_ID);
+    EXPECT_TRUE(b.addToSendQueue(e));
+
+    std::deque<uint8_t> second(200);
+    SendEv eSecond(second, false, false, TEST_EVENT_ID);
+    EXPECT_FALSE(b.addToSendQueue(eSecond));
+    SplitNotifs notifs = splitNotifs(a);
+    ASSERT_EQ(notifs.connNotifs[TEST_CONN_ID].size(), 1);
+    EXPECT_EQ(notifs.connNotifs[TEST_CONN_ID].front(), TcpCode::RESOURCES);
+}
+
+TEST_F(BufferSizeFixture, AppRecSizeLimitsBufferedData){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    ASSERT_TRUE(b.setRecBufferSize(MIN_BUFFER_BYTES));
+
+    std::vector<uint8_t> payload(MIN_BUFFER_BYTES + 100);
+    TcpPacket p;
+    p.setPayload(payload);
+    b.processData(p);
+    EXPECT_EQ(b.advertisedWindow(), 0);
+
+    ReceiveEv e(MIN_BUFFER_BYTES + 100, {}, TEST_EVENT_ID);
+    b.setCurrentState(CloseWaitS::instance);
+    b.processRead(e, false);
+    EXPECT_EQ(e.getBuffer().size(), MIN_BUFFER_BYTES);
+    EXPECT_EQ(b.advertisedWindow(), MIN_BUFFER_BYTES);
+}
+
+TEST_F(BufferSizeFixture, LargeRecBufferAdvertisesUnscaledMax){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    ASSERT_TRUE(b.setRecBufferSize(4 * DEFAULT_REC_BUFFER_BYTES));
+    EXPECT_EQ(b.advertisedWindow(), MAX_UNSCALED_WINDOW);
+}
+
+TEST_F(BufferSizeFixture, SendAutotuneGrowsWithAckedBytes){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.initSenderState(false);
+
+    uint32_t numBytes = 12000;
+    sendAndAckAfterDelay(b, numBytes);
+    EXPECT_EQ(b.getSendBufferLimit(), 2 * (numBytes + 1));
+    EXPECT_EQ(getBufferBytesCharged(), 2 * (numBytes + 1) - DEFAULT_SEND_BUFFER_BYTES);
+}
+
+TEST_F(BufferSizeFixture, AppSizeDisablesAutotune){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    ASSERT_TRUE(b.setSendBufferSize(DEFAULT_SEND_BUFFER_BYTES));
+    b.initSenderState(false);
+
+    sendAndAckAfterDelay(b, 12000);
+    EXPECT_EQ(b.getSendBufferLimit(), DEFAULT_SEND_BUFFER_BYTES);
+}
+
+TEST_F(BufferSizeFixture, AutotuneBoundedByBudget){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    setBufferBudget(1000);
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.initSenderState(false);
+
+    sendAndAckAfterDelay(b, 12000);
+    EXPECT_EQ(b.getSendBufferLimit(), DEFAULT_SEND_BUFFER_BYTES);
+    EXPECT_EQ(getBufferBytesCharged(), 0);
+    EXPECT_FALSE(b.setRecBufferSize(DEFAULT_REC_BUFFER_BYTES + 1001));
+    EXPECT_EQ(b.getRecBufferLimit(), DEFAULT_REC_BUFFER_BYTES);
+}
+
+TEST_F(BufferSizeFixture, ChargeRefundedWhenConnGoes){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    {
+      Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+      ASSERT_TRUE(b.setRecBufferSize(DEFAULT_REC_BUFFER_BYTES + 1000));
+      EXPECT_EQ(getBufferBytesCharged(), 1000);
+      Tcb moved(std::move(b));
+      EXPECT_EQ(getBufferBytesCharged(), 1000);
+    }
+    EXPECT_EQ(getBufferBytesCharged(), 0);
+}
+
+}
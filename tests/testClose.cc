@@ -25,22 +25,23 @@ void testSimpleNotif(){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<T>());
+    b.setCurrentState(T::instance);
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b);
     
     LocalCode lc = close(&a, TEST_SOCKET, lp, rp);
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     ASSERT_NE(connections.find(cPair) , connections.end());
     Tcb& bNew = connections[cPair];
     State* testS = bNew.getCurrentState();
     EXPECT_TRUE(dynamic_cast<T*>(testS));
     
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 1) 
@@ -55,9 +56,9 @@ void testEmptySendQ(){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<before>());
+    b.setCurrentState(before::instance);
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b);
     
@@ -66,8 +67,9 @@ void testEmptySendQ(){
     
     ASSERT_NE(connections.find(cPair) , connections.end());
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
     
     Tcb& bNew = connections[cPair];
     
@@ -82,9 +84,9 @@ void testNonEmptySendQ(){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<before>());
+    b.setCurrentState(before::instance);
     SendEv e({},false,false,TEST_EVENT_ID);
     ASSERT_TRUE(b.addToSendQueue(e));
     ConnPair cPair(lp,rp);
@@ -95,8 +97,9 @@ void testNonEmptySendQ(){
     
     ASSERT_NE(connections.find(cPair) , connections.end());
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
     
     Tcb& bNew = connections[cPair];
     
@@ -111,15 +114,16 @@ TEST_F(CloseTestFixture, CloseNoConn){
 
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     LocalCode lc = close(&a, TEST_SOCKET, lp, rp);
     
     ASSERT_EQ(lc , LocalCode::SUCCESS);
   
     EXPECT_TRUE(connections.size() < 1);
-    EXPECT_TRUE(a.getAppNotifs().size() > 0);
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
-    EXPECT_EQ(a.getAppNotifs()[0] , TcpCode::NOCONNEXISTS);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() > 0);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
+    EXPECT_EQ(notifs.appNotifs[0] , TcpCode::NOCONNEXISTS);
     
 }
 
@@ -128,9 +132,9 @@ TEST_F(CloseTestFixture, CloseListen){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<ListenS>());
+    b.setCurrentState(ListenS::instance);
     ReceiveEv e(1, {}, TEST_EVENT_ID);
     
     ASSERT_TRUE(b.addToRecQueue(e));
@@ -140,10 +144,11 @@ TEST_F(CloseTestFixture, CloseListen){
     LocalCode lc = close(&a, TEST_SOCKET, lp, rp);
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     EXPECT_TRUE(connections.size() < 1);
   
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 1) 
@@ -157,9 +162,9 @@ TEST_F(CloseTestFixture, CloseSynSent){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<SynSentS>());
+    b.setCurrentState(SynSentS::instance);
     ReceiveEv e(1, {}, TEST_EVENT_ID);
     SendEv sE({},false,false,TEST_EVENT_ID);
     ASSERT_TRUE(b.addToRecQueue(e));
@@ -170,10 +175,11 @@ TEST_F(CloseTestFixture, CloseSynSent){
     LocalCode lc = close(&a, TEST_SOCKET, lp, rp);
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     EXPECT_TRUE(connections.size() < 1);
   
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 2) 
@@ -0,0 +1,344 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "../src/congestion.h"
+#include "../src/network.h"
+#include "testingUtil.h"
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace congestionTests{
+
+const uint32_t TEST_MSS = 1000;
+
+class CongestionFixture : public InterceptFixture{};
+
+AckEvent ackOf(uint32_t bytes, uint32_t inFlight, chrono::steady_clock::time_point now){
+  AckEvent ev;
+  ev.ackedBytes = bytes;
+  ev.inFlight = inFlight;
+  ev.now = now;
+  return ev;
+}
+
+/*
+runPath-
+A small impairment model of one bottleneck: each round trip the sender puts cwnd bytes on the path(or less if its pacing rate says so), which
+can hold bdp bytes in flight plus queue bytes in the bottleneck buffer. Anything queued adds to the rtt, anything past the buffer is dropped.
+Every lossEvery rounds a segment is lost at random as well. A lossy round is reported as one loss event and its acks arrive in recovery.
+Returns the bytes delivered over all rounds.
+*/
+uint64_t runPath(CongestionControl& cc, uint32_t bdp, uint32_t queue, int rounds, chrono::milliseconds rtt, int lossEvery){
+
+  chrono::steady_clock::time_point now{};
+  double bottleneckRate = bdp / chrono::duration<double>(rtt).count();
+  uint64_t delivered = 0;
+  uint64_t useful = 0;
+  for(int i = 0; i < rounds; i++){
+    uint32_t sent = cc.getCwnd();
+    double pace = cc.getPacingRate();
+    if(pace > 0) sent = max(TEST_MSS, min(sent, static_cast<uint32_t>(pace * chrono::duration<double>(rtt).count())));
+    cc.onSend(sent, 0, now);
+
+    uint32_t arrived = min(sent, bdp + queue);
+    uint32_t standing = (arrived > bdp) ? (arrived - bdp) : 0;
+    chrono::duration<double> roundRtt = rtt * (1.0 + static_cast<double>(standing) / bdp);
+    useful += min(arrived, bdp);
+    now += chrono::duration_cast<chrono::steady_clock::duration>(roundRtt);
+    cc.onRttSample(roundRtt);
+
+    bool lost = (sent > bdp + queue) || (lossEvery > 0 && (i % lossEvery) == (lossEvery - 1));
+    if(lost){
+      cc.onLoss(sent, now);
+      arrived -= min(arrived, TEST_MSS);
+    }
+    uint64_t roundStart = delivered;
+    for(uint32_t acked = 0; acked < arrived; acked += TEST_MSS){
+      delivered += TEST_MSS;
+      AckEvent ev = ackOf(TEST_MSS, sent - acked, now);
+      ev.inRecovery = lost;
+      ev.delivered = delivered;
+      ev.rate.priorDelivered = roundStart;
+      ev.rate.deliveryRate = min(sent / roundRtt.count(), bottleneckRate);
+      cc.onAck(ev);
+    }
+  }
+  return useful;
+}
+
+TEST_F(CongestionFixture, NewRenoSlowStartThenAvoidance){
+
+    unique_ptr<CongestionControl> cc = makeCongestionControl(CongestionAlgo::NEWRENO, TEST_MSS);
+    chrono::steady_clock::time_point now{};
+    EXPECT_EQ(cc->getCwnd(), 10 * TEST_MSS);
+
+    cc->onAck(ackOf(TEST_MSS, 10 * TEST_MSS, now));
+    EXPECT_EQ(cc->getCwnd(), 11 * TEST_MSS);
+
+    cc->onLoss(20 * TEST_MSS, now);
+    EXPECT_EQ(cc->getSsthresh(), 10 * TEST_MSS);
+    EXPECT_EQ(cc->getCwnd(), 10 * TEST_MSS);
+
+    //a whole window acked adds one segment
+    for(int i = 0; i < 9; i++) cc->onAck(ackOf(TEST_MSS, 10 * TEST_MSS, now));
+    EXPECT_EQ(cc->getCwnd(), 10 * TEST_MSS);
+    cc->onAck(ackOf(TEST_MSS, 10 * TEST_MSS, now));
+    EXPECT_EQ(cc->getCwnd(), 11 * TEST_MSS);
+
+    AckEvent recovering = ackOf(TEST_MSS, 10 * TEST_MSS, now);
+    recovering.inRecovery = true;
+    cc->onAck(recovering);
+    EXPECT_EQ(cc->getCwnd(), 11 * TEST_MSS);
+}
+
+TEST_F(CongestionFixture, RtoDropsToOneSegment){
+
+    unique_ptr<CongestionControl> cc = makeCongestionControl(CongestionAlgo::NEWRENO, TEST_MSS);
+    cc->onRto(20 * TEST_MSS, true);
+    EXPECT_EQ(cc->getCwnd(), TEST_MSS);
+    EXPECT_EQ(cc->getSsthresh(), 10 * TEST_MSS);
+    //backed off timeouts for the same data leave ssthresh alone
+    cc->onRto(TEST_MSS, false);
+    EXPECT_EQ(cc->getSsthresh(), 10 * TEST_MSS);
+}
+
+TEST_F(CongestionFixture, CubicCutsByBeta){
+
+    unique_ptr<CongestionControl> cc = makeCongestionControl(CongestionAlgo::CUBIC, TEST_MSS);
+    cc->init(TEST_MSS, 100 * TEST_MSS, 50 * TEST_MSS);
+    cc->onLoss(100 * TEST_MSS, chrono::steady_clock::time_point{});
+    EXPECT_EQ(cc->getCwnd(), 70 * TEST_MSS);
+    EXPECT_EQ(cc->getSsthresh(), 70 * TEST_MSS);
+}
+
+TEST_F(CongestionFixture, CubicFillsLongFatPathFasterThanReno){
+
+    uint32_t bdp = 2000 * TEST_MSS;
+    uint32_t queue = 200 * TEST_MSS;
+    int rounds = 400;
+    unique_ptr<CongestionControl> reno = makeCongestionControl(CongestionAlgo::NEWRENO, TEST_MSS);
+    unique_ptr<CongestionControl> cubic = makeCongestionControl(CongestionAlgo::CUBIC, TEST_MSS);
+    uint64_t renoBytes = runPath(*reno, bdp, queue, rounds, chrono::milliseconds(100), 0);
+    uint64_t cubicBytes = runPath(*cubic, bdp, queue, rounds, chrono::milliseconds(100), 0);
+
+    uint64_t best = static_cast<uint64_t>(bdp) * rounds;
+    EXPECT_GT(cubicBytes, renoBytes);
+    EXPECT_GT(cubicBytes, best * 8 / 10);
+}
+
+TEST_F(CongestionFixture, BbrFiltersTrackPath){
+
+    BbrCongestion cc;
+    cc.init(TEST_MSS, 0, UINT32_MAX);
+    chrono::steady_clock::time_point now{};
+
+    cc.onRttSample(chrono::milliseconds(50));
+    AckEvent ev = ackOf(TEST_MSS, TEST_MSS, now);
+    ev.delivered = TEST_MSS;
+    ev.rate.deliveryRate = 1e6;
+    cc.onAck(ev);
+    EXPECT_DOUBLE_EQ(cc.getMaxBw(), 1e6);
+    EXPECT_EQ(cc.getMinRtt(), chrono::duration<double>(0.05));
+
+    //a higher rtt does not replace the min, a lower rate stays behind the max until it ages out
+    cc.onRttSample(chrono::milliseconds(80));
+    for(uint64_t round = 1; round <= BBR_BW_WINDOW_ROUNDS; round++){
+      ev.rate.priorDelivered = ev.delivered;
+      ev.delivered += TEST_MSS;
+      ev.rate.deliveryRate = 5e5;
+      cc.onAck(ev);
+    }
+    EXPECT_EQ(cc.getMinRtt(), chrono::duration<double>(0.05));
+    EXPECT_DOUBLE_EQ(cc.getMaxBw(), 5e5);
+
+    //app limited samples only count when they raise the estimate
+    ev.rate.deliveryRate = 1e5;
+    ev.rate.appLimited = true;
+    cc.onAck(ev);
+    EXPECT_DOUBLE_EQ(cc.getMaxBw(), 5e5);
+}
+
+TEST_F(CongestionFixture, BbrLeavesStartupAndPacesAtBandwidth){
+
+    uint32_t bdp = 100 * TEST_MSS;
+    BbrCongestion cc;
+    cc.init(TEST_MSS, 0, UINT32_MAX);
+    EXPECT_GT(cc.getPacingRate(), 0);
+    runPath(cc, bdp, 10 * TEST_MSS, 40, chrono::milliseconds(100), 0);
+
+    EXPECT_EQ(cc.getMode(), BbrMode::PROBE_BW);
+    double bottleneckRate = bdp / 0.1;
+    EXPECT_NEAR(cc.getMaxBw(), bottleneckRate, bottleneckRate * 0.01);
+    EXPECT_LE(cc.getPacingRate(), 1.25 * cc.getMaxBw() + 1);
+    EXPECT_LE(cc.getCwnd(), 2 * bdp + TEST_MSS);
+}
+
+TEST_F(CongestionFixture, BbrHoldsRateOnLossyShallowPath){
+
+    uint32_t bdp = 2000 * TEST_MSS;
+    uint32_t queue = 20 * TEST_MSS;
+    int rounds = 400;
+    int lossEvery = 20;
+    unique_ptr<CongestionControl> cubic = makeCongestionControl(CongestionAlgo::CUBIC, TEST_MSS);
+    unique_ptr<CongestionControl> bbr = makeCongestionControl(CongestionAlgo::BBR, TEST_MSS);
+    uint64_t cubicBytes = runPath(*cubic, bdp, queue, rounds, chrono::milliseconds(100), lossEvery);
+    uint64_t bbrBytes = runPath(*bbr, bdp, queue, rounds, chrono::milliseconds(100), lossEvery);
+
+    uint64_t best = static_cast<uint64_t>(bdp) * rounds;
+    EXPECT_GT(bbrBytes, 2 * cubicBytes);
+    EXPECT_GT(bbrBytes, best * 7 / 10);
+}
+
+TEST_F(CongestionFixture, TrySendStopsAtCwnd){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    b.initSenderState(false);
+    b.updateWindowVars(MAX_UNSCALED_WINDOW, 0, 0);
+
+    std::deque<uint8_t> msg(DEFAULT_SEND_BUFFER_BYTES);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.trySend(TEST_SOCKET) == LocalCode::SUCCESS);
+
+    uint32_t sentBytes = 0;
+    for(TcpPacket& p : interceptedPackets) sentBytes += p.getPayload().size();
+    //the unacked syn sequence number counts as in flight here, so the last full segment does not fit
+    EXPECT_LE(sentBytes, b.congestionControl().getCwnd());
+    EXPECT_GE(sentBytes + b.getEffectiveSendMss({}), b.congestionControl().getCwnd());
+    EXPECT_LT(sentBytes, DEFAULT_SEND_BUFFER_BYTES);
+}
+
+TEST_F(CongestionFixture, SwitchingAlgoKeepsWindow){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.congestionControl().onRto(20 * DEFAULT_MSS, true);
+    uint32_t cwnd = b.congestionControl().getCwnd();
+    uint32_t ssthresh = b.congestionControl().getSsthresh();
+
+    CongestionAlgo other = (DEFAULT_CONGESTION_ALGO == CongestionAlgo::CUBIC) ? CongestionAlgo::NEWRENO : CongestionAlgo::CUBIC;
+    b.setCongestionAlgo(other);
+    EXPECT_EQ(b.congestionControl().getAlgo(), other);
+    EXPECT_EQ(b.congestionControl().getCwnd(), cwnd);
+    EXPECT_EQ(b.congestionControl().getSsthresh(), ssthresh);
+}
+
+TEST_F(CongestionFixture, AcksSampleDeliveryRate){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    uint32_t segSize = 100;
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    b.initSenderState(false);
+
+    std::deque<uint8_t> msg(segSize * 3);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    for(int i = 0; i < 3; i++){
+      ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize, segSize) == LocalCode::SUCCESS);
+    }
+    this_thread::sleep_for(chrono::milliseconds(5));
+
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = peerAck(1 + 2 * segSize);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(b.getDelivered(), 2 * segSize);
+
+    //the sample is taken once per ack, nothing new was delivered since
+    RateSample rs = b.takeRateSample();
+    EXPECT_EQ(rs.deliveryRate, 0);
+}
+
+TEST_F(CongestionFixture, PacingHoldsBackSends){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    b.initSenderState(false);
+    b.updateWindowVars(MAX_UNSCALED_WINDOW, 0, 0);
+    b.setCongestionAlgo(CongestionAlgo::BBR);
+
+    //a slow path, one segment takes well over a tenth of a second at the startup rate
+    AckEvent ev = ackOf(0, 0, chrono::steady_clock::now());
+    ev.rate.deliveryRate = 1000;
+    b.congestionControl().onAck(ev);
+
+    std::deque<uint8_t> msg(4 * b.getEffectiveSendMss({}));
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.trySend(TEST_SOCKET) == LocalCode::SUCCESS);
+    EXPECT_EQ(interceptedPackets.size(), 1);
+    EXPECT_GT(b.getNextPacedSend(), chrono::steady_clock::now());
+}
+
+TEST(TxTimeOffloadTest, OnlyWhenOptedIn){
+
+    //the kernel accepts SO_TXTIME whatever the qdisc, so that alone must not turn the offload on
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(sock, 0);
+    EXPECT_FALSE(enableTxTime(sock));
+    EXPECT_FALSE(txTimeEnabled());
+
+    setTxTimeOffload(true);
+    if(enableTxTime(sock)) EXPECT_TRUE(txTimeEnabled());
+    setTxTimeOffload(false);
+    EXPECT_FALSE(txTimeEnabled());
+    ::close(sock);
+}
+
+TEST_F(CongestionFixture, WindowControllerIsPacedFromSrtt){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    b.initSenderState(false);
+    b.updateWindowVars(MAX_UNSCALED_WINDOW, 0, 0);
+    b.setCongestionAlgo(CongestionAlgo::CUBIC);
+    EXPECT_EQ(b.pacingRate(), 0);
+
+    //one slow rtt sample, then a full window is spread over it instead of leaving in one burst
+    uint32_t mss = b.getEffectiveSendMss({});
+    std::deque<uint8_t> first(mss);
+    SendEv e(first, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.trySend(TEST_SOCKET) == LocalCode::SUCCESS);
+    this_thread::sleep_for(chrono::milliseconds(50));
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = peerAck(1 + mss);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    ASSERT_GT(b.pacingRate(), 0);
+    interceptedPackets.clear();
+
+    std::deque<uint8_t> burst(4 * mss);
+    SendEv e2(burst, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e2));
+    ASSERT_TRUE(b.trySend(TEST_SOCKET) == LocalCode::SUCCESS);
+    EXPECT_LT(interceptedPackets.size(), 3);
+
+    //with pacing off the rest goes straight away
+    b.setPacing(false);
+    ASSERT_TRUE(b.trySend(TEST_SOCKET) == LocalCode::SUCCESS);
+    EXPECT_EQ(interceptedPackets.size(), 4);
+}
+
+}
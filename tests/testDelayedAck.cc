@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "testingUtil.h"
+#include <thread>
+
+using namespace std;
+
+namespace delayedAckTests{
+
+const uint32_t SEG_SIZE = 100;
+
+class DelayedAckFixture : public InterceptFixture{
+
+  void TearDown() override{
+    InterceptFixture::TearDown();
+    connections.clear();
+    idMap.clear();
+  }
+};
+
+//runs a data segment through the established state's data processing the way a segment that passed the earlier checks would be
+void receive(Tcb& b, uint32_t seq, bool push){
+  IpPacket ip;
+  TcpPacket& p = ip.getTcpPacket();
+  p.setFlag(TcpPacketFlags::ACK).setSeq(seq).setAck(1).setWindow(MAX_UNSCALED_WINDOW).setPayload(vector<uint8_t>(SEG_SIZE));
+  if(push) p.setFlag(TcpPacketFlags::PSH);
+  SegmentEv se(ip, TEST_EVENT_ID);
+  RemoteCode remCode = RemoteCode::SUCCESS;
+  b.getCurrentState()->establishedSegmentLaterProcessing(TEST_SOCKET, b, se, remCode);
+}
+
+//uses up quick ack mode so later segments see the normal delayed ack rules, returns the next in order sequence number
+uint32_t pastQuickAck(Tcb& b){
+  b.setCurrentState(EstabS::instance);
+  b.initReceiverState(TEST_PEER_ISS);
+  b.initSenderState(false);
+  uint32_t seq = TEST_PEER_ISS + 1;
+  for(int i = 0; i < QUICKACK_SEGMENTS; i++){
+    receive(b, seq, false);
+    EXPECT_TRUE(b.ackPendingNow());
+    b.flushPendingAck(TEST_SOCKET);
+    seq += SEG_SIZE;
+  }
+  interceptedPackets.clear();
+  return seq;
+}
+
+TEST_F(DelayedAckFixture, EverySecondSegmentAcked){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    uint32_t seq = pastQuickAck(b);
+
+    receive(b, seq, false);
+    EXPECT_FALSE(b.ackPendingNow());
+    std::chrono::steady_clock::time_point deadline;
+    EXPECT_TRUE(b.nextTimerDeadline(deadline));
+
+    receive(b, seq + SEG_SIZE, false);
+    EXPECT_TRUE(b.ackPendingNow());
+
+    //one ack covers both, and the timer is done with
+    ASSERT_TRUE(b.flushPendingAck(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getAckNum(), seq + 2 * SEG_SIZE);
+    EXPECT_FALSE(b.delAckTimerExpired());
+    EXPECT_FALSE(b.nextTimerDeadline(deadline));
+    ASSERT_TRUE(b.flushPendingAck(TEST_SOCKET));
+    EXPECT_EQ(interceptedPackets.size(), 1);
+}
+
+TEST_F(DelayedAckFixture, OutOfOrderAndPushAckedRightAway){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    uint32_t seq = pastQuickAck(b);
+
+    receive(b, seq + SEG_SIZE, false);
+    EXPECT_TRUE(b.ackPendingNow());
+    ASSERT_TRUE(b.flushPendingAck(TEST_SOCKET));
+
+    //filling the hole is acked at once too
+    receive(b, seq, false);
+    EXPECT_TRUE(b.ackPendingNow());
+    ASSERT_TRUE(b.flushPendingAck(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 2);
+    EXPECT_EQ(interceptedPackets[1].getAckNum(), seq + 2 * SEG_SIZE);
+
+    receive(b, seq + 2 * SEG_SIZE, true);
+    EXPECT_TRUE(b.ackPendingNow());
+}
+
+TEST_F(DelayedAckFixture, TimerSendsHeldAck){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    uint32_t seq = pastQuickAck(b);
+    b.setDelayedAck(chrono::milliseconds(5));
+
+    receive(b, seq, false);
+    EXPECT_FALSE(b.ackPendingNow());
+    EXPECT_FALSE(b.delAckTimerExpired());
+    this_thread::sleep_for(chrono::milliseconds(10));
+    ASSERT_TRUE(b.delAckTimerExpired());
+    ASSERT_TRUE(b.delAckTimeoutCallback(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getAckNum(), seq + SEG_SIZE);
+    EXPECT_FALSE(b.delAckTimerExpired());
+}
+
+TEST_F(DelayedAckFixture, DataCarriesPendingAck){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    uint32_t seq = pastQuickAck(b);
+
+    //a request comes in and the response goes out before the loop iteration ends
+    receive(b, seq, true);
+    ASSERT_TRUE(b.ackPendingNow());
+    std::deque<uint8_t> msg(SEG_SIZE);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    EXPECT_FALSE(b.ackPendingNow());
+
+    ASSERT_TRUE(b.flushPendingAck(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getPayload().size(), SEG_SIZE);
+    EXPECT_EQ(interceptedPackets[0].getAckNum(), seq + SEG_SIZE);
+}
+
+TEST_F(DelayedAckFixture, PureAckIsNotAcked){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    b.initReceiverState(TEST_PEER_ISS);
+    b.initSenderState(false);
+
+    IpPacket ip;
+    ip.getTcpPacket() = peerAck(1);
+    SegmentEv se(ip, TEST_EVENT_ID);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_TRUE(b.getCurrentState()->establishedSegmentLaterProcessing(TEST_SOCKET, b, se, remCode) == LocalCode::SUCCESS);
+    EXPECT_FALSE(b.ackPendingNow());
+    std::chrono::steady_clock::time_point deadline;
+    EXPECT_FALSE(b.nextTimerDeadline(deadline));
+    EXPECT_TRUE(interceptedPackets.empty());
+}
+
+TEST_F(DelayedAckFixture, DriverTimerQueueSendsHeldAck){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    uint32_t seq = pastQuickAck(b);
+    b.setDelayedAck(chrono::milliseconds(5));
+    ConnPair cPair(lp, rp);
+    connections[cPair] = move(b);
+    idMap[TEST_CONN_ID] = cPair;
+
+    //arming the timer is what puts the connection in the driver's timer queue
+    receive(connections[cPair], seq, false);
+    std::chrono::steady_clock::time_point deadline;
+    bool haveDeadline = false;
+    ASSERT_TRUE(serviceTimers(TEST_SOCKET, deadline, haveDeadline) == LocalCode::SUCCESS);
+    ASSERT_TRUE(haveDeadline);
+    EXPECT_TRUE(interceptedPackets.empty());
+
+    this_thread::sleep_for(chrono::milliseconds(10));
+    ASSERT_TRUE(serviceTimers(TEST_SOCKET, deadline, haveDeadline) == LocalCode::SUCCESS);
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getAckNum(), seq + SEG_SIZE);
+    EXPECT_FALSE(connections[cPair].delAckTimerExpired());
+}
+
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "testingUtil.h"
+
+using namespace std;
+
+namespace fastRetransmitTests{
+
+const uint32_t SEG_SIZE = 100;
+
+class FastRetransmitFixture : public InterceptFixture{};
+
+//puts numSegs segments of SEG_SIZE in flight(seq 1 onward) and acks the syn's sequence number so sUna sits at 1
+void sendSegments(Tcb& b, int numSegs){
+  establishWithAck(b);
+
+  std::deque<uint8_t> msg(SEG_SIZE * numSegs);
+  SendEv e(msg, false, false, TEST_EVENT_ID);
+  b.addToSendQueue(e);
+  for(int i = 0; i < numSegs; i++){
+    b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE);
+  }
+  interceptedPackets.clear();
+}
+
+TEST_F(FastRetransmitFixture, ThirdDupAckRetransmits){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    sendSegments(b, 5);
+
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    for(int i = 0; i < DUP_THRESH - 1; i++){
+      TcpPacket dup = peerAck(1);
+      ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, dup, remCode) == LocalCode::SUCCESS);
+    }
+    EXPECT_TRUE(interceptedPackets.empty());
+    EXPECT_FALSE(b.inFastRecovery());
+
+    TcpPacket third = peerAck(1);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, third, remCode) == LocalCode::SUCCESS);
+    EXPECT_TRUE(b.inFastRecovery());
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getSeqNum(), 1);
+    EXPECT_EQ(interceptedPackets[0].getPayload().size(), SEG_SIZE);
+
+    //more duplicates do not resend it again
+    TcpPacket fourth = peerAck(1);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, fourth, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(interceptedPackets.size(), 1);
+
+    TcpPacket full = peerAck(1 + 5 * SEG_SIZE);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, full, remCode) == LocalCode::SUCCESS);
+    EXPECT_FALSE(b.inFastRecovery());
+    EXPECT_TRUE(b.noRetransmitsOutstanding());
+}
+
+TEST_F(FastRetransmitFixture, PartialAckResendsNextHole){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    sendSegments(b, 5);
+
+    //segments at 1 and 201 were lost
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    for(int i = 0; i < DUP_THRESH; i++){
+      TcpPacket dup = peerAck(1);
+      ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, dup, remCode) == LocalCode::SUCCESS);
+    }
+    ASSERT_EQ(interceptedPackets.size(), 1);
+
+    TcpPacket partial = peerAck(1 + 2 * SEG_SIZE);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, partial, remCode) == LocalCode::SUCCESS);
+    EXPECT_TRUE(b.inFastRecovery());
+    ASSERT_EQ(interceptedPackets.size(), 2);
+    EXPECT_EQ(interceptedPackets[1].getSeqNum(), 1 + 2 * SEG_SIZE);
+
+    TcpPacket full = peerAck(1 + 5 * SEG_SIZE);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, full, remCode) == LocalCode::SUCCESS);
+    EXPECT_FALSE(b.inFastRecovery());
+}
+
+TEST_F(FastRetransmitFixture, WindowUpdateIsNotDuplicate){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    sendSegments(b, 5);
+
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    for(int i = 0; i < DUP_THRESH; i++){
+      TcpPacket update = peerAck(1);
+      update.setWindow(MAX_UNSCALED_WINDOW - 1 - i);
+      ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, update, remCode) == LocalCode::SUCCESS);
+    }
+    EXPECT_FALSE(b.inFastRecovery());
+    EXPECT_TRUE(interceptedPackets.empty());
+}
+
+TEST_F(FastRetransmitFixture, LimitedTransmitSendsNewData){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establishWithAck(b);
+
+    //fill the congestion window with more queued behind it
+    uint32_t mss = b.getEffectiveSendMss({});
+    uint32_t cwnd = b.congestionControl().getCwnd();
+    std::deque<uint8_t> msg(cwnd + 4 * mss);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.trySend(TEST_SOCKET) == LocalCode::SUCCESS);
+    ASSERT_LT(b.usableSendWindow(), mss);
+    uint32_t sent = 0;
+    for(TcpPacket& p : interceptedPackets) sent += p.getPayload().size();
+    interceptedPackets.clear();
+
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    for(int i = 1; i < DUP_THRESH; i++){
+      TcpPacket dup = peerAck(1);
+      ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, dup, remCode) == LocalCode::SUCCESS);
+      ASSERT_TRUE(b.trySend(TEST_SOCKET) == LocalCode::SUCCESS);
+      ASSERT_EQ(interceptedPackets.size(), i);
+      EXPECT_EQ(interceptedPackets.back().getSeqNum(), 1 + sent + (i - 1) * mss);
+    }
+    EXPECT_EQ(b.congestionControl().getCwnd(), cwnd);
+}
+
+}
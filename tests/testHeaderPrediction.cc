@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "testingUtil.h"
+
+using namespace std;
+
+namespace headerPredictionTests{
+
+const uint32_t SEG_SIZE = 100;
+
+class HeaderPredictionFixture : public InterceptFixture{};
+
+TEST_F(HeaderPredictionFixture, InSequenceDataIsPredicted){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establishWithAck(b);
+
+    IpPacket ip;
+    TcpPacket& p = ip.getTcpPacket();
+    p = peerAck(1);
+    vector<uint8_t> msg(SEG_SIZE);
+    for(size_t i = 0; i < msg.size(); i++) msg[i] = static_cast<uint8_t>(i);
+    p.setFlag(TcpPacketFlags::PSH).setPayload(msg);
+    ASSERT_TRUE(b.headerPredicted(p));
+
+    SegmentEv se(ip, TEST_EVENT_ID);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_TRUE(b.getCurrentState()->processEvent(TEST_SOCKET, b, se, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(remCode, RemoteCode::SUCCESS);
+
+    //pushed data is acked at once
+    ASSERT_TRUE(b.flushPendingAck(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getAckNum(), TEST_PEER_ISS + 1 + SEG_SIZE);
+
+    ReceiveEv e(SEG_SIZE, {}, TEST_EVENT_ID);
+    b.processRead(e, false);
+    EXPECT_EQ(e.getBuffer(), msg);
+}
+
+TEST_F(HeaderPredictionFixture, PureAckIsPredicted){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establishWithAck(b);
+
+    std::deque<uint8_t> msg(SEG_SIZE);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    ASSERT_FALSE(b.noRetransmitsOutstanding());
+
+    //acking nothing new or more than was sent is left to the full path
+    TcpPacket dup = peerAck(1);
+    EXPECT_FALSE(b.headerPredicted(dup));
+    TcpPacket ahead = peerAck(2 + SEG_SIZE);
+    EXPECT_FALSE(b.headerPredicted(ahead));
+
+    IpPacket ip;
+    ip.getTcpPacket() = peerAck(1 + SEG_SIZE);
+    ASSERT_TRUE(b.headerPredicted(ip.getTcpPacket()));
+    SegmentEv se(ip, TEST_EVENT_ID);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_TRUE(b.getCurrentState()->processEvent(TEST_SOCKET, b, se, remCode) == LocalCode::SUCCESS);
+    EXPECT_TRUE(b.noRetransmitsOutstanding());
+}
+
+TEST_F(HeaderPredictionFixture, UnusualSegmentsTakeFullPath){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establishWithAck(b);
+
+    TcpPacket base = peerAck(1);
+    base.setPayload(vector<uint8_t>(SEG_SIZE));
+    ASSERT_TRUE(b.headerPredicted(base));
+
+    TcpPacket fin = base;
+    fin.setFlag(TcpPacketFlags::FIN);
+    EXPECT_FALSE(b.headerPredicted(fin));
+
+    TcpPacket urg = base;
+    urg.setFlag(TcpPacketFlags::URG);
+    EXPECT_FALSE(b.headerPredicted(urg));
+
+    TcpPacket window = base;
+    window.setWindow(MAX_UNSCALED_WINDOW - 1);
+    EXPECT_FALSE(b.headerPredicted(window));
+
+    TcpPacket outOfOrder = base;
+    outOfOrder.setSeq(TEST_PEER_ISS + 1 + SEG_SIZE);
+    EXPECT_FALSE(b.headerPredicted(outOfOrder));
+}
+
+}
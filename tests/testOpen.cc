@@ -8,9 +8,10 @@ using namespace std;
 
 namespace openTests{
 
-class OpenTestFixture : public testing::Test{
+class OpenTestFixture : public InterceptFixture{
 
   void TearDown() override{
+    InterceptFixture::TearDown();
     connections.clear();
     idMap.clear();
   }
@@ -22,9 +23,9 @@ void testSimpleNotif(){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<T>());
+    b.setCurrentState(T::instance);
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b);
     
@@ -33,13 +34,14 @@ void testSimpleNotif(){
   
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
     ASSERT_NE(connections.find(cPair) , connections.end());
     Tcb& bNew = connections[cPair];
     State* testS = bNew.getCurrentState();
     EXPECT_TRUE(dynamic_cast<T*>(testS));
     
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() == 1) 
@@ -53,7 +55,7 @@ TEST_F(OpenTestFixture, OpenCompleteActive){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     int createdId = 0;
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     LocalCode lc = open(&a, TEST_SOCKET, false, lp, rp, createdId);
     
     ASSERT_EQ(lc , LocalCode::SUCCESS);
@@ -63,8 +65,9 @@ TEST_F(OpenTestFixture, OpenCompleteActive){
     ASSERT_NE(connections.find(cPair) , connections.end());
     EXPECT_TRUE(idMap.size() > 0);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
     
     Tcb& b = connections[cPair];
     
@@ -74,12 +77,52 @@ TEST_F(OpenTestFixture, OpenCompleteActive){
     
 }
 
+TEST_F(OpenTestFixture, ActiveOpenSendsQueuedBytes){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    int createdId = 0;
+    App a(TEST_APP_ID);
+    ASSERT_EQ(open(&a, TEST_SOCKET, false, lp, rp, createdId), LocalCode::SUCCESS);
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    uint32_t iss = interceptedPackets[0].getSeqNum();
+    
+    IpPacket ip;
+    ip.setSrcAddr(TEST_REM_IP).setDestAddr(TEST_LOC_IP);
+    TcpPacket& synAck = ip.getTcpPacket();
+    synAck.setFlag(TcpPacketFlags::SYN).setFlag(TcpPacketFlags::ACK).setSeq(TEST_PEER_ISS).setAck(iss + 1);
+    synAck.setSrcPort(TEST_REM_PORT).setDestPort(TEST_LOC_PORT).setWindow(MAX_UNSCALED_WINDOW);
+    SegmentEv se(ip, TEST_EVENT_ID);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_EQ(demultiplexSegment(TEST_SOCKET, se, remCode), LocalCode::SUCCESS);
+    
+    ConnPair cPair(lp,rp);
+    Tcb& b = connections[cPair];
+    ASSERT_TRUE(dynamic_cast<EstabS*>(b.getCurrentState()));
+    
+    //the send ring has to start where sNxt does, or the first segment carries whatever sits at the ring's default position
+    deque<uint8_t> msg;
+    for(uint8_t i = 1; i <= 40; i++) msg.push_back(i);
+    SendEv e(msg, false, true, TEST_EVENT_ID);
+    ASSERT_EQ(b.processEventEntry(TEST_SOCKET, e), LocalCode::SUCCESS);
+    ASSERT_EQ(b.trySend(TEST_SOCKET), LocalCode::SUCCESS);
+    
+    TcpPacket* data = nullptr;
+    for(auto iter = interceptedPackets.begin(); iter != interceptedPackets.end(); iter++){
+      if(iter->getPayload().size() > 0) data = &*iter;
+    }
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(data->getSeqNum(), iss + 1);
+    EXPECT_EQ(data->getPayload(), vector<uint8_t>(msg.begin(), msg.end()));
+    
+}
+
 TEST_F(OpenTestFixture, OpenCompletePassive){
 
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     int createdId = 0;
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     LocalCode lc = open(&a, TEST_SOCKET, true, lp, rp, createdId);
     
     ASSERT_EQ(lc , LocalCode::SUCCESS);
@@ -89,8 +132,9 @@ TEST_F(OpenTestFixture, OpenCompletePassive){
     ASSERT_NE(connections.find(cPair) , connections.end());
     EXPECT_TRUE(idMap.size() > 0);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
     
     Tcb& b = connections[cPair];
     
@@ -108,14 +152,15 @@ TEST_F(OpenTestFixture, OpenRemUnspecPassive){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(UNSPECIFIED, UNSPECIFIED);
     int createdId = 0;
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     LocalCode lc = open(&a, TEST_SOCKET, true, lp, rp, createdId);
     
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
     ConnPair cPair(lp,rp);
     
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
     ASSERT_TRUE(connections.find(cPair) != connections.end() && idMap.size() > 0);
 }
 
@@ -124,16 +169,17 @@ TEST_F(OpenTestFixture, OpenRemUnspecActive){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(UNSPECIFIED, UNSPECIFIED);
     int createdId = 0;
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     LocalCode lc = open(&a, TEST_SOCKET, false, lp, rp, createdId);
     
     ASSERT_EQ(lc , LocalCode::SUCCESS);
     
     ConnPair cPair(lp,rp);
     
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
     
-    EXPECT_TRUE((a.getAppNotifs().size() > 0) && (a.getAppNotifs().front() == TcpCode::ACTIVEUNSPEC));
+    EXPECT_TRUE((notifs.appNotifs.size() > 0) && (notifs.appNotifs.front() == TcpCode::ACTIVEUNSPEC));
     ASSERT_TRUE(connections.find(cPair) == connections.end() && idMap.size() < 1);
     
 }
@@ -143,7 +189,7 @@ TEST_F(OpenTestFixture, OpenLocUnspec){
     LocalPair lp(UNSPECIFIED,UNSPECIFIED);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     int createdId = 0;
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     LocalCode lc = open(&a, TEST_SOCKET, true, lp, rp, createdId);
     
     ASSERT_EQ(lc , LocalCode::SUCCESS);
@@ -151,8 +197,9 @@ TEST_F(OpenTestFixture, OpenLocUnspec){
     ASSERT_TRUE(connections.size() > 0);
     EXPECT_TRUE(idMap.size() > 0);
     
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
-    EXPECT_TRUE(a.getConnNotifs().size() < 1);
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
+    EXPECT_TRUE(notifs.connNotifs.size() < 1);
     
     Tcb& b = connections.begin()->second;
     ConnPair cPair = b.getConnPair();
@@ -165,9 +212,9 @@ TEST_F(OpenTestFixture, OpenFromListenPassive){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<ListenS>());
+    b.setCurrentState(ListenS::instance);
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b);
     
@@ -181,8 +228,9 @@ TEST_F(OpenTestFixture, OpenFromListenPassive){
     
     EXPECT_TRUE(bAfter.wasPassiveOpen());
     EXPECT_TRUE(dynamic_cast<ListenS*>(testS));
-    EXPECT_TRUE(a.getAppNotifs().size() < 1);
-    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = a.getConnNotifs();
+    SplitNotifs notifs = splitNotifs(a);
+    EXPECT_TRUE(notifs.appNotifs.size() < 1);
+    std::unordered_map<int, std::deque<TcpCode> >& connNotifs = notifs.connNotifs;
     ASSERT_TRUE(
       (connNotifs.find(TEST_CONN_ID) != connNotifs.end()) 
       && (connNotifs[TEST_CONN_ID].size() > 0) 
@@ -196,10 +244,10 @@ TEST_F(OpenTestFixture, OpenFromListenActive){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
     
-    b.setCurrentState(make_unique<ListenS>());
+    b.setCurrentState(ListenS::instance);
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b);
     
@@ -220,9 +268,9 @@ TEST_F(OpenTestFixture, OpenListenActiveRemUnspec){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(UNSPECIFIED, UNSPECIFIED);
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<ListenS>());
+    b.setCurrentState(ListenS::instance);
   
     ConnPair cPair(lp,rp);
     connections[cPair] = move(b); 
@@ -237,7 +285,8 @@ TEST_F(OpenTestFixture, OpenListenActiveRemUnspec){
 
     EXPECT_TRUE(bAfter.wasPassiveOpen());
     EXPECT_TRUE(dynamic_cast<ListenS*>(testS));
-    ASSERT_TRUE((a.getAppNotifs().size() > 0) && (a.getAppNotifs().front() == TcpCode::ACTIVEUNSPEC));
+    SplitNotifs notifs = splitNotifs(a);
+    ASSERT_TRUE((notifs.appNotifs.size() > 0) && (notifs.appNotifs.front() == TcpCode::ACTIVEUNSPEC));
     
 }
 
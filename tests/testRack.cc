@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "testingUtil.h"
+#include <thread>
+
+using namespace std;
+
+namespace rackTests{
+
+const uint32_t SEG_SIZE = 100;
+
+class RackFixture : public InterceptFixture{};
+
+//an established connection with sack negotiated and numSegs segments of SEG_SIZE queued(sUna at 1)
+void setup(Tcb& b, int numSegs){
+  TcpPacket syn;
+  syn.setFlag(TcpPacketFlags::SYN).setFlag(TcpPacketFlags::ACK);
+  syn.getOptions().push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::SACK_PERMITTED), 0x2, true, {}));
+  b.checkAndSetPeerMSS(syn);
+  establishWithAck(b);
+
+  std::deque<uint8_t> msg(SEG_SIZE * numSegs);
+  SendEv e(msg, false, false, TEST_EVENT_ID);
+  b.addToSendQueue(e);
+}
+
+TEST_F(RackFixture, LaterDeliveryMarksEarlierSendLost){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    setup(b, 3);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    this_thread::sleep_for(chrono::milliseconds(40));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    this_thread::sleep_for(chrono::milliseconds(5));
+    interceptedPackets.clear();
+
+    //a single sacked segment is far below the dup ack threshold, but the first segment went out a whole rtt before it
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = peerAck(1, {{101, 201}});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_TRUE(b.inSackRecovery());
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getSeqNum(), 1);
+}
+
+TEST_F(RackFixture, ReorderTimerWaitsOutWindow){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    setup(b, 2);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    this_thread::sleep_for(chrono::milliseconds(80));
+    interceptedPackets.clear();
+
+    //both went out together, so the first is only lost once a quarter rtt passes without it
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = peerAck(1, {{101, 201}});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_FALSE(b.inSackRecovery());
+    EXPECT_TRUE(interceptedPackets.empty());
+    EXPECT_FALSE(b.reorderTimerExpired());
+
+    this_thread::sleep_for(chrono::milliseconds(30));
+    ASSERT_TRUE(b.reorderTimerExpired());
+    ASSERT_TRUE(b.reorderTimeoutCallback(TEST_SOCKET));
+    EXPECT_TRUE(b.inSackRecovery());
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getSeqNum(), 1);
+}
+
+TEST_F(RackFixture, TailLossProbeResendsLastSegment){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    setup(b, 3);
+    for(int i = 0; i < 3; i++){
+      ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+
+    //the first segment is acked, the last two are dropped and nothing more comes back
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = peerAck(1 + SEG_SIZE, {});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    interceptedPackets.clear();
+    uint32_t cwnd = b.congestionControl().getCwnd();
+
+    chrono::steady_clock::time_point deadline;
+    ASSERT_TRUE(b.nextTimerDeadline(deadline));
+    EXPECT_LT(deadline, chrono::steady_clock::now() + chrono::milliseconds(RTO_INITIAL_SECONDS * 1000 / 2));
+    this_thread::sleep_for(deadline - chrono::steady_clock::now() + chrono::milliseconds(1));
+    ASSERT_TRUE(b.probeTimerExpired());
+    EXPECT_FALSE(b.rtoTimerExpired());
+    ASSERT_TRUE(b.probeTimeoutCallback(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getSeqNum(), 1 + 2 * SEG_SIZE);
+
+    //the probe's ack exposes the hole and the probe counts as a repaired loss
+    TcpPacket probeAck = peerAck(1 + SEG_SIZE, {{1 + 2 * SEG_SIZE, 1 + 3 * SEG_SIZE}});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, probeAck, remCode) == LocalCode::SUCCESS);
+    TcpPacket full = peerAck(1 + 3 * SEG_SIZE, {});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, full, remCode) == LocalCode::SUCCESS);
+    EXPECT_TRUE(b.noRetransmitsOutstanding());
+    EXPECT_LT(b.congestionControl().getCwnd(), cwnd);
+    EXPECT_FALSE(b.probeTimerExpired());
+}
+
+TEST_F(RackFixture, TailLossProbePrefersNewData){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    setup(b, 3);
+    b.updateWindowVars(MAX_UNSCALED_WINDOW, 0, 0);
+    for(int i = 0; i < 2; i++){
+      ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    }
+    interceptedPackets.clear();
+
+    ASSERT_TRUE(b.probeTimeoutCallback(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getSeqNum(), 1 + 2 * SEG_SIZE);
+    EXPECT_EQ(interceptedPackets[0].getPayload().size(), SEG_SIZE);
+}
+
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "../src/reactor.h"
+#include "testingUtil.h"
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+namespace reactorTests{
+
+const std::chrono::microseconds MAX_TIMER_LATENESS{1000};
+
+//waits on the reactor until the timer fires, returns how long after the deadline the wakeup actually happened
+std::chrono::nanoseconds waitForDeadline(Reactor& r, std::chrono::steady_clock::time_point deadline){
+
+  bool timerFired = false;
+  while(!timerFired){
+    bool socketReady = false;
+    bool woken = false;
+    EXPECT_TRUE(r.wait(true, socketReady, timerFired, woken));
+  }
+  return std::chrono::steady_clock::now() - deadline;
+}
+
+TEST(ReactorTest, TimerFiresWithinMillisecond){
+
+    Reactor r;
+    ASSERT_TRUE(r.init(-1));
+    
+    for(int ms = 5; ms <= 50; ms += 15){
+      std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+      ASSERT_TRUE(r.armTimer(deadline));
+      std::chrono::nanoseconds lateness = waitForDeadline(r, deadline);
+      EXPECT_GE(lateness.count(), 0);
+      EXPECT_LT(lateness, MAX_TIMER_LATENESS);
+    }
+    
+}
+
+TEST(ReactorTest, PastDeadlineFiresImmediately){
+
+    Reactor r;
+    ASSERT_TRUE(r.init(-1));
+    
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() - std::chrono::milliseconds(5);
+    ASSERT_TRUE(r.armTimer(deadline));
+    
+    bool socketReady = false;
+    bool timerFired = false;
+    bool woken = false;
+    ASSERT_TRUE(r.wait(false, socketReady, timerFired, woken));
+    ASSERT_TRUE(timerFired);
+    
+}
+
+TEST(ReactorTest, DisarmedTimerDoesNotFire){
+
+    Reactor r;
+    ASSERT_TRUE(r.init(-1));
+    
+    ASSERT_TRUE(r.armTimer(std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+    ASSERT_TRUE(r.disarmTimer());
+    
+    bool socketReady = false;
+    bool timerFired = false;
+    bool woken = false;
+    ASSERT_TRUE(r.wait(false, socketReady, timerFired, woken));
+    ASSERT_FALSE(timerFired);
+    
+}
+
+TEST(ReactorTest, WakeInterruptsWait){
+
+    Reactor r;
+    ASSERT_TRUE(r.init(-1));
+    ASSERT_TRUE(r.wake());
+    
+    bool socketReady = false;
+    bool timerFired = false;
+    bool woken = false;
+    ASSERT_TRUE(r.wait(true, socketReady, timerFired, woken));
+    ASSERT_TRUE(woken);
+    ASSERT_FALSE(timerFired);
+    
+}
+
+class ReactorFixture : public InterceptFixture{
+  protected:
+    void TearDown() override{
+      InterceptFixture::TearDown();
+      connections.clear();
+      idMap.clear();
+    }
+};
+
+TEST_F(ReactorFixture, RtoDeadlineFiresWithinMillisecond){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    
+    //id 0 is taken, so the syn's rto has to be found through a non zero id
+    idMap[0] = ConnPair(LocalPair(TEST_LOC_IP, TEST_LOC_PORT + 1), rp);
+    App a(TEST_APP_ID);
+    int createdId = 0;
+    ASSERT_EQ(open(&a, TEST_SOCKET, false, lp, rp, createdId), LocalCode::SUCCESS);
+    ASSERT_NE(createdId, 0);
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    
+    std::chrono::steady_clock::time_point deadline;
+    ASSERT_TRUE(connections[ConnPair(lp, rp)].nextTimerDeadline(deadline));
+    std::chrono::steady_clock::time_point nextDeadline;
+    bool haveDeadline = false;
+    ASSERT_EQ(serviceTimers(TEST_SOCKET, nextDeadline, haveDeadline), LocalCode::SUCCESS);
+    ASSERT_TRUE(haveDeadline);
+    ASSERT_FALSE(nextDeadline > deadline);
+    
+    //same wait and service steps as the driver loop, until the rto's retransmission goes out or it is already too late
+    Reactor r;
+    ASSERT_TRUE(r.init(-1));
+    while(interceptedPackets.size() < 2 && std::chrono::steady_clock::now() < deadline + MAX_TIMER_LATENESS){
+      ASSERT_TRUE(r.armTimer(nextDeadline));
+      waitForDeadline(r, nextDeadline);
+      ASSERT_EQ(serviceTimers(TEST_SOCKET, nextDeadline, haveDeadline), LocalCode::SUCCESS);
+      ASSERT_TRUE(haveDeadline);
+    }
+    std::chrono::nanoseconds lateness = std::chrono::steady_clock::now() - deadline;
+    
+    ASSERT_EQ(interceptedPackets.size(), 2);
+    EXPECT_TRUE(interceptedPackets[1].getFlag(TcpPacketFlags::SYN));
+    EXPECT_EQ(interceptedPackets[1].getSeqNum(), interceptedPackets[0].getSeqNum());
+    EXPECT_GE(lateness.count(), 0);
+    EXPECT_LT(lateness, MAX_TIMER_LATENESS);
+    
+}
+
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "../src/reassembly.h"
+#include "testingUtil.h"
+
+using namespace std;
+
+namespace reassemblyTests{
+
+vector<uint8_t> bytesFrom(uint8_t first, size_t len){
+  vector<uint8_t> v(len);
+  for(size_t i = 0; i < len; i++) v[i] = static_cast<uint8_t>(first + i);
+  return v;
+}
+
+TEST(ReassemblyQueueTest, DisjointRangesStaySeparate){
+
+    ReassemblyQueue q;
+    vector<uint8_t> a = bytesFrom(10, 5);
+    vector<uint8_t> b = bytesFrom(30, 5);
+    q.insert(30, b.data(), b.size(), false);
+    q.insert(10, a.data(), a.size(), false);
+    EXPECT_EQ(q.rangeCount(), 2);
+    EXPECT_EQ(q.size(), 10);
+
+    ReassemblyRange r;
+    EXPECT_FALSE(q.popReady(5, r));
+    ASSERT_TRUE(q.popReady(10, r));
+    EXPECT_EQ(r.seq, 10);
+    EXPECT_EQ(r.data, a);
+    EXPECT_FALSE(q.popReady(15, r));
+}
+
+TEST(ReassemblyQueueTest, OverlapsAndNeighboursMerge){
+
+    ReassemblyQueue q;
+    vector<uint8_t> a = bytesFrom(10, 5); //10-14
+    vector<uint8_t> b = bytesFrom(20, 5); //20-24
+    vector<uint8_t> c = bytesFrom(15, 5); //15-19, touches both
+    vector<uint8_t> d = bytesFrom(8, 20); //8-27, covers everything
+    q.insert(10, a.data(), a.size(), false);
+    q.insert(20, b.data(), b.size(), true);
+    q.insert(15, c.data(), c.size(), false);
+    EXPECT_EQ(q.rangeCount(), 1);
+    EXPECT_EQ(q.size(), 15);
+    q.insert(8, d.data(), d.size(), false);
+    EXPECT_EQ(q.rangeCount(), 1);
+    EXPECT_EQ(q.size(), 20);
+
+    ReassemblyRange r;
+    ASSERT_TRUE(q.popReady(8, r));
+    EXPECT_EQ(r.seq, 8);
+    EXPECT_EQ(r.data, d);
+    EXPECT_TRUE(r.push);
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ReassemblyQueueTest, HeldBytesWinOverlaps){
+
+    ReassemblyQueue q;
+    vector<uint8_t> a(10, 0xaa); //10-19
+    vector<uint8_t> b(10, 0xbb); //30-39
+    vector<uint8_t> c(40, 0xcc); //5-44, starts before and runs over both
+    vector<uint8_t> d(10, 0xdd); //40-49, starts inside the merged range
+    q.insert(10, a.data(), a.size(), false);
+    q.insert(30, b.data(), b.size(), false);
+    q.insert(5, c.data(), c.size(), false);
+    q.insert(40, d.data(), d.size(), false);
+    EXPECT_EQ(q.rangeCount(), 1);
+    EXPECT_EQ(q.size(), 45);
+
+    vector<uint8_t> expected;
+    expected.insert(expected.end(), 5, 0xcc);
+    expected.insert(expected.end(), a.begin(), a.end());
+    expected.insert(expected.end(), 10, 0xcc);
+    expected.insert(expected.end(), b.begin(), b.end());
+    expected.insert(expected.end(), 5, 0xcc);
+    expected.insert(expected.end(), 5, 0xdd);
+    ReassemblyRange r;
+    ASSERT_TRUE(q.popReady(5, r));
+    EXPECT_EQ(r.seq, 5);
+    EXPECT_EQ(r.data, expected);
+}
+
+TEST(ReassemblyQueueTest, StaleRangesDropped){
+
+    ReassemblyQueue q;
+    vector<uint8_t> a = bytesFrom(0, 5);
+    vector<uint8_t> b = bytesFrom(0, 5);
+    q.insert(100, a.data(), a.size(), false);
+    q.insert(110, b.data(), b.size(), false);
+
+    ReassemblyRange r;
+    ASSERT_TRUE(q.popReady(112, r));
+    EXPECT_EQ(r.seq, 110);
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(q.size(), 0);
+}
+
+TEST(ReassemblyQueueTest, OrderedAcrossSequenceWrap){
+
+    ReassemblyQueue q;
+    vector<uint8_t> a = bytesFrom(0, 8);
+    vector<uint8_t> b = bytesFrom(8, 8);
+    q.insert(4, b.data(), b.size(), false);
+    q.insert(UINT32_MAX - 3, a.data(), a.size(), false);
+    EXPECT_EQ(q.rangeCount(), 1);
+
+    ReassemblyRange r;
+    ASSERT_TRUE(q.popReady(UINT32_MAX - 3, r));
+    EXPECT_EQ(r.data, bytesFrom(0, 16));
+}
+
+TEST(ReassemblyTcbTest, GapFillDeliversHeldData){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    vector<uint8_t> first = bytesFrom(0, 10);
+    vector<uint8_t> second = bytesFrom(10, 10);
+    vector<uint8_t> third = bytesFrom(20, 10);
+
+    TcpPacket p3;
+    p3.setSeq(20).setPayload(third);
+    b.processData(p3);
+    TcpPacket p2;
+    p2.setSeq(10).setPayload(second);
+    b.processData(p2);
+    EXPECT_TRUE(b.noIncomingData());
+
+    TcpPacket p1;
+    p1.setSeq(0).setPayload(first);
+    b.processData(p1);
+
+    ReceiveEv e(30, {}, TEST_EVENT_ID);
+    b.processRead(e, false);
+    EXPECT_EQ(e.getBuffer(), bytesFrom(0, 30));
+}
+
+TEST(ReassemblyTcbTest, FinWaitsForGap){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    vector<uint8_t> first = bytesFrom(0, 10);
+    vector<uint8_t> second = bytesFrom(10, 10);
+
+    TcpPacket p2;
+    p2.setSeq(10).setPayload(second).setFlag(TcpPacketFlags::FIN);
+    b.processData(p2);
+    bool fin = false;
+    SegmentEv se(IpPacket(), TEST_EVENT_ID);
+    b.checkFin(TEST_SOCKET, p2, fin, se);
+    EXPECT_FALSE(fin);
+
+    TcpPacket p1;
+    p1.setSeq(0).setPayload(first);
+    b.processData(p1);
+    b.checkFin(TEST_SOCKET, p1, fin, se);
+    EXPECT_TRUE(fin);
+}
+
+}
@@ -13,9 +13,9 @@ TEST(RecReadSegmentTest, RecReadSimple){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
   
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<EstabS>());
+    b.setCurrentState(EstabS::instance);
     std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     std::vector<uint8_t> expected = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     
@@ -39,9 +39,9 @@ TEST(RecReadSegmentTest, TwoSegmentsNoOverlap){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
   
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<EstabS>());
+    b.setCurrentState(EstabS::instance);
     std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     std::vector<uint8_t> expected = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     
@@ -71,9 +71,9 @@ TEST(RecReadSegmentTest, TwoSegmentsOverlap){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
   
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<CloseWaitS>());
+    b.setCurrentState(CloseWaitS::instance);
     std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     std::vector<uint8_t> expected = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 6, 7, 8, 9, 10};
     
@@ -102,9 +102,9 @@ TEST(RecReadSegmentTest, SegmentPushConsumed){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
   
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<CloseWaitS>());
+    b.setCurrentState(CloseWaitS::instance);
     std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     
     TcpPacket p;
@@ -124,9 +124,9 @@ TEST(RecReadSegmentTest, SegmentPushUnconsumed){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
   
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<CloseWaitS>());
+    b.setCurrentState(CloseWaitS::instance);
     std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     
     TcpPacket p;
@@ -146,9 +146,9 @@ TEST(RecReadSegmentTest, SegmentUrgentConsumed){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
   
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<CloseWaitS>());
+    b.setCurrentState(CloseWaitS::instance);
     std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     
     TcpPacket p;
@@ -172,9 +172,9 @@ TEST(RecReadSegmentTest, SegmentUrgentUnconsumed){
     LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
   
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
-    b.setCurrentState(make_unique<CloseWaitS>());
+    b.setCurrentState(CloseWaitS::instance);
     std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
     
     TcpPacket p;
@@ -193,6 +193,193 @@ TEST(RecReadSegmentTest, SegmentUrgentUnconsumed){
     
 }
 
+TEST(RecReadSegmentTest, RegisteredBufferLowWater){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+  
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    
+    TcpPacket p;
+    p.setPayload(dummyMsg);
+    b.processData(p);
+    
+    //not enough for the water mark, nothing is copied
+    uint8_t userBuff[32] = {};
+    ReceiveEv tooMuch(userBuff, sizeof(userBuff), dummyMsg.size() + 1, 0, TEST_EVENT_ID);
+    ASSERT_FALSE(b.processRead(tooMuch, false));
+    EXPECT_EQ(tooMuch.getBytesRead(), 0);
+    
+    //past the water mark everything available is handed over, even though the buffer could take more
+    ReceiveEv e(userBuff, sizeof(userBuff), dummyMsg.size() / 2, 0, TEST_EVENT_ID);
+    ASSERT_FALSE(b.processRead(e, false));
+    ASSERT_EQ(e.getBytesRead(), dummyMsg.size());
+    EXPECT_TRUE(e.getBuffer().empty());
+    for(size_t i = 0; i < dummyMsg.size(); i++){
+      EXPECT_EQ(userBuff[i], dummyMsg[i]);
+    }
+    EXPECT_TRUE(b.noIncomingData());
+}
+
+TEST(RecReadSegmentTest, QueuedReadCompletesAcrossSegments){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+  
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    
+    TcpPacket p;
+    p.setPayload(dummyMsg);
+    b.processData(p);
+    
+    uint8_t userBuff[15] = {};
+    ReceiveEv e(userBuff, sizeof(userBuff), sizeof(userBuff), 0, TEST_EVENT_ID);
+    ASSERT_TRUE(b.processEventEntry(TEST_SOCKET, e) == LocalCode::SUCCESS);
+    EXPECT_EQ(userBuff[0], 0);
+    
+    TcpPacket pNext;
+    pNext.setPayload(dummyMsg);
+    pNext.setSeq(dummyMsg.size());
+    b.processData(pNext);
+    b.tryProcessReads();
+    
+    //the read spans both segments and leaves the tail of the second one queued
+    for(size_t i = 0; i < sizeof(userBuff); i++){
+      EXPECT_EQ(userBuff[i], dummyMsg[i % dummyMsg.size()]);
+    }
+    ReceiveEv rest(dummyMsg.size() / 2, {}, TEST_EVENT_ID);
+    ASSERT_FALSE(b.processRead(rest, false));
+    EXPECT_EQ(rest.getBuffer(), vector<uint8_t>(dummyMsg.begin() + 5, dummyMsg.end()));
+}
+
+
+TEST(RecReadSegmentTest, RegisteredReadReportsCompletion){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+  
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    const uint64_t tag = 0x1234567890;
+    
+    uint8_t userBuff[32] = {};
+    ReceiveEv e(userBuff, sizeof(userBuff), dummyMsg.size(), tag, TEST_EVENT_ID);
+    ASSERT_TRUE(b.processEventEntry(TEST_SOCKET, e) == LocalCode::SUCCESS);
+    AppNotif n;
+    EXPECT_FALSE(a.popNotif(n));
+    
+    TcpPacket p;
+    p.setPayload(dummyMsg);
+    b.processData(p);
+    b.tryProcessReads();
+    
+    ASSERT_TRUE(a.popNotif(n));
+    EXPECT_EQ(n.connId, TEST_CONN_ID);
+    EXPECT_EQ(n.code, TcpCode::RECEIVEDONE);
+    EXPECT_EQ(n.userData, tag);
+    EXPECT_EQ(n.byteCount, dummyMsg.size());
+    EXPECT_FALSE(a.popNotif(n));
+}
+
+TEST(RecReadSegmentTest, QueuedReadsAnsweredAfterFin){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+  
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    
+    uint8_t first[32] = {};
+    uint8_t second[32] = {};
+    ReceiveEv e1(first, sizeof(first), sizeof(first), 1, TEST_EVENT_ID);
+    ReceiveEv e2(second, sizeof(second), sizeof(second), 2, TEST_EVENT_ID);
+    ASSERT_TRUE(b.processEventEntry(TEST_SOCKET, e1) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.processEventEntry(TEST_SOCKET, e2) == LocalCode::SUCCESS);
+    TcpPacket p;
+    p.setPayload(dummyMsg);
+    b.processData(p);
+    b.tryProcessReads();
+    AppNotif n;
+    EXPECT_FALSE(a.popNotif(n));
+    
+    //the fin means neither water mark will be reached, the first read takes what is left and the second gets nothing
+    b.setCurrentState(CloseWaitS::instance);
+    b.tryProcessReads();
+    ASSERT_TRUE(a.popNotif(n));
+    EXPECT_EQ(n.code, TcpCode::RECEIVEDONE);
+    EXPECT_EQ(n.userData, 1);
+    EXPECT_EQ(n.byteCount, dummyMsg.size());
+    ASSERT_TRUE(a.popNotif(n));
+    EXPECT_EQ(n.code, TcpCode::CONNCLOSING);
+    EXPECT_EQ(n.userData, 2);
+    EXPECT_EQ(n.byteCount, 0);
+    EXPECT_FALSE(a.popNotif(n));
+}
+
+TEST(RecReadSegmentTest, PushSeenOnceReadPastPushedSegment){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+  
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    std::vector<uint8_t> dummyMsg = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    
+    TcpPacket p;
+    p.setPayload(dummyMsg);
+    p.setFlag(TcpPacketFlags::PSH);
+    b.processData(p);
+    TcpPacket pNext;
+    pNext.setPayload(dummyMsg);
+    pNext.setSeq(dummyMsg.size());
+    b.processData(pNext);
+    
+    ReceiveEv part(dummyMsg.size() - 1, {}, TEST_EVENT_ID);
+    ASSERT_TRUE(b.processRead(part, false));
+    EXPECT_FALSE(b.getPushSeen());
+    ReceiveEv rest(2, {}, TEST_EVENT_ID);
+    ASSERT_TRUE(b.processRead(rest, false));
+    EXPECT_TRUE(b.getPushSeen());
+    EXPECT_EQ(rest.getBuffer(), vector<uint8_t>({10, 1}));
+}
+
+TEST(RecReadSegmentTest, ReadsAcrossRingWrap){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+  
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    
+    //each round leaves the ring head further along, so later segments run off its end
+    uint32_t seq = 0;
+    for(int round = 0; round < 4; round++){
+      std::vector<uint8_t> msg(3000);
+      for(size_t i = 0; i < msg.size(); i++) msg[i] = static_cast<uint8_t>(round * 31 + i);
+      TcpPacket p;
+      p.setPayload(msg);
+      p.setSeq(seq);
+      b.processData(p);
+      seq += msg.size();
+      
+      ReceiveEv e(msg.size(), {}, TEST_EVENT_ID);
+      ASSERT_FALSE(b.processRead(e, false));
+      ASSERT_EQ(e.getBuffer(), msg);
+    }
+}
+
 
 }
 
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "testingUtil.h"
+#include <thread>
+
+using namespace std;
+
+namespace rtoTests{
+
+const uint32_t SEG_SIZE = 100;
+
+class RtoFixture : public InterceptFixture{};
+
+//sends the segment starting at seq and acks it after the given delay, leaving one karn sample behind
+void sampleRtt(Tcb& b, uint32_t seq, chrono::microseconds delay){
+  std::deque<uint8_t> msg(SEG_SIZE);
+  SendEv e(msg, false, false, TEST_EVENT_ID);
+  b.addToSendQueue(e);
+  b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE);
+  this_thread::sleep_for(delay);
+  RemoteCode remCode = RemoteCode::SUCCESS;
+  TcpPacket ack = peerAck(seq + SEG_SIZE);
+  b.establishedAckLogic(TEST_SOCKET, ack, remCode);
+}
+
+TEST_F(RtoFixture, InitialRtoBacksOff){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establishWithAck(b);
+    EXPECT_EQ(b.getRto(), chrono::seconds(RTO_INITIAL_SECONDS));
+
+    std::deque<uint8_t> msg(SEG_SIZE);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.rtoExpireCallback(TEST_SOCKET));
+    EXPECT_EQ(b.getRto(), 2 * chrono::seconds(RTO_INITIAL_SECONDS));
+}
+
+TEST_F(RtoFixture, SamplesKeepMicrosecondResolution){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establishWithAck(b);
+    b.setRtoFloor(chrono::milliseconds(0));
+    sampleRtt(b, 1, chrono::microseconds(2500));
+
+    //RFC 6298 2.2, the first sample sets rttvar to half of it so the rto is three times the sample
+    chrono::microseconds srtt = b.getSrtt();
+    EXPECT_GE(srtt, chrono::microseconds(2500));
+    EXPECT_LT(srtt, chrono::milliseconds(100));
+    EXPECT_EQ(b.getRto(), srtt + 4 * (srtt / 2));
+}
+
+TEST_F(RtoFixture, FloorBoundsRto){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establishWithAck(b);
+    sampleRtt(b, 1, chrono::microseconds(100));
+    EXPECT_EQ(b.getRto(), chrono::milliseconds(RTO_FLOOR_MILLISECONDS));
+
+    //raising the floor applies straight away once there is a sample
+    b.setRtoFloor(chrono::milliseconds(1500));
+    EXPECT_EQ(b.getRto(), chrono::milliseconds(1500));
+}
+
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "../src/network.h"
+#include "testingUtil.h"
+#include <thread>
+
+using namespace std;
+
+namespace sackTests{
+
+class SackFixture : public InterceptFixture{};
+
+bool hasOption(TcpPacket& p, TcpOptionKind kind){
+  for(TcpOption& o : p.getOptions()){
+    if(o.getKind() == static_cast<uint8_t>(kind)) return true;
+  }
+  return false;
+}
+
+vector<pair<uint32_t, uint32_t> > readSackBlocks(TcpPacket& p){
+  vector<pair<uint32_t, uint32_t> > blocks;
+  for(TcpOption& o : p.getOptions()){
+    if(o.getKind() != static_cast<uint8_t>(TcpOptionKind::SACK)) continue;
+    for(size_t i = 0; i + 8 <= o.getData().size(); i += 8){
+      uint32_t left = toAltOrder<uint32_t>(unloadBytes<uint32_t>(o.getData().data(), i));
+      uint32_t right = toAltOrder<uint32_t>(unloadBytes<uint32_t>(o.getData().data(), i + 4));
+      blocks.push_back(make_pair(left, right));
+    }
+  }
+  return blocks;
+}
+
+TcpPacket sackPermittedSyn(bool ack){
+  TcpPacket p;
+  p.setFlag(TcpPacketFlags::SYN);
+  if(ack) p.setFlag(TcpPacketFlags::ACK);
+  p.getOptions().push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::SACK_PERMITTED), 0x2, true, {}));
+  return p;
+}
+
+TEST_F(SackFixture, SynOffersSackPermitted){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    ASSERT_TRUE(b.sendSyn(TEST_SOCKET, lp, rp, false));
+    EXPECT_TRUE(hasOption(interceptedPackets[0], TcpOptionKind::SACK_PERMITTED));
+
+    TcpPacket plainSyn;
+    plainSyn.setFlag(TcpPacketFlags::SYN);
+    b.checkAndSetPeerMSS(plainSyn);
+    ASSERT_TRUE(b.sendSyn(TEST_SOCKET, lp, rp, true));
+    EXPECT_FALSE(hasOption(interceptedPackets[1], TcpOptionKind::SACK_PERMITTED));
+
+    TcpPacket syn = sackPermittedSyn(false);
+    b.checkAndSetPeerMSS(syn);
+    ASSERT_TRUE(b.sendSyn(TEST_SOCKET, lp, rp, true));
+    EXPECT_TRUE(hasOption(interceptedPackets[2], TcpOptionKind::SACK_PERMITTED));
+}
+
+TEST_F(SackFixture, AckReportsOutOfOrderData){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    TcpPacket syn = sackPermittedSyn(false);
+    b.checkAndSetPeerMSS(syn);
+
+    vector<uint8_t> payload(10);
+    TcpPacket p1;
+    p1.setSeq(20).setPayload(payload);
+    b.processData(p1);
+    TcpPacket p2;
+    p2.setSeq(40).setPayload(payload);
+    b.processData(p2);
+
+    ASSERT_TRUE(b.sendCurrentAck(TEST_SOCKET));
+    vector<pair<uint32_t, uint32_t> > blocks = readSackBlocks(interceptedPackets[0]);
+    ASSERT_EQ(blocks.size(), 2);
+    //most recent segment first
+    EXPECT_EQ(blocks[0], make_pair(40u, 50u));
+    EXPECT_EQ(blocks[1], make_pair(20u, 30u));
+    EXPECT_EQ(interceptedPackets[0].getDataOffset(), DEFAULT_TCP_DATA_OFFSET + 5);
+
+    //nothing held, no option
+    vector<uint8_t> fill(40);
+    TcpPacket p0;
+    p0.setSeq(0).setPayload(fill);
+    b.processData(p0);
+    ASSERT_TRUE(b.sendCurrentAck(TEST_SOCKET));
+    EXPECT_FALSE(hasOption(interceptedPackets[1], TcpOptionKind::SACK));
+}
+
+TEST_F(SackFixture, NoBlocksWithoutNegotiation){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+
+    vector<uint8_t> payload(10);
+    TcpPacket p1;
+    p1.setSeq(20).setPayload(payload);
+    b.processData(p1);
+    ASSERT_TRUE(b.sendCurrentAck(TEST_SOCKET));
+    EXPECT_FALSE(hasOption(interceptedPackets[0], TcpOptionKind::SACK));
+}
+
+TEST_F(SackFixture, RecoveryResendsOnlyHoles){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    uint32_t segSize = 100;
+    int numSegs = 6;
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    TcpPacket syn = sackPermittedSyn(true);
+    b.checkAndSetPeerMSS(syn);
+    b.initSenderState(false);
+
+    std::deque<uint8_t> msg(segSize * numSegs);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    for(int i = 0; i < numSegs; i++){
+      ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize, segSize) == LocalCode::SUCCESS);
+    }
+    interceptedPackets.clear();
+
+    //segments 1 and 2(seq 1 and 101) are missing, 3 to 6 arrived
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = peerAck(1, {{201, 601}});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_TRUE(b.inSackRecovery());
+    ASSERT_EQ(interceptedPackets.size(), 2);
+    EXPECT_EQ(interceptedPackets[0].getSeqNum(), 1);
+    EXPECT_EQ(interceptedPackets[1].getSeqNum(), 101);
+
+    //a repeat of the same information does not resend the holes again
+    TcpPacket dupAck = peerAck(1, {{201, 601}});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, dupAck, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(interceptedPackets.size(), 2);
+
+    TcpPacket fullAck;
+    fullAck.setFlag(TcpPacketFlags::ACK).setAck(601).setWindow(MAX_UNSCALED_WINDOW);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, fullAck, remCode) == LocalCode::SUCCESS);
+    EXPECT_FALSE(b.inSackRecovery());
+    EXPECT_TRUE(b.noRetransmitsOutstanding());
+}
+
+TEST_F(SackFixture, TooFewSackedSegmentsIsNotLoss){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    uint32_t segSize = 100;
+    int numSegs = 3;
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    TcpPacket syn = sackPermittedSyn(true);
+    b.checkAndSetPeerMSS(syn);
+    b.initSenderState(false);
+
+    std::deque<uint8_t> msg(segSize * numSegs);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    for(int i = 0; i < numSegs; i++){
+      ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize, segSize) == LocalCode::SUCCESS);
+    }
+    interceptedPackets.clear();
+
+    //only one segment above the hole has arrived, it may just be reordering. The rtt is long enough that rack's reordering window has not
+    //run out for segments sent in the same burst
+    this_thread::sleep_for(chrono::milliseconds(40));
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = peerAck(1, {{201, 301}});
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_FALSE(b.inSackRecovery());
+    EXPECT_TRUE(interceptedPackets.empty());
+}
+
+}
@@ -8,12 +8,7 @@ using namespace std;
 
 namespace sendAndPackageSegmentTests{
 
-class SendAndPackageSegmentFixture : public testing::Test{
-
-  void TearDown() override{
-    interceptedPackets.clear();
-  }
-};
+class SendAndPackageSegmentFixture : public InterceptFixture{};
 
 TEST_F(SendAndPackageSegmentFixture, SendSimple){
 
@@ -21,7 +16,7 @@ TEST_F(SendAndPackageSegmentFixture, SendSimple){
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     uint32_t segSize = 50;
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
     std::deque<uint8_t> dummyMsg(segSize);
     SendEv e(dummyMsg, false, false, TEST_EVENT_ID);
@@ -39,7 +34,7 @@ TEST_F(SendAndPackageSegmentFixture, SendPiggybackFin){
     RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
     uint32_t segSize = 50;
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
     std::deque<uint8_t> dummyMsg(segSize);
     SendEv e(dummyMsg, false, false, TEST_EVENT_ID);
@@ -61,7 +56,7 @@ TEST_F(SendAndPackageSegmentFixture, ConcatTwoSends){
     uint32_t segSize = 50;
     uint32_t segSizeSecond = 100;
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
     std::deque<uint8_t> dummyMsg(segSize);
     std::deque<uint8_t> dummyMsgSecond(segSizeSecond);
@@ -83,7 +78,7 @@ TEST_F(SendAndPackageSegmentFixture, UrgentSplitTwoSends){
     uint32_t segSize = 50;
     uint32_t segSizeSecond = 100;
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
     std::deque<uint8_t> dummyMsg(segSize);
     std::deque<uint8_t> dummyMsgSecond(segSizeSecond);
@@ -109,7 +104,7 @@ TEST_F(SendAndPackageSegmentFixture, UrgentConcatTwoSendsWithPush){
     uint32_t segSize = 50;
     uint32_t segSizeSecond = 100;
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
     std::deque<uint8_t> dummyMsg(segSize);
     std::deque<uint8_t> dummyMsgSecond(segSizeSecond);
@@ -134,7 +129,7 @@ TEST_F(SendAndPackageSegmentFixture, HalfSendsWithPush){
     uint32_t segSize = 50;
     uint32_t msgSize = segSize * 2;
     
-    App a(TEST_APP_ID, {}, {});
+    App a(TEST_APP_ID);
     Tcb b(&a, lp, rp, true, TEST_CONN_ID);
     std::deque<uint8_t> dummyMsg(msgSize);
     
@@ -154,7 +149,126 @@ TEST_F(SendAndPackageSegmentFixture, HalfSendsWithPush){
     
 }
 
+TEST_F(SendAndPackageSegmentFixture, PayloadBytesPreservedAcrossSends){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    uint32_t segSize = 30;
+    
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    std::deque<uint8_t> msg;
+    std::deque<uint8_t> msgSecond;
+    for(uint32_t i = 0; i < segSize; i++){
+      msg.push_back(i);
+      msgSecond.push_back(100 + i);
+    }
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    SendEv eSecond(msgSecond, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.addToSendQueue(eSecond));
+    
+    //segment boundaries fall in the middle of both sends
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize * 2, 20) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize * 2, 20) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize * 2, 20) == LocalCode::SUCCESS);
+    ASSERT_EQ(interceptedPackets.size(), 3);
+    std::vector<uint8_t> all;
+    for(auto iter = interceptedPackets.begin(); iter != interceptedPackets.end(); iter++){
+      ASSERT_EQ(iter->getSeqNum(), all.size());
+      all.insert(all.end(), iter->getPayload().begin(), iter->getPayload().end());
+    }
+    ASSERT_EQ(all.size(), segSize * 2);
+    for(uint32_t i = 0; i < segSize; i++){
+      ASSERT_EQ(all[i], i);
+      ASSERT_EQ(all[segSize + i], 100 + i);
+    }
+    ASSERT_TRUE(b.noSendsOutstanding());
+    
+}
 
+TEST_F(SendAndPackageSegmentFixture, RetransmitRebuiltFromSendBuffer){
 
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    uint32_t segSize = 20;
+    
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    std::deque<uint8_t> msg;
+    for(uint32_t i = 0; i < segSize * 2; i++){
+      msg.push_back(i);
+    }
+    SendEv e(msg, false, true, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize * 2, segSize) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize * 2, segSize) == LocalCode::SUCCESS);
+    ASSERT_EQ(interceptedPackets.size(), 2);
+    
+    ASSERT_TRUE(b.rtoExpireCallback(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 3);
+    ASSERT_EQ(interceptedPackets[2].getSeqNum(), 0);
+    ASSERT_EQ(interceptedPackets[2].getPayload(), interceptedPackets[0].getPayload());
+    
+    //acking the first segment drops its record and its bytes, the second one still comes back intact with its push flag
+    TcpPacket ack;
+    ack.setFlag(TcpPacketFlags::ACK).setAck(segSize).setSeq(0).setWindow(segSize * 2);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_EQ(b.establishedAckLogic(TEST_SOCKET, ack, remCode), LocalCode::SUCCESS);
+    ASSERT_EQ(remCode, RemoteCode::SUCCESS);
+    ASSERT_FALSE(b.noRetransmitsOutstanding());
+    ASSERT_TRUE(b.rtoExpireCallback(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 4);
+    ASSERT_EQ(interceptedPackets[3].getSeqNum(), segSize);
+    ASSERT_EQ(interceptedPackets[3].getPayload(), interceptedPackets[1].getPayload());
+    ASSERT_TRUE(interceptedPackets[3].getFlag(TcpPacketFlags::PSH));
+    
+    ack.setAck(segSize * 2);
+    ASSERT_EQ(b.establishedAckLogic(TEST_SOCKET, ack, remCode), LocalCode::SUCCESS);
+    ASSERT_TRUE(b.noRetransmitsOutstanding());
+    
 }
 
+TEST_F(SendAndPackageSegmentFixture, ZeroCopySendCompletesOnAck){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    uint32_t segSize = 10;
+    
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    std::deque<uint8_t> copied(segSize, 1);
+    SendEv first(copied, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(first));
+    std::vector<uint8_t> appBuff(segSize * 2, 2);
+    SendEv zc(appBuff.data(), appBuff.size(), false, false, TEST_EVENT_ID + 1);
+    ASSERT_TRUE(b.addToSendQueue(zc));
+    
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize * 3, segSize) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, segSize * 2, segSize * 2) == LocalCode::SUCCESS);
+    ASSERT_EQ(interceptedPackets.size(), 2);
+    ASSERT_EQ(interceptedPackets[0].getPayload(), std::vector<uint8_t>(segSize, 1));
+    ASSERT_EQ(interceptedPackets[1].getPayload(), appBuff);
+    
+    //a resend still comes straight out of the app's buffer
+    TcpPacket ack;
+    ack.setFlag(TcpPacketFlags::ACK).setAck(segSize).setSeq(0).setWindow(segSize * 3);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_EQ(b.establishedAckLogic(TEST_SOCKET, ack, remCode), LocalCode::SUCCESS);
+    ASSERT_TRUE(b.rtoExpireCallback(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 3);
+    ASSERT_EQ(interceptedPackets[2].getPayload(), appBuff);
+    SplitNotifs notifs = splitNotifs(a);
+    ASSERT_EQ(notifs.connNotifs[TEST_CONN_ID], std::deque<TcpCode>{TcpCode::OK});
+    
+    //the buffer is only handed back once all of it is acked
+    ack.setAck(segSize * 3);
+    ASSERT_EQ(b.establishedAckLogic(TEST_SOCKET, ack, remCode), LocalCode::SUCCESS);
+    notifs = splitNotifs(a);
+    ASSERT_EQ(notifs.connNotifs[TEST_CONN_ID], std::deque<TcpCode>{TcpCode::ZEROCOPYDONE});
+    
+}
+
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include "../src/seqRing.h"
+#include <vector>
+
+using namespace std;
+
+namespace seqRingTests{
+
+vector<uint8_t> pattern(size_t len, uint8_t start){
+  vector<uint8_t> v(len);
+  for(size_t i = 0; i < len; i++) v[i] = start + i;
+  return v;
+}
+
+TEST(SeqRingTest, CapacityIsPowerOfTwoPages){
+
+    SeqRing sb;
+    vector<uint8_t> data = pattern(10, 0);
+    ASSERT_TRUE(sb.append(data.data(), data.size()));
+    size_t cap = sb.getCapacity();
+    ASSERT_GE(cap, SEQ_RING_MIN_BYTES);
+    ASSERT_EQ(cap & (cap - 1), 0);
+    ASSERT_EQ(sb.size(), 10);
+
+}
+
+TEST(SeqRingTest, SequenceNumbersMapAcrossWrap){
+
+    SeqRing sb;
+    uint32_t isn = 0xfffffff0; //sequence space wraps too
+    sb.anchor(isn);
+    vector<uint8_t> fill = pattern(100, 0);
+    ASSERT_TRUE(sb.append(fill.data(), fill.size()));
+    size_t cap = sb.getCapacity();
+    sb.release(isn + 100);
+    ASSERT_EQ(sb.size(), 0);
+
+    //fill right up to the capacity, so the held bytes run off the end of the ring
+    vector<uint8_t> data = pattern(cap, 7);
+    ASSERT_TRUE(sb.append(data.data(), data.size()));
+    ASSERT_EQ(sb.getCapacity(), cap);
+    uint32_t first = isn + 100;
+    ASSERT_EQ(sb.getHeadSeq(), first);
+    ASSERT_EQ(sb.getTailSeq(), first + cap);
+
+    vector<uint8_t> out(cap);
+    sb.copyOut(first, cap, out.data());
+    ASSERT_EQ(out, data);
+    sb.copyOut(first + cap - 150, 120, out.data());
+    ASSERT_TRUE(equal(out.begin(), out.begin() + 120, data.begin() + cap - 150));
+
+    if(sb.isDoubleMapped()){
+      const uint8_t* view = sb.linear(first);
+      ASSERT_TRUE(equal(view, view + cap, data.begin()));
+    }
+
+    sb.release(first + 5);
+    ASSERT_EQ(sb.size(), cap - 5);
+    vector<uint8_t> more = pattern(5, 200);
+    ASSERT_TRUE(sb.append(more.data(), more.size()));
+    sb.copyOut(first + cap, 5, out.data());
+    ASSERT_TRUE(equal(out.begin(), out.begin() + 5, more.begin()));
+
+}
+
+TEST(SeqRingTest, GrowKeepsHeldBytes){
+
+    SeqRing sb;
+    sb.anchor(1000);
+    vector<uint8_t> data = pattern(SEQ_RING_MIN_BYTES - 10, 3);
+    ASSERT_TRUE(sb.append(data.data(), data.size()));
+    sb.release(1000 + 100);
+    vector<uint8_t> more = pattern(SEQ_RING_MIN_BYTES, 9);
+    ASSERT_TRUE(sb.append(more.data(), more.size()));
+    ASSERT_GT(sb.getCapacity(), SEQ_RING_MIN_BYTES);
+
+    vector<uint8_t> out(sb.size());
+    sb.copyOut(1100, out.size(), out.data());
+    ASSERT_TRUE(equal(data.begin() + 100, data.end(), out.begin()));
+    ASSERT_TRUE(equal(more.begin(), more.end(), out.begin() + data.size() - 100));
+
+    SeqRing moved(move(sb));
+    ASSERT_EQ(sb.size(), 0);
+    ASSERT_EQ(moved.getHeadSeq(), 1100);
+    moved.copyOut(1100, 10, out.data());
+    ASSERT_TRUE(equal(data.begin() + 100, data.begin() + 110, out.begin()));
+
+}
+
+TEST(SeqRingTest, ExternalSpansShareSequenceSpace){
+
+    SeqRing sb;
+    sb.anchor(500);
+    vector<uint8_t> before = pattern(10, 0);
+    vector<uint8_t> app = pattern(20, 100);
+    vector<uint8_t> after = pattern(5, 200);
+    ASSERT_TRUE(sb.append(before.data(), before.size()));
+    sb.appendExternal(app.data(), app.size());
+    ASSERT_TRUE(sb.append(after.data(), after.size()));
+    ASSERT_EQ(sb.size(), 35);
+    ASSERT_EQ(sb.getTailSeq(), 535);
+
+    vector<uint8_t> all(before);
+    all.insert(all.end(), app.begin(), app.end());
+    all.insert(all.end(), after.begin(), after.end());
+    vector<uint8_t> out(35);
+    sb.copyOut(500, 35, out.data());
+    ASSERT_EQ(out, all);
+
+    //releasing part way into the app's span leaves the rest of it and the ring bytes behind it addressable
+    sb.release(515);
+    ASSERT_EQ(sb.size(), 20);
+    out.assign(20, 0);
+    sb.copyOut(515, 20, out.data());
+    ASSERT_TRUE(equal(out.begin(), out.end(), all.begin() + 15));
+    sb.copyOut(532, 3, out.data());
+    ASSERT_TRUE(equal(out.begin(), out.begin() + 3, after.begin() + 2));
+
+    sb.release(535);
+    ASSERT_EQ(sb.size(), 0);
+    ASSERT_EQ(sb.getHeadSeq(), 535);
+
+}
+
+}
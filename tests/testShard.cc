@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "../src/shard.h"
+#include "testingUtil.h"
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace shardTests{
+
+//default key and first ipv4 verification vector from the microsoft rss spec
+const uint8_t MS_RSS_KEY[RSS_KEY_LEN] = {
+  0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+  0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+  0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+  0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+TEST(ShardTest, ToeplitzMatchesVerificationVector){
+
+    //66.9.149.187:2794 -> 161.142.100.80:1766
+    uint8_t input[12] = {66, 9, 149, 187, 161, 142, 100, 80, 0x0a, 0xea, 0x06, 0xe6};
+    ASSERT_EQ(toeplitzHash(input, sizeof(input), MS_RSS_KEY), 0x51ccc178);
+
+}
+
+TEST(ShardTest, FlowHashSymmetric){
+
+    for(uint32_t i = 0; i < 200; i++){
+      LocalPair lP(0x0a000001 + (i * 7919), 40000 + i);
+      RemotePair rP(0xc0a80001 + (i * 104729), 80 + (i * 13));
+      ConnPair forward(lP, rP);
+      ConnPair reverse(LocalPair(rP.first, rP.second), RemotePair(lP.first, lP.second));
+      ASSERT_EQ(flowHash(forward), flowHash(reverse));
+      for(int n = 1; n <= 8; n++){
+        ASSERT_EQ(shardForFlow(forward, n), shardForFlow(reverse, n));
+        ASSERT_LT(shardForFlow(forward, n), n);
+      }
+    }
+
+}
+
+TEST(ShardTest, DynPortSteersToShard){
+
+    connections.clear();
+    idMap.clear();
+    shardCount = 4;
+    RemotePair rP(0xc0a80001, 80);
+    for(int i = 0; i < shardCount; i++){
+      shardIndex = i;
+      uint16_t p = pickDynPort(0x0a000001, rP);
+      ASSERT_NE(p, UNSPECIFIED);
+      ASSERT_EQ(shardForFlow(ConnPair(LocalPair(0x0a000001, p), rP), shardCount), i);
+      int id = -1;
+      ASSERT_TRUE(pickId(id));
+      ASSERT_EQ(id % shardCount, i);
+    }
+    shardIndex = 0;
+    shardCount = 1;
+
+}
+
+TEST(ShardTest, MailboxKeepsEveryProducersOrder){
+
+    const int producers = 4;
+    const int perProducer = 10000;
+    MpscMailbox<pair<int,int> > mailbox;
+    vector<thread> threads;
+    for(int p = 0; p < producers; p++){
+      threads.push_back(thread([&mailbox, p](){
+        for(int i = 0; i < perProducer; i++){
+          mailbox.push(pair<int,int>(p, i));
+        }
+      }));
+    }
+
+    vector<int> nextExpected(producers, 0);
+    int received = 0;
+    while(received < producers * perProducer){
+      pair<int,int> val;
+      if(!mailbox.pop(val)){
+        this_thread::yield();
+        continue;
+      }
+      ASSERT_EQ(val.second, nextExpected[val.first]);
+      nextExpected[val.first]++;
+      received++;
+    }
+    for(auto iter = threads.begin(); iter != threads.end(); iter++){
+      iter->join();
+    }
+    ASSERT_TRUE(mailbox.empty());
+
+}
+
+
+//runs the handful of classic bpf instructions the steering filter uses, returns the accept length(0 means dropped)
+uint32_t runFilter(const vector<sock_filter>& prog, const vector<uint8_t>& pkt){
+
+    uint32_t a = 0;
+    uint32_t x = 0;
+    uint32_t mem[BPF_MEMWORDS] = {0};
+    auto load = [&pkt](uint32_t off, int len, bool& ok){
+      uint32_t val = 0;
+      ok = (off + len <= pkt.size());
+      for(int i = 0; ok && i < len; i++) val = (val << 8) | pkt[off + i];
+      return val;
+    };
+    bool ok = true;
+    for(size_t pc = 0; pc < prog.size(); pc++){
+      const sock_filter& in = prog[pc];
+      switch(in.code){
+        case BPF_LDX | BPF_B | BPF_MSH: x = 4 * (load(in.k, 1, ok) & 0xf); break;
+        case BPF_LD | BPF_H | BPF_IND: a = load(x + in.k, 2, ok); break;
+        case BPF_LD | BPF_W | BPF_ABS: a = load(in.k, 4, ok); break;
+        case BPF_LD | BPF_IMM: a = in.k; break;
+        case BPF_LD | BPF_MEM: a = mem[in.k]; break;
+        case BPF_ST: mem[in.k] = a; break;
+        case BPF_MISC | BPF_TAX: x = a; break;
+        case BPF_MISC | BPF_TXA: a = x; break;
+        case BPF_ALU | BPF_XOR | BPF_K: a ^= in.k; break;
+        case BPF_ALU | BPF_MOD | BPF_K: a %= in.k; break;
+        case BPF_JMP | BPF_JSET | BPF_K: pc += (a & in.k) ? in.jt : in.jf; break;
+        case BPF_JMP | BPF_JEQ | BPF_K: pc += (a == in.k) ? in.jt : in.jf; break;
+        case BPF_RET | BPF_K: return in.k;
+        default: ADD_FAILURE() << "unexpected opcode " << in.code; return 0;
+      }
+      if(!ok) return 0;
+    }
+    return 0;
+
+}
+
+//ip header(with ihl words) followed by the start of a tcp header, addresses and ports as seen on the wire
+vector<uint8_t> wirePacket(uint32_t src, uint32_t dst, uint16_t srcPort, uint16_t dstPort, int ihl){
+
+    vector<uint8_t> pkt(ihl * 4 + 20, 0);
+    pkt[0] = 0x40 | ihl;
+    pkt[9] = 6;
+    for(int i = 0; i < 4; i++){
+      pkt[12 + i] = (src >> (24 - (8 * i))) & 0xff;
+      pkt[16 + i] = (dst >> (24 - (8 * i))) & 0xff;
+    }
+    int tcp = ihl * 4;
+    pkt[tcp] = srcPort >> 8;
+    pkt[tcp + 1] = srcPort & 0xff;
+    pkt[tcp + 2] = dstPort >> 8;
+    pkt[tcp + 3] = dstPort & 0xff;
+    return pkt;
+
+}
+
+TEST(ShardTest, SteeringFilterMatchesShardForFlow){
+
+    for(int n = 2; n <= 8; n++){
+      vector<vector<sock_filter> > progs;
+      for(int i = 0; i < n; i++) progs.push_back(buildSteeringFilter(i, n));
+      for(uint32_t f = 0; f < 100; f++){
+        uint32_t src = 0xc0a80001 + (f * 104729);
+        uint32_t dst = 0x0a000001 + (f * 7919);
+        uint16_t srcPort = 80 + (f * 13);
+        uint16_t dstPort = 40000 + f;
+        //incoming segment, so local is the destination
+        int owner = shardForFlow(ConnPair(LocalPair(dst, dstPort), RemotePair(src, srcPort)), n);
+        vector<uint8_t> pkt = wirePacket(src, dst, srcPort, dstPort, 5 + (f % 3));
+        for(int i = 0; i < n; i++){
+          ASSERT_EQ(runFilter(progs[i], pkt) != 0, i == owner);
+        }
+      }
+    }
+    //too short to hold the ports, nobody takes it
+    vector<uint8_t> runt = wirePacket(0xc0a80001, 0x0a000001, 80, 40000, 5);
+    runt.resize(22);
+    ASSERT_EQ(runFilter(buildSteeringFilter(0, 2), runt), 0);
+    ASSERT_EQ(runFilter(buildSteeringFilter(1, 2), runt), 0);
+
+}
+
+TEST(ShardTest, SteeringFilterPassesKernelCheck){
+
+    //raw sockets need privileges, the kernel checks a program the same way whatever socket it goes on
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(s, 0);
+    ASSERT_TRUE(attachSteeringFilter(s, 3, MAX_SHARDS));
+    ::close(s);
+
+}
+
+}
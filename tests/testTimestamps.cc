@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "../src/network.h"
+#include "testingUtil.h"
+#include <thread>
+
+using namespace std;
+
+namespace timestampTests{
+
+const uint32_t SEG_SIZE = 100;
+const uint32_t PEER_TSVAL = 5000;
+
+class TimestampFixture : public InterceptFixture{
+
+  void TearDown() override{
+    InterceptFixture::TearDown();
+    connections.clear();
+    idMap.clear();
+  }
+};
+
+void addTimestamp(TcpPacket& p, uint32_t tsVal, uint32_t tsEcr){
+  vector<uint8_t> data;
+  loadBytes<uint32_t>(toAltOrder<uint32_t>(tsVal), data);
+  loadBytes<uint32_t>(toAltOrder<uint32_t>(tsEcr), data);
+  p.getOptions().push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::TIMESTAMP), TIMESTAMP_OPTION_LEN, true, data));
+}
+
+TcpPacket ackFor(uint32_t ackNum, uint32_t tsVal, uint32_t tsEcr){
+  TcpPacket p = peerAck(ackNum);
+  addTimestamp(p, tsVal, tsEcr);
+  return p;
+}
+
+//negotiates timestamps off a peer syn and acks the syn's sequence number so sUna sits at 1
+void establish(Tcb& b){
+  TcpPacket syn;
+  syn.setFlag(TcpPacketFlags::SYN).setSeq(TEST_PEER_ISS);
+  addTimestamp(syn, PEER_TSVAL, 0);
+  b.checkAndSetPeerMSS(syn);
+  TcpPacket synAck = ackFor(1, PEER_TSVAL, 0);
+  establishWithAck(b, synAck);
+}
+
+TEST_F(TimestampFixture, NegotiatedOptionIsOnEverySegment){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establish(b);
+    ASSERT_TRUE(b.timestampsOk());
+    EXPECT_EQ(b.getTsRecent(), PEER_TSVAL);
+
+    std::deque<uint8_t> msg(SEG_SIZE);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.sendCurrentAck(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 2);
+
+    for(TcpPacket& p : interceptedPackets){
+      uint32_t tsVal = 0;
+      uint32_t tsEcr = 0;
+      ASSERT_TRUE(Tcb::readTimestamp(p, tsVal, tsEcr));
+      EXPECT_EQ(tsEcr, PEER_TSVAL);
+      EXPECT_EQ(p.getDataOffset(), DEFAULT_TCP_DATA_OFFSET + TIMESTAMP_OPTION_BYTES / 4);
+    }
+}
+
+TEST_F(TimestampFixture, RetransmittedSegmentStillSamples){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establish(b);
+    b.setRtoFloor(chrono::milliseconds(0));
+
+    std::deque<uint8_t> msg(SEG_SIZE);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.rtoExpireCallback(TEST_SOCKET));
+    ASSERT_EQ(interceptedPackets.size(), 2);
+
+    //karn's rule gives nothing for a resent segment, the echo of the resend's timestamp does
+    uint32_t tsVal = 0;
+    uint32_t tsEcr = 0;
+    ASSERT_TRUE(Tcb::readTimestamp(interceptedPackets[1], tsVal, tsEcr));
+    this_thread::sleep_for(chrono::milliseconds(20));
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = ackFor(1 + SEG_SIZE, PEER_TSVAL, tsVal);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_GE(b.getSrtt(), chrono::milliseconds(20));
+    EXPECT_LT(b.getSrtt(), chrono::seconds(RTO_INITIAL_SECONDS));
+}
+
+TEST_F(TimestampFixture, SubTickEchoCountsAsOneTick){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establish(b);
+    b.setRtoFloor(chrono::milliseconds(0));
+
+    std::deque<uint8_t> msg(SEG_SIZE);
+    SendEv e(msg, false, false, TEST_EVENT_ID);
+    ASSERT_TRUE(b.addToSendQueue(e));
+    ASSERT_TRUE(b.packageAndSendSegments(TEST_SOCKET, SEG_SIZE, SEG_SIZE) == LocalCode::SUCCESS);
+    ASSERT_TRUE(b.rtoExpireCallback(TEST_SOCKET));
+    uint32_t tsVal = 0;
+    uint32_t tsEcr = 0;
+    ASSERT_TRUE(Tcb::readTimestamp(interceptedPackets[1], tsVal, tsEcr));
+
+    //acked within the same tick the resend was stamped in
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket ack = ackFor(1 + SEG_SIZE, PEER_TSVAL, tsVal);
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_GE(b.getSrtt(), chrono::milliseconds(1));
+}
+
+TEST_F(TimestampFixture, PawsDropsOldTimestamp){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establish(b);
+    ASSERT_TRUE(b.sendCurrentAck(TEST_SOCKET));
+    interceptedPackets.clear();
+
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    TcpPacket newer = ackFor(1, PEER_TSVAL + 10, 0);
+    ASSERT_TRUE(b.checkSequenceNum(TEST_SOCKET, newer, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(remCode, RemoteCode::SUCCESS);
+    EXPECT_EQ(b.getTsRecent(), PEER_TSVAL + 10);
+    EXPECT_TRUE(interceptedPackets.empty());
+
+    //in window, but stamped before the last segment so it may be from a previous wrap of the sequence space
+    TcpPacket old = ackFor(1, PEER_TSVAL, 0);
+    old.setPayload(vector<uint8_t>(SEG_SIZE));
+    ASSERT_TRUE(b.checkSequenceNum(TEST_SOCKET, old, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(remCode, RemoteCode::UNEXPECTEDPACKET);
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_EQ(interceptedPackets[0].getAckNum(), TEST_PEER_ISS + 1);
+    EXPECT_EQ(b.getTsRecent(), PEER_TSVAL + 10);
+}
+
+void timeWaitWithListener(App& a){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    establish(b);
+    b.setCurrentState(TimeWaitS::instance);
+    connections[ConnPair(lp, rp)] = move(b);
+    idMap[TEST_CONN_ID] = ConnPair(lp, rp);
+
+    RemotePair unspec(UNSPECIFIED, UNSPECIFIED);
+    Tcb l(&a, lp, unspec, true, TEST_CONN_ID + 1);
+    l.setCurrentState(ListenS::instance);
+    connections[ConnPair(lp, unspec)] = move(l);
+    idMap[TEST_CONN_ID + 1] = ConnPair(lp, unspec);
+}
+
+SegmentEv synFromPeer(uint32_t seq, uint32_t tsVal){
+  IpPacket ip;
+  ip.setSrcAddr(TEST_REM_IP).setDestAddr(TEST_LOC_IP);
+  TcpPacket& syn = ip.getTcpPacket();
+  syn.setFlag(TcpPacketFlags::SYN).setSeq(seq).setSrcPort(TEST_REM_PORT).setDestPort(TEST_LOC_PORT).setWindow(MAX_UNSCALED_WINDOW);
+  addTimestamp(syn, tsVal, 0);
+  return SegmentEv(ip, TEST_EVENT_ID);
+}
+
+TEST_F(TimestampFixture, NewerSynReopensTimeWait){
+
+    App a(TEST_APP_ID);
+    timeWaitWithListener(a);
+    ConnPair cPair(LocalPair(TEST_LOC_IP,TEST_LOC_PORT), RemotePair(TEST_REM_IP, TEST_REM_PORT));
+
+    //sequence number is behind the old connection, the timestamp alone says it is new
+    SegmentEv se = synFromPeer(TEST_PEER_ISS - 500, PEER_TSVAL + 1);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_TRUE(demultiplexSegment(TEST_SOCKET, se, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(remCode, RemoteCode::SUCCESS);
+
+    //the listener took the pair over, the old incarnation is gone
+    EXPECT_EQ(connections.find(cPair), connections.end());
+    ConnPair listenPair(cPair.first, RemotePair(UNSPECIFIED, UNSPECIFIED));
+    ASSERT_NE(connections.find(listenPair), connections.end());
+    Tcb& b = connections[listenPair];
+    EXPECT_EQ(b.getId(), TEST_CONN_ID + 1);
+    EXPECT_EQ(b.getConnPair(), cPair);
+    EXPECT_TRUE(dynamic_cast<SynRecS*>(b.getCurrentState()));
+    EXPECT_EQ(b.getTsRecent(), PEER_TSVAL + 1);
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_TRUE(interceptedPackets[0].getFlag(TcpPacketFlags::SYN));
+    EXPECT_TRUE(interceptedPackets[0].getFlag(TcpPacketFlags::ACK));
+    EXPECT_EQ(interceptedPackets[0].getAckNum(), TEST_PEER_ISS - 499);
+}
+
+TEST_F(TimestampFixture, OldSynKeepsTimeWait){
+
+    App a(TEST_APP_ID);
+    timeWaitWithListener(a);
+    ConnPair cPair(LocalPair(TEST_LOC_IP,TEST_LOC_PORT), RemotePair(TEST_REM_IP, TEST_REM_PORT));
+
+    SegmentEv se = synFromPeer(TEST_PEER_ISS + 500, PEER_TSVAL);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_TRUE(demultiplexSegment(TEST_SOCKET, se, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(remCode, RemoteCode::UNEXPECTEDPACKET);
+
+    Tcb& b = connections[cPair];
+    EXPECT_EQ(b.getId(), TEST_CONN_ID);
+    EXPECT_TRUE(dynamic_cast<TimeWaitS*>(b.getCurrentState()));
+    //only a challenge ack goes back
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    EXPECT_FALSE(interceptedPackets[0].getFlag(TcpPacketFlags::SYN));
+}
+
+}
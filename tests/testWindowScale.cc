@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "../src/state.h"
+#include "../src/driver.h"
+#include "testingUtil.h"
+
+using namespace std;
+
+namespace windowScaleTests{
+
+class WindowScaleFixture : public testing::Test{
+
+  void TearDown() override{
+    interceptedPackets.clear();
+    setBufferBudget(DEFAULT_BUFFER_BUDGET_BYTES);
+  }
+};
+
+//returns the shift carried by a window scale option, or -1 if the packet has none
+int findWindowShift(TcpPacket& p){
+  for(TcpOption& o : p.getOptions()){
+    if(o.getKind() == static_cast<uint8_t>(TcpOptionKind::WSCALE)) return o.getData()[0];
+  }
+  return -1;
+}
+
+TcpPacket synWithShift(uint8_t shift, bool ack){
+  TcpPacket p;
+  p.setFlag(TcpPacketFlags::SYN);
+  if(ack) p.setFlag(TcpPacketFlags::ACK);
+  p.getOptions().push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::WSCALE), 0x3, true, vector<uint8_t>{shift}));
+  return p;
+}
+
+TEST_F(WindowScaleFixture, SynOffersShiftForBuffer){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    ASSERT_TRUE(b.sendSyn(TEST_SOCKET, lp, rp, false));
+    ASSERT_EQ(interceptedPackets.size(), 1);
+    //autotuning can grow the buffer to AUTOTUNE_REC_BUFFER_MAX, so the shift has to cover that
+    int shift = findWindowShift(interceptedPackets[0]);
+    ASSERT_GE(shift, 0);
+    EXPECT_LE(AUTOTUNE_REC_BUFFER_MAX >> shift, MAX_UNSCALED_WINDOW);
+    EXPECT_GT(AUTOTUNE_REC_BUFFER_MAX >> (shift - 1), MAX_UNSCALED_WINDOW);
+    EXPECT_EQ(interceptedPackets[0].getWindow(), DEFAULT_REC_BUFFER_BYTES);
+}
+
+TEST_F(WindowScaleFixture, SynAckOnlyAnswersOffer){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    TcpPacket plainSyn;
+    plainSyn.setFlag(TcpPacketFlags::SYN);
+    b.checkAndSetPeerMSS(plainSyn);
+    ASSERT_TRUE(b.sendSyn(TEST_SOCKET, lp, rp, true));
+    EXPECT_EQ(findWindowShift(interceptedPackets[0]), -1);
+
+    TcpPacket scaledSyn = synWithShift(3, false);
+    b.checkAndSetPeerMSS(scaledSyn);
+    ASSERT_TRUE(b.sendSyn(TEST_SOCKET, lp, rp, true));
+    EXPECT_GE(findWindowShift(interceptedPackets[1]), 0);
+}
+
+TEST_F(WindowScaleFixture, NoScalingWithoutPeerOption){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    TcpPacket plainSynAck;
+    plainSynAck.setFlag(TcpPacketFlags::SYN).setFlag(TcpPacketFlags::ACK);
+    b.checkAndSetPeerMSS(plainSynAck);
+
+    TcpPacket ack;
+    ack.setFlag(TcpPacketFlags::ACK).setWindow(1000);
+    EXPECT_EQ(b.peerWindow(ack), 1000);
+    EXPECT_EQ(b.advertisedWindow(), DEFAULT_REC_BUFFER_BYTES);
+}
+
+TEST_F(WindowScaleFixture, PeerWindowAboveOneGigabyte){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    b.setCurrentState(EstabS::instance);
+    TcpPacket synAck = synWithShift(MAX_WINDOW_SHIFT, true);
+    synAck.setWindow(MAX_UNSCALED_WINDOW);
+    b.checkAndSetPeerMSS(synAck);
+    //the syn's own window is taken as is
+    EXPECT_EQ(b.peerWindow(synAck), MAX_UNSCALED_WINDOW);
+
+    TcpPacket ack;
+    ack.setFlag(TcpPacketFlags::ACK).setWindow(MAX_UNSCALED_WINDOW);
+    RemoteCode remCode = RemoteCode::SUCCESS;
+    ASSERT_TRUE(b.establishedAckLogic(TEST_SOCKET, ack, remCode) == LocalCode::SUCCESS);
+    EXPECT_EQ(b.getSendWindow(), MAX_UNSCALED_WINDOW << MAX_WINDOW_SHIFT);
+    EXPECT_GT(b.getSendWindow(), 1000000000u);
+}
+
+TEST_F(WindowScaleFixture, PeerShiftClampedTo14){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    TcpPacket synAck = synWithShift(20, true);
+    b.checkAndSetPeerMSS(synAck);
+
+    TcpPacket ack;
+    ack.setFlag(TcpPacketFlags::ACK).setWindow(MAX_UNSCALED_WINDOW);
+    EXPECT_EQ(b.peerWindow(ack), MAX_UNSCALED_WINDOW << MAX_WINDOW_SHIFT);
+}
+
+TEST_F(WindowScaleFixture, RecWindowAboveOneGigabyte){
+
+    LocalPair lp(TEST_LOC_IP,TEST_LOC_PORT);
+    RemotePair rp(TEST_REM_IP, TEST_REM_PORT);
+
+    setBufferBudget(UINT64_MAX);
+    App a(TEST_APP_ID);
+    Tcb b(&a, lp, rp, true, TEST_CONN_ID);
+    ASSERT_TRUE(b.setRecBufferSize(2u * 1024 * 1024 * 1024));
+    TcpPacket syn = synWithShift(0, false);
+    b.checkAndSetPeerMSS(syn);
+
+    //the syn-ack offers the largest shift and an unscaled window
+    ASSERT_TRUE(b.sendSyn(TEST_SOCKET, lp, rp, true));
+    EXPECT_EQ(findWindowShift(interceptedPackets[0]), MAX_WINDOW_SHIFT);
+    EXPECT_EQ(interceptedPackets[0].getWindow(), MAX_UNSCALED_WINDOW);
+    //later segments carry the scaled window, which is capped at what the field can express
+    EXPECT_EQ(b.advertisedWindow(), MAX_UNSCALED_WINDOW);
+
+    std::vector<uint8_t> payload(1);
+    TcpPacket far;
+    far.setSeq(1000000000u).setPayload(payload);
+    EXPECT_TRUE(b.verifyRecWindow(far));
+    TcpPacket beyond;
+    beyond.setSeq(MAX_UNSCALED_WINDOW << MAX_WINDOW_SHIFT).setPayload(payload);
+    EXPECT_FALSE(b.verifyRecWindow(beyond));
+}
+
+}
@@ -1,3 +1,49 @@
 #include "testingUtil.h"
+#include "../src/network.h"
 
 std::vector<TcpPacket> interceptedPackets;
+
+SplitNotifs splitNotifs(App& a){
+  SplitNotifs split;
+  AppNotif n;
+  while(a.popNotif(n)){
+    if(n.connId == NO_CONN_ID){
+      split.appNotifs.push_back(n.code);
+    }
+    else{
+      split.connNotifs[n.connId].push_back(n.code);
+    }
+  }
+  return split;
+}
+
+void InterceptFixture::TearDown(){
+  interceptedPackets.clear();
+}
+
+TcpPacket peerAck(uint32_t ackNum, std::vector<std::pair<uint32_t, uint32_t> > sackBlocks){
+  TcpPacket p;
+  p.setFlag(TcpPacketFlags::ACK).setSeq(TEST_PEER_ISS + 1).setAck(ackNum).setWindow(MAX_UNSCALED_WINDOW);
+  if(sackBlocks.empty()) return p;
+
+  std::vector<uint8_t> data;
+  for(auto& block : sackBlocks){
+    loadBytes<uint32_t>(toAltOrder<uint32_t>(block.first), data);
+    loadBytes<uint32_t>(toAltOrder<uint32_t>(block.second), data);
+  }
+  p.getOptions().push_back(TcpOption(static_cast<uint8_t>(TcpOptionKind::SACK), static_cast<uint8_t>(2 + data.size()), true, data));
+  return p;
+}
+
+void establishWithAck(Tcb& b, TcpPacket& synAck){
+  b.setCurrentState(EstabS::instance);
+  b.initReceiverState(TEST_PEER_ISS);
+  b.initSenderState(false);
+  RemoteCode remCode = RemoteCode::SUCCESS;
+  b.establishedAckLogic(TEST_SOCKET, synAck, remCode);
+}
+
+void establishWithAck(Tcb& b){
+  TcpPacket synAck = peerAck(1);
+  establishWithAck(b, synAck);
+}
@@ -1,5 +1,11 @@
 #pragma once
+#include <gtest/gtest.h>
 #include "../src/tcpPacket.h"
+#include "../src/state.h"
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <utility>
 
 const int TEST_APP_ID = 0;
 const int TEST_SOCKET = 0;
@@ -9,6 +15,27 @@ const unsigned int TEST_LOC_IP = 1;
 const unsigned int TEST_LOC_PORT = 1;
 const unsigned int TEST_REM_IP = 1;
 const unsigned int TEST_REM_PORT = 1;
+const uint32_t TEST_PEER_ISS = 1000;
 
 extern std::vector<TcpPacket> interceptedPackets;
 
+//app notifications drained from the ring and grouped the way the tests check them
+struct SplitNotifs{
+  std::deque<TcpCode> appNotifs;
+  std::unordered_map<int, std::deque<TcpCode> > connNotifs;
+};
+
+SplitNotifs splitNotifs(App& a);
+
+//for tests that look at the segments a connection sent, throws them away after each test
+class InterceptFixture : public testing::Test{
+  protected:
+    void TearDown() override;
+};
+
+//a pure ack from the peer at its next in order sequence number, advertising MAX_UNSCALED_WINDOW. Sack blocks are added when given
+TcpPacket peerAck(uint32_t ackNum, std::vector<std::pair<uint32_t, uint32_t> > sackBlocks = {});
+
+//puts b in established with the peer's syn taken and synAck(the ack of our syn) processed, so sUna sits at 1
+void establishWithAck(Tcb& b, TcpPacket& synAck);
+void establishWithAck(Tcb& b);